@@ -0,0 +1,91 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// alloc_check.cpp
+// Allocation counting for debug builds made with "make ALLOC_CHECK=1", empty otherwise
+//
+
+#include "matrix_clock.h"
+
+#ifdef MATRIX_ALLOC_CHECK
+
+#include <iostream>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+// every allocation made through operator new on this thread, only ever counts up
+static thread_local long allocation_count = 0;
+
+// counts the allocation and hands it to malloc, the allocators below all end up here
+static void* counted_allocation(std::size_t size, std::size_t alignment) {
+    allocation_count++;
+
+    if (size == 0)
+        size = 1;
+
+    void* memory;
+
+    if (alignment <= alignof(std::max_align_t))
+        memory = std::malloc(size);
+    else
+        memory = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);   // aligned_alloc wants a multiple of the alignment
+
+    return memory;
+}
+
+void* operator new(std::size_t size) {
+    void* memory = counted_allocation(size, 0);
+    if (memory == nullptr) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](std::size_t size) {
+    void* memory = counted_allocation(size, 0);
+    if (memory == nullptr) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    void* memory = counted_allocation(size, (std::size_t) alignment);
+    if (memory == nullptr) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    void* memory = counted_allocation(size, (std::size_t) alignment);
+    if (memory == nullptr) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return counted_allocation(size, 0); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return counted_allocation(size, 0); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+
+namespace matrix_clock {
+    allocation_guard::allocation_guard() {
+        allocations_before = allocation_count;
+    }
+
+    void allocation_guard::check(bool steady) const {
+        long allocations = allocation_count - allocations_before;
+
+        if (steady && allocations > 0) {
+            std::cerr << "ALLOC_CHECK: a steady render tick made " << allocations << " heap allocation(s)." << std::endl;
+            std::abort();
+        }
+    }
+}
+
+#endif
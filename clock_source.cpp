@@ -0,0 +1,89 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// clock_source.cpp
+// Implementation of the clock_source class
+//
+
+#include <ctime>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    std::atomic<bool> clock_source::simulated(false);
+    std::atomic<std::int64_t> clock_source::virtual_ms(0);
+    thread_local std::int64_t clock_source::pinned_ms = 0;
+
+    // the longest sleep_until_wall() waits for, a second drawn ahead is never more than a second away
+    const std::int64_t MAX_WAIT_US = 1100000;
+
+    // reads a system clock in milliseconds
+    static std::int64_t read_clock(clockid_t clock) {
+        timespec now;
+        clock_gettime(clock, &now);
+        return ((std::int64_t) now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+    }
+
+    std::int64_t clock_source::get_monotonic_ms(void) {
+        // the virtual clock only ever moves forward, so it serves as the monotonic clock as well
+        return simulated ? virtual_ms.load() : read_clock(CLOCK_MONOTONIC);
+    }
+
+    std::int64_t clock_source::get_wall_ms(void) {
+        if (pinned_ms != 0)
+            return pinned_ms;
+
+        return simulated ? virtual_ms.load() : read_clock(CLOCK_REALTIME);
+    }
+
+    std::int64_t clock_source::get_wall_us(void) {
+        if (simulated)
+            return virtual_ms * 1000;
+
+        timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        return ((std::int64_t) now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+    }
+
+    bool clock_source::sleep_until_wall(std::int64_t wall_ms) {
+        if (simulated) {
+            advance(wall_ms - virtual_ms);
+            return true;
+        }
+
+        // the sleep itself runs on the monotonic clock, an absolute sleep on the wall clock would sit through a step of the wall
+        // clock backwards (an hour when it is set back), the wall clock is read again every time the sleep ends instead
+        while (true) {
+            std::int64_t remaining_us = (wall_ms * 1000) - get_wall_us();
+
+            if (remaining_us <= 0)
+                return true;
+
+            if (remaining_us > MAX_WAIT_US)     // further away than any second drawn ahead can be, the wall clock was set back
+                return false;
+
+            timespec until;
+            clock_gettime(CLOCK_MONOTONIC, &until);
+            until.tv_sec += remaining_us / 1000000;
+            until.tv_nsec += (remaining_us % 1000000) * 1000;
+
+            if (until.tv_nsec >= 1000000000) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000;
+            }
+
+            // a signal only interrupts the sleep and the loop goes back to it, the frame drawn for this time must not go up early
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr);
+        }
+    }
+
+    void clock_source::simulate(std::int64_t start_ms) {
+        virtual_ms = start_ms;
+        simulated = true;
+    }
+
+    void clock_source::advance(std::int64_t ms) {
+        if (simulated && ms > 0)
+            virtual_ms += ms;
+    }
+}
@@ -0,0 +1,105 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// config_arena.cpp
+// Implementation of the config_arena class
+//
+
+#include <stdexcept>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // everything in the arena hands out pointers into these arrays, so they may never grow past what was reserved
+    template <typename T>
+    static void check_room(const std::vector<T>& array, std::size_t adding) {
+        if (array.size() + adding > array.capacity())
+            throw std::length_error("config_arena ran out of reserved room");
+    }
+
+    void config_arena::reserve(std::size_t text_bytes, std::size_t face_count, std::size_t line_count, std::size_t period_count, std::size_t notification_count,
+                               std::size_t icon_count, std::size_t rule_count, std::size_t condition_op_count) {
+        text.reserve(text_bytes);
+        faces.reserve(face_count);
+        lines.reserve(line_count);
+        periods.reserve(period_count);
+        notifications.reserve(notification_count);
+        icons.reserve(icon_count);
+        icon_rules.reserve(rule_count);
+        sprites.reserve(rule_count);
+        condition_ops.reserve(condition_op_count);
+    }
+
+    std::string_view config_arena::intern(const std::string& value) {
+        std::size_t found = text.find(value);     // reuse any text already stored, including the end of a longer string
+
+        if (found == std::string::npos) {
+            if (text.size() + value.size() > text.capacity())
+                throw std::length_error("config_arena ran out of reserved text");
+
+            found = text.size();
+            text += value;
+        }
+
+        return std::string_view(text.data() + found, value.size());
+    }
+
+    clock_face& config_arena::add_face(const clock_face& face) {
+        check_room(faces, 1);
+        faces.push_back(face);
+        return faces.back();
+    }
+
+    void config_arena::add_line(const text_line& line) {
+        check_room(lines, 1);
+        lines.push_back(line);
+    }
+
+    void config_arena::add_period(const time_period& period) {
+        check_room(periods, 1);
+        periods.push_back(period);
+    }
+
+    void config_arena::add_notification(const telegram_push& notification) {
+        check_room(notifications, 1);
+        notifications.push_back(notification);
+    }
+    const sprite* config_arena::add_sprite(const std::string& path) {
+        for (const sprite& image : sprites) {   // the same file is often used by several icons, decode it once
+            if (image.get_name() == path)
+                return &image;
+        }
+
+        sprite image;
+
+        if (!image.load(intern(path)))
+            return nullptr;
+
+        check_room(sprites, 1);
+        sprites.push_back(std::move(image));
+        return &sprites.back();
+    }
+
+    void config_arena::add_icon_rule(const icon_rule& rule) {
+        check_room(icon_rules, 1);
+        icon_rules.push_back(rule);
+    }
+
+    void config_arena::add_icon(const weather_icon& icon) {
+        check_room(icons, 1);
+        icons.push_back(icon);
+    }
+    array_view<line_condition::op> config_arena::add_condition(std::string_view expression) {
+        check_room(condition_ops, expression.size());   // the most ops the expression can compile into
+        std::size_t first = condition_ops.size();
+
+        try {
+            line_condition::compile(expression, condition_ops);
+        } catch (const std::invalid_argument& exception) {
+            condition_ops.resize(first);    // leave nothing of a broken expression behind
+            throw;
+        }
+
+        return array_view<line_condition::op>(condition_ops.data() + first, condition_ops.size() - first);
+    }
+}
@@ -0,0 +1,316 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// config_check.cpp
+// Implementation of the config_checker class
+//
+
+#include <iostream>
+#include <jsoncpp/json/json.h>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    static const int MINUTES_PER_WEEK = 7 * 1440;
+
+    // what a display shows at a minute of the week that is not one of the clock faces
+    static const int SCHEDULE_OFF = -2;     // inside an off period, the clock is off anyways
+    static const int SCHEDULE_GAP = -1;     // no clock face covers the minute, the display is blank
+
+    // formats a minute of the week (0 is Sunday at midnight) the way it is reported, for example "Mon 07:30"
+    static std::string format_minute(int minute_of_week) {
+        static const char* const DAY_NAMES[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+        int minute_of_day = minute_of_week % 1440;
+        std::string text = DAY_NAMES[minute_of_week / 1440];
+
+        text += ' ';
+        append_number(text, minute_of_day / 60, 2);
+        text += ':';
+        append_number(text, minute_of_day % 60, 2);
+        return text;
+    }
+
+    config_checker::config_checker(const Json::Value& config, const matrix_data& clock_data, variable_utility& util)
+        : config(config), clock_data(clock_data), util(util) {
+        errors = warnings = 0;
+    }
+
+    void config_checker::report_error(const std::string& where, const std::string& problem) {
+        std::cout << "error: " << where << ": " << problem << std::endl;
+        errors++;
+    }
+
+    void config_checker::report_warning(const std::string& where, const std::string& problem) {
+        std::cout << "warning: " << where << ": " << problem << std::endl;
+        warnings++;
+    }
+
+    void config_checker::run(void) {
+        const Json::Value& faces_data = config["clock_faces"];
+        const Json::Value& timer_data = config["timer"];
+        const Json::Value& notifications = config["telegram_notifications"];
+        const Json::Value& off_data = config["clock_data"]["off_periods"];
+
+        for (Json::Value::ArrayIndex face_index = 0; face_index != faces_data.size(); face_index++) {
+            const Json::Value& face_data = faces_data[face_index];
+            std::string where = "clock face \"" + face_data["name"].asString() + "\"";
+
+            check_color(face_data["bg_color"], where + ", bg_color");
+
+            if (face_data.isMember("display")) {
+                bool found = false;
+
+                for (const display_region& display : clock_data.get_displays())
+                    found |= !strcasecmp(display.get_name().c_str(), face_data["display"].asCString());
+
+                if (!found)
+                    report_error(where, "there is no display called " + face_data["display"].asString() + ", the face goes on the first display");
+            }
+
+            for (Json::Value::ArrayIndex period_index = 0; period_index != face_data["time_periods"].size(); period_index++)
+                check_period(face_data["time_periods"][period_index], where + ", time period " + std::to_string(period_index + 1));
+
+            for (Json::Value::ArrayIndex line_index = 0; line_index != face_data["text_lines"].size(); line_index++)
+                check_text_line(face_data["text_lines"][line_index], where + ", text line " + std::to_string(line_index + 1));
+
+            // the icons themselves are decoded while the config is loaded, every file that could not be is reported there
+            const Json::Value& icons_data = face_data["weather_icons"];
+
+            for (Json::Value::ArrayIndex icon_index = 0; icon_index != icons_data.size(); icon_index++) {
+                if (icons_data[icon_index]["icons"].empty())
+                    report_warning(where + ", weather icon " + std::to_string(icon_index + 1), "has no icons, nothing is ever drawn for it");
+            }
+        }
+
+        check_color(timer_data["bg_color"], "timer, bg_color");
+
+        for (Json::Value::ArrayIndex line_index = 0; line_index != timer_data["text_lines"].size(); line_index++)
+            check_text_line(timer_data["text_lines"][line_index], "timer, text line " + std::to_string(line_index + 1));
+
+        for (Json::Value::ArrayIndex noti_index = 0; noti_index != notifications.size(); noti_index++) {
+            const Json::Value& notification = notifications[noti_index];
+            std::string where = "telegram notification " + std::to_string(noti_index + 1);
+
+            check_text(notification["message"].asString(), where);
+            check_time(notification["hour"].asInt(), notification["minute"].asInt(), where);
+            check_days(notification["days_of_week"], where);
+        }
+
+        for (Json::Value::ArrayIndex off_index = 0; off_index != off_data.size(); off_index++)
+            check_period(off_data[off_index], "off period " + std::to_string(off_index + 1));
+
+        check_schedule();
+    }
+
+    void config_checker::check_color(const Json::Value& color_data, const std::string& where) {
+        std::string name = color_data["built_in_color"].asString();
+        matrix_color color;
+
+        if (name == "none") {
+            for (const char* component : {"r", "g", "b"}) {
+                int value = color_data[component].asInt();
+
+                if (value < 0 || value > 255)
+                    report_error(where, std::string(component) + " is " + std::to_string(value) + ", it has to be between 0 and 255");
+            }
+        } else if (!matrix_color::find_prebuilt(name, color)) {
+            report_error(where, "unknown color \"" + name + "\", it is shown as red (use \"none\" with r, g, and b for other colors)");
+        }
+    }
+
+    void config_checker::check_text_line(const Json::Value& line_data, const std::string& where) {
+        check_color(line_data["color"], where + ", color");
+        check_text(line_data["text"].asString(), where);
+
+        std::string font = line_data["font_size"].asString();
+        std::string path = matrix_font::get_font_file(clock_data.get_fonts_folder(), matrix_font::resolve_name(font));
+        auto tried = loaded_fonts.find(path);
+
+        if (tried == loaded_fonts.end()) {
+            rgb_matrix::Font loaded;
+            tried = loaded_fonts.emplace(path, loaded.LoadFont(path.c_str())).first;
+        }
+
+        if (!tried->second) {
+            if (matrix_font::resolve_name(font) == font)
+                report_error(where, "font " + font + " could not be loaded from " + path + ", the 6x9 font is used instead");
+            else
+                report_error(where, "font " + font + " could not be loaded from " + path + ", the line is not drawn");
+        }
+    }
+
+    void config_checker::check_text(const std::string& text, const std::string& where) {
+        std::string parsed;
+        std::size_t position = 0;
+
+        // the variables are found the same way variable_utility::parse_variables() finds them, each one is then parsed on its own
+        while (position < text.size()) {
+            std::size_t open = text.find('{', position);
+            std::size_t close = (open == std::string::npos) ? open : text.find('}', open + 1);
+
+            if (close == std::string::npos)
+                return;
+
+            std::string variable = text.substr(open, close - open + 1);
+            std::string name = variable.substr(1, variable.size() - 2);
+            std::size_t colon = name.find(':');
+            std::string kind = name.substr(0, colon);
+            bool known;
+
+            // the sources are never read here, so {src:name} is checked against the names declared in the config instead
+            if (colon != std::string::npos && (kind == "src" || kind == "src_age" || kind == "src_ms")) {
+                known = false;
+
+                for (const variable_source& source : clock_data.get_variable_sources())
+                    known |= source.name == name.substr(colon + 1);
+
+                if (!known) {
+                    report_error(where, variable + " uses a variable source that is not declared, it is shown as written");
+                    position = close + 1;
+                    continue;
+                }
+            } else {
+                util.parse_variables(variable, parsed);
+                known = parsed != variable;
+            }
+
+            if (known) {
+                position = close + 1;
+            } else if (name.find('@') != std::string::npos && colon == std::string::npos) {
+                std::string zone = name.substr(name.find('@') + 1);
+                std::tm local;
+
+                if (zones.get_local_time(zone, 0, local))
+                    report_error(where, variable + " is not a time or date variable, it is shown as written");
+                else
+                    report_error(where, "time zone " + zone + " of " + variable + " could not be read from the zoneinfo folder, it is shown as written");
+
+                position = close + 1;
+            } else {
+                report_error(where, "unknown variable " + variable + ", it is shown as written");
+                position = open + 1;    // the same as parse_variables(), a variable may still start after this brace
+            }
+        }
+    }
+
+    void config_checker::check_time(int hour, int minute, const std::string& where) {
+        if (hour < 0 || hour > 23 || minute < 0 || minute > 59)
+            report_error(where, std::to_string(hour) + ":" + std::to_string(minute) + " is not a time of day, hours go from 0 to 23 and minutes from 0 to 59");
+    }
+
+    void config_checker::check_days(const Json::Value& days, const std::string& where) {
+        for (Json::Value::ArrayIndex days_index = 0; days_index != days.size(); days_index++) {
+            int day = days[days_index].asInt();
+
+            if (day < 0 || day > 6)
+                report_error(where, "day " + std::to_string(day) + " is ignored, days of the week go from 0 (Sunday) to 6 (Saturday)");
+        }
+
+        if (days.empty())
+            report_warning(where, "has no days of the week, so it never happens");
+    }
+
+    void config_checker::check_period(const Json::Value& period_data, const std::string& where) {
+        int start_hour = period_data["start_hour"].asInt(), start_minute = period_data["start_minute"].asInt();
+        int end_hour = period_data["end_hour"].asInt(), end_minute = period_data["end_minute"].asInt();
+
+        check_time(start_hour, start_minute, where + ", start");
+        check_time(end_hour, end_minute, where + ", end");
+        check_days(period_data["days_of_week"], where);
+
+        if (start_hour == end_hour && start_minute == end_minute)
+            report_warning(where, "starts when it ends, so it never happens");
+    }
+
+    void config_checker::check_schedule(void) {
+        const std::vector<clock_face>& faces = clock_data.get_clock_faces();
+        const std::vector<display_region>& displays = clock_data.get_displays();
+        std::vector<int> minutes_shown(faces.size(), 0);
+
+        // what every minute of the week shows, the face update_clock_face() would pick and the first one it passed over
+        std::vector<int> shown(MINUTES_PER_WEEK), hidden(MINUTES_PER_WEEK);
+
+        for (std::size_t display = 0; display < displays.size(); display++) {
+            std::string where = "display " + displays[display].get_name();
+            int minutes_on = 0, minutes_covered = 0;
+
+            for (int minute = 0; minute < MINUTES_PER_WEEK; minute++) {
+                int day = minute / 1440, hour = (minute % 1440) / 60, minute_of_hour = minute % 60;
+
+                shown[minute] = SCHEDULE_GAP;
+                hidden[minute] = SCHEDULE_GAP;
+
+                if (clock_data.in_off_period(hour, minute_of_hour, day)) {
+                    shown[minute] = SCHEDULE_OFF;
+                    continue;
+                }
+
+                minutes_on++;
+
+                for (std::size_t face = 0; face < faces.size(); face++) {
+                    if (faces[face].get_display() != (int) display)
+                        continue;
+
+                    bool covered = false;
+
+                    for (const time_period& period : faces[face].get_time_periods())
+                        covered |= period.in_time_period(hour, minute_of_hour, day);
+
+                    if (!covered)
+                        continue;
+
+                    if (shown[minute] == SCHEDULE_GAP)
+                        shown[minute] = face;
+                    else if (hidden[minute] == SCHEDULE_GAP)
+                        hidden[minute] = face;
+                }
+
+                if (shown[minute] >= 0) {
+                    minutes_covered++;
+                    minutes_shown[shown[minute]]++;
+                }
+            }
+
+            // report every stretch of minutes that look the same, starting at a change so one that runs past Saturday night stays whole
+            auto same = [&](int first, int second) { return shown[first] == shown[second] && hidden[first] == hidden[second]; };
+            int start = 0;
+
+            while (start < MINUTES_PER_WEEK && same(start, (start + MINUTES_PER_WEEK - 1) % MINUTES_PER_WEEK))
+                start++;
+
+            bool whole_week = start == MINUTES_PER_WEEK;
+
+            for (int offset = 0; offset < MINUTES_PER_WEEK;) {
+                int first = (start + offset) % MINUTES_PER_WEEK;
+                int length = 1;
+
+                while (offset + length < MINUTES_PER_WEEK && same(first, (start + offset + length) % MINUTES_PER_WEEK))
+                    length++;
+
+                std::string when = whole_week ? "all week" : "from " + format_minute(first) + " to " + format_minute((first + length - 1) % MINUTES_PER_WEEK);
+
+                if (shown[first] == SCHEDULE_GAP) {
+                    report_warning(where, "no clock face is shown " + when + ", the display is blank");
+                } else if (hidden[first] >= 0) {
+                    report_warning(where, "clock faces \"" + std::string(faces[shown[first]].get_name()) + "\" and \"" + std::string(faces[hidden[first]].get_name())
+                                   + "\" both cover " + when + ", only \"" + std::string(faces[shown[first]].get_name()) + "\" is shown");
+                }
+
+                offset += length;
+            }
+
+            std::cout << where << ": a clock face is shown for " << minutes_covered << " of the " << minutes_on << " minutes a week the clock is on";
+
+            if (minutes_on > 0)
+                std::cout << " (" << (minutes_covered * 100) / minutes_on << "%)";
+
+            std::cout << std::endl;
+        }
+
+        // a face without time periods can still be put up by the bot, one whose time periods are all taken is most likely a mistake
+        for (std::size_t face = 0; face < faces.size(); face++) {
+            if (minutes_shown[face] == 0 && !faces[face].get_time_periods().empty())
+                report_warning("clock face \"" + std::string(faces[face].get_name()) + "\"", "is never shown, other faces or off periods cover all of its time periods");
+        }
+    }
+}
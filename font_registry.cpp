@@ -0,0 +1,42 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// font_registry.cpp
+// Implementation of the font_registry class
+//
+
+#include <iostream>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    font_registry::~font_registry() {
+        for (auto& folder : fonts) {
+            for (auto& font : folder.second)
+                delete font.second;
+        }
+    }
+
+    const rgb_matrix::Font* font_registry::get_font(const std::string& font_folder, std::string_view font_size) {
+        std::lock_guard<std::mutex> lock(registry_lock);
+
+        // keyed on the folder as well in case the fonts folder changes on a reload
+        auto folder = fonts.find(font_folder);
+
+        if (folder != fonts.end()) {
+            auto found = folder->second.find(font_size);
+
+            if (found != folder->second.end())
+                return found->second;   // already loaded, this is the path taken on every frame after the first
+        }
+
+        std::string font_file = matrix_font::get_font_file(font_folder, font_size);
+        rgb_matrix::Font* font = new rgb_matrix::Font;
+
+        if (!font->LoadFont(font_file.c_str()))     // keep the empty font anyways, otherwise we would try to read the file again every frame
+            std::cout << "Could not load font " << font_file << std::endl;
+
+        fonts[font_folder][std::string(font_size)] = font;
+        return font;
+    }
+}
@@ -0,0 +1,73 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// frame_capture.cpp
+// Implementation of the frame_capture class and png encoding of captured frames
+//
+
+#include <png.h>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // png_write_callback(png_structp png, png_bytep data, png_size_t length)
+    //      callback method for libpng, appends the encoded bytes to the output string instead of writing a file
+    static void png_write_callback(png_structp png, png_bytep data, png_size_t length) {
+        std::string* output = (std::string*) png_get_io_ptr(png);
+        output->append((const char*) data, length);
+    }
+
+    void frame_capture::push_frame(std::shared_ptr<const frame_buffer> frame, const std::vector<dirty_rect>& dirty_rects) {
+        std::lock_guard<std::mutex> lock(capture_lock);
+        latest = frame;     // just swapping a pointer, the frame is never copied
+    }
+
+    std::shared_ptr<const frame_buffer> frame_capture::get_latest(void) const {
+        std::lock_guard<std::mutex> lock(capture_lock);
+        return latest;
+    }
+
+    bool encode_png(const frame_buffer& frame, int scale, std::string& output) {
+        if (frame.width <= 0 || frame.height <= 0 || scale < 1)
+            return false;
+
+        output.clear();
+
+        // the scaled row has to exist before setjmp(), libpng errors jump straight back there
+        std::vector<png_byte> row(frame.width * scale * 3);
+
+        png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        png_infop info = png ? png_create_info_struct(png) : nullptr;
+
+        if (png == nullptr || info == nullptr) {
+            png_destroy_write_struct(&png, &info);
+            return false;
+        }
+
+        if (setjmp(png_jmpbuf(png))) {  // libpng jumps back here if anything goes wrong while encoding
+            png_destroy_write_struct(&png, &info);
+            return false;
+        }
+
+        png_set_write_fn(png, &output, png_write_callback, nullptr);
+        png_set_IHDR(png, info, frame.width * scale, frame.height * scale, 8, PNG_COLOR_TYPE_RGB,
+                     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+        png_write_info(png, info);
+
+        for (int y = 0; y < frame.height; y++) {
+            const std::uint8_t* source = &frame.pixels[y * frame.width * 3];
+
+            for (int x = 0; x < frame.width; x++) {     // stretch each pixel horizontally
+                for (int copy = 0; copy < scale; copy++)
+                    memcpy(&row[(x * scale + copy) * 3], &source[x * 3], 3);
+            }
+
+            for (int copy = 0; copy < scale; copy++)    // then repeat the stretched row vertically
+                png_write_row(png, row.data());
+        }
+
+        png_write_end(png, nullptr);
+        png_destroy_write_struct(&png, &info);
+        return true;
+    }
+}
@@ -0,0 +1,305 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// frame_stream.cpp
+// Implementation of the frame_stream class
+//
+
+#include <iostream>
+#include <chrono>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "matrix_stream.h"
+
+namespace matrix_stream {
+    // how many unchanged pixels a span is allowed to swallow before it is split in two
+    // a new span costs 8 bytes, while resending a couple of unchanged pixels usually costs nothing thanks to the run length encoding
+    const int MAX_SPAN_GAP = 3;
+
+    // how many dirty rectangles can pile up while the stream thread is busy before they are merged into one covering the frame
+    // the lists have this much room from the start, so push_frame() never allocates on the render thread
+    const std::size_t MAX_PENDING_RECTS = 64;
+
+    // appends a little endian 16 bit number to the packet
+    static void put_u16(std::vector<std::uint8_t>& packet, std::uint16_t value) {
+        packet.push_back(value & 0xFF);
+        packet.push_back((value >> 8) & 0xFF);
+    }
+
+    // appends a little endian 32 bit number to the packet
+    static void put_u32(std::vector<std::uint8_t>& packet, std::uint32_t value) {
+        for (int i = 0; i < 4; i++)
+            packet.push_back((value >> (i * 8)) & 0xFF);
+    }
+
+    // appends a span of pixels starting at the given pixel offset to the packet, run length encoded
+    static void put_span(std::vector<std::uint8_t>& packet, const matrix_clock::frame_buffer& frame, int offset, int count) {
+        put_u32(packet, offset);
+        put_u32(packet, count);
+
+        const std::uint8_t* pixels = frame.pixels.data();
+        int index = offset;
+
+        while (index < offset + count) {    // group identical neighbouring pixels into runs of up to 255
+            const std::uint8_t* color = &pixels[index * 3];
+            int run = 1;
+
+            while (index + run < offset + count && run < 255 && memcmp(color, &pixels[(index + run) * 3], 3) == 0)
+                run++;
+
+            packet.push_back(run);
+            packet.push_back(color[0]);
+            packet.push_back(color[1]);
+            packet.push_back(color[2]);
+
+            index += run;
+        }
+    }
+
+    frame_stream::frame_stream(std::string socket_path, std::string bind_address, int tcp_port) {
+        this->socket_path = socket_path;
+        this->bind_address = bind_address;
+        this->tcp_port = tcp_port;
+        unix_fd = tcp_fd = -1;
+        running = false;
+
+        pending_rects.reserve(MAX_PENDING_RECTS);   // the two lists trade places every frame, so both need the room
+        rects.reserve(MAX_PENDING_RECTS);
+    }
+
+    frame_stream::~frame_stream() {
+        {
+            std::lock_guard<std::mutex> lock(frame_lock);
+            running = false;
+        }
+
+        frame_ready.notify_all();
+
+        if (worker.joinable())
+            worker.join();
+
+        for (int client : clients) close(client);
+        for (int client : new_clients) close(client);
+
+        if (tcp_fd != -1) close(tcp_fd);
+
+        if (unix_fd != -1) {
+            close(unix_fd);
+            unlink(socket_path.c_str());    // remove the socket file so the next run can bind to it again
+        }
+    }
+
+    bool frame_stream::start(void) {
+        if (!socket_path.empty()) {
+            sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+
+            if (socket_path.size() >= sizeof(address.sun_path)) {
+                std::cerr << "Stream socket path " << socket_path << " is too long." << std::endl;
+            } else {
+                strcpy(address.sun_path, socket_path.c_str());
+                unlink(socket_path.c_str());    // a previous run may have left the socket file behind
+
+                unix_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+                if (unix_fd == -1 || bind(unix_fd, (sockaddr*) &address, sizeof(address)) != 0 || listen(unix_fd, 8) != 0) {
+                    std::cerr << "Could not open stream socket " << socket_path << ": " << strerror(errno) << std::endl;
+
+                    if (unix_fd != -1) close(unix_fd);
+                    unix_fd = -1;
+                } else {
+                    fcntl(unix_fd, F_SETFL, O_NONBLOCK);    // non blocking so accept_clients() never stalls the stream
+                }
+            }
+        }
+
+        if (tcp_port > 0) {
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(tcp_port);
+
+            if (inet_pton(AF_INET, bind_address.c_str(), &address.sin_addr) != 1) {
+                std::cerr << "Stream bind address " << bind_address << " is not an IPv4 address, the stream port stays closed." << std::endl;
+            } else {
+                tcp_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+                int reuse = 1;
+                if (tcp_fd != -1)
+                    setsockopt(tcp_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+                if (tcp_fd == -1 || bind(tcp_fd, (sockaddr*) &address, sizeof(address)) != 0 || listen(tcp_fd, 8) != 0) {
+                    std::cerr << "Could not open stream port " << bind_address << ":" << tcp_port << ": " << strerror(errno) << std::endl;
+
+                    if (tcp_fd != -1) close(tcp_fd);
+                    tcp_fd = -1;
+                } else {
+                    fcntl(tcp_fd, F_SETFL, O_NONBLOCK);
+                }
+            }
+        }
+
+        if (unix_fd == -1 && tcp_fd == -1)
+            return false;
+
+        running = true;
+        worker = std::thread(&frame_stream::stream_loop, this);
+        return true;
+    }
+
+    void frame_stream::push_frame(std::shared_ptr<const matrix_clock::frame_buffer> frame, const std::vector<matrix_clock::dirty_rect>& dirty_rects) {
+        {
+            std::lock_guard<std::mutex> lock(frame_lock);
+
+            // if the stream thread has not picked up the last frame yet it is simply replaced
+            // the dirty rectangles pile up though, since the next delta is taken against the last frame that was actually sent
+            pending_frame = frame;
+
+            if (pending_rects.size() + dirty_rects.size() <= MAX_PENDING_RECTS)
+                pending_rects.insert(pending_rects.end(), dirty_rects.begin(), dirty_rects.end());
+            else
+                pending_rects.assign(1, {0, 0, frame->width, frame->height});   // too many to be worth tracking, resend the whole frame
+        }
+
+        frame_ready.notify_one();
+    }
+
+    void frame_stream::stream_loop(void) {
+        matrix_clock::thread_placement::apply(matrix_clock::thread_placement::stream);
+        matrix_clock::thread_privileges::drop_thread();
+        std::unique_lock<std::mutex> lock(frame_lock);
+
+        while (running) {
+            // wake up for new frames, or every so often to let new viewers in
+            frame_ready.wait_for(lock, std::chrono::milliseconds(250), [this] { return pending_frame != nullptr || !running; });
+
+            std::shared_ptr<const matrix_clock::frame_buffer> frame = pending_frame;
+            pending_frame = nullptr;
+            rects.clear();
+            rects.swap(pending_rects);
+
+            lock.unlock();      // encoding and sending happens without holding the lock so push_frame() never waits on the network
+
+            accept_clients(unix_fd);
+            accept_clients(tcp_fd);
+
+            if (frame != nullptr) {
+                if (!clients.empty()) {
+                    bool resized = last_sent == nullptr || last_sent->width != frame->width || last_sent->height != frame->height;
+
+                    encode(*frame, resized ? nullptr : last_sent.get(), rects);
+                    send_packet(clients);
+                }
+
+                last_sent = frame;      // hold on to the frame we sent so the next delta can be taken against it
+            }
+
+            if (!new_clients.empty() && last_sent != nullptr) {     // new viewers start off with a full key frame
+                encode(*last_sent, nullptr, rects);
+                send_packet(new_clients);
+
+                clients.insert(clients.end(), new_clients.begin(), new_clients.end());
+                new_clients.clear();
+            }
+
+            lock.lock();
+        }
+    }
+
+    void frame_stream::accept_clients(int listen_fd) {
+        if (listen_fd == -1)
+            return;
+
+        int client;
+
+        while ((client = accept(listen_fd, nullptr, nullptr)) != -1) {
+            timeval timeout = {1, 0};   // a viewer that cannot keep up for a whole second gets dropped instead of stalling everyone else
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            new_clients.push_back(client);
+        }
+    }
+
+    void frame_stream::encode(const matrix_clock::frame_buffer& frame, const matrix_clock::frame_buffer* previous,
+                              const std::vector<matrix_clock::dirty_rect>& rects) {
+        packet.clear();     // the packet buffer is reused between frames
+
+        packet.push_back('M');
+        packet.push_back('C');
+        packet.push_back(previous == nullptr ? FRAME_KEY : FRAME_DELTA);
+        packet.push_back(0);
+        put_u16(packet, frame.width);
+        put_u16(packet, frame.height);
+        put_u32(packet, 0);     // payload length, filled in at the end
+
+        if (previous == nullptr) {
+            put_span(packet, frame, 0, frame.width * frame.height);
+        } else {
+            const std::uint8_t* now = frame.pixels.data();
+            const std::uint8_t* before = previous->pixels.data();
+
+            // only the dirty rectangles can contain changes, so only those are compared against the last frame that was sent
+            for (const matrix_clock::dirty_rect& rect : rects) {
+                int x0 = std::max(rect.x, 0), x1 = std::min(rect.x + rect.width, frame.width);
+                int y0 = std::max(rect.y, 0), y1 = std::min(rect.y + rect.height, frame.height);
+
+                for (int y = y0; y < y1; y++) {
+                    int row = y * frame.width;
+                    int x = x0;
+
+                    while (x < x1) {
+                        if (memcmp(&now[(row + x) * 3], &before[(row + x) * 3], 3) == 0) {
+                            x++;
+                            continue;
+                        }
+
+                        int end = x + 1, gap = 0;   // extend the span over changed pixels, allowing a few unchanged ones in between
+
+                        for (int scan = x + 1; scan < x1 && gap <= MAX_SPAN_GAP; scan++) {
+                            if (memcmp(&now[(row + scan) * 3], &before[(row + scan) * 3], 3) == 0) {
+                                gap++;
+                            } else {
+                                gap = 0;
+                                end = scan + 1;
+                            }
+                        }
+
+                        put_span(packet, frame, row + x, end - x);
+                        x = end;
+                    }
+                }
+            }
+        }
+
+        std::uint32_t payload = packet.size() - HEADER_SIZE;
+
+        for (int i = 0; i < 4; i++)
+            packet[8 + i] = (payload >> (i * 8)) & 0xFF;
+    }
+
+    void frame_stream::send_packet(std::vector<int>& targets) {
+        for (size_t i = 0; i < targets.size();) {
+            std::size_t sent = 0;
+
+            while (sent < packet.size()) {
+                ssize_t result = send(targets[i], packet.data() + sent, packet.size() - sent, MSG_NOSIGNAL);
+
+                if (result <= 0)
+                    break;
+
+                sent += result;
+            }
+
+            if (sent < packet.size()) {     // the viewer went away or is too slow, drop it
+                close(targets[i]);
+                targets.erase(targets.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+}
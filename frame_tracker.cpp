@@ -0,0 +1,333 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// frame_tracker.cpp
+// Implementation of the frame_tracker class
+//
+
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // the amount of frame buffers made up front, enough for the frame being drawn plus one held by each sink
+    const std::size_t INITIAL_POOL_SIZE = 4;
+
+    // how much room the text of a line snapshot starts out with, so text growing a character or two never allocates
+    const std::size_t SNAPSHOT_TEXT_RESERVE = 128;
+
+    // hash_bytes(std::uint64_t hash, const void* data, std::size_t length)
+    //      folds the given bytes into a running FNV-1a hash and returns the new hash
+    //      FNV-1a is not cryptographic, but it is very cheap and more than good enough to tell two frames apart
+    static std::uint64_t hash_bytes(std::uint64_t hash, const void* data, std::size_t length) {
+        const unsigned char* bytes = (const unsigned char*) data;
+
+        for (std::size_t i = 0; i < length; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;   // 64 bit FNV prime
+        }
+
+        return hash;
+    }
+
+    // returns true if both rectangles cover the exact same region
+    static bool same_bounds(const dirty_rect& first, const dirty_rect& second) {
+        return first.x == second.x && first.y == second.y && first.width == second.width && first.height == second.height;
+    }
+
+    // returns true if the two rectangles share at least one pixel
+    static bool overlaps(const dirty_rect& first, const dirty_rect& second) {
+        return first.x < second.x + second.width && second.x < first.x + first.width &&
+               first.y < second.y + second.height && second.y < first.y + first.height;
+    }
+
+    bool frame_tracker::same_look(const line_snapshot& first, const line_snapshot& second) {
+        return first.text == second.text && first.font == second.font && first.x == second.x && first.y == second.y &&
+               first.r == second.r && first.g == second.g && first.b == second.b;
+    }
+
+    void frame_tracker::begin_frame(int width, int height) {
+        current_line_count = 0;     // the snapshots themselves are kept and overwritten by add_line()
+        current_backgrounds.clear();
+
+        if (width != frame_width || height != frame_height) {   // a different canvas size means nothing from the old frame is comparable
+            frame_width = width;
+            frame_height = height;
+            has_previous = false;
+        }
+    }
+
+    void frame_tracker::add_background(const dirty_rect& region, const matrix_color& bg_color) {
+        current_backgrounds.push_back({region, bg_color.get_red(), bg_color.get_green(), bg_color.get_blue()});
+
+        if (previous_backgrounds.capacity() < current_backgrounds.size())   // the two vectors trade places every frame, grow both at once
+            previous_backgrounds.reserve(current_backgrounds.capacity());
+    }
+
+    void frame_tracker::add_line(std::string_view text, std::string_view font, int x, int y, const rgb_matrix::Color& color) {
+        if (current_line_count == current_lines.size()) {   // more lines than ever before, grow everything that depends on the line count once
+            current_lines.emplace_back();
+            current_lines.back().text.reserve(SNAPSHOT_TEXT_RESERVE);
+
+            // the line vectors trade places every frame, if only this one grew the next frame would still allocate even
+            // though it shows the same faces
+            if (previous_lines.size() < current_lines.size()) {
+                previous_lines.emplace_back();
+                previous_lines.back().text.reserve(SNAPSHOT_TEXT_RESERVE);
+            }
+
+            dirty_rects.reserve(current_lines.size() * 2);
+            erase_rects.reserve(current_lines.size());
+            redraw_lines.reserve(current_lines.size());
+        }
+
+        line_snapshot& snapshot = current_lines[current_line_count];
+        line_snapshot& other = previous_lines[current_line_count++];   // the snapshot this line is drawn into next frame
+        snapshot.text.assign(text);         // assigning keeps the memory the string already has
+        snapshot.font.assign(font);
+
+        if (other.text.capacity() < text.size() || other.font.capacity() < font.size()) {  // a longer line than ever before, same as above
+            other.text.reserve(text.size());
+            other.font.reserve(font.size());
+        }
+
+        snapshot.x = x;
+        snapshot.y = y;
+        snapshot.r = color.r;
+        snapshot.g = color.g;
+        snapshot.b = color.b;
+        snapshot.bounds = {0, 0, 0, 0};     // filled in by set_line_bounds() once the line has been drawn
+    }
+
+    std::uint64_t frame_tracker::hash_frame(const std::vector<background_snapshot>& backgrounds, const std::vector<line_snapshot>& lines, std::size_t line_count) const {
+        std::uint64_t hash = 14695981039346656037ULL;  // 64 bit FNV offset basis
+
+        for (const background_snapshot& background : backgrounds) {
+            int numbers[7] = {background.region.x, background.region.y, background.region.width, background.region.height,
+                              background.r, background.g, background.b};
+            hash = hash_bytes(hash, numbers, sizeof(numbers));
+        }
+
+        for (std::size_t i = 0; i < line_count; i++) {   // fold everything visible about every line into the hash
+            const line_snapshot& line = lines[i];
+            hash = hash_bytes(hash, line.text.data(), line.text.size() + 1);   // include the terminator so "ab"+"c" and "a"+"bc" differ
+            hash = hash_bytes(hash, line.font.data(), line.font.size() + 1);
+            int numbers[5] = {line.x, line.y, line.r, line.g, line.b};
+            hash = hash_bytes(hash, numbers, sizeof(numbers));
+        }
+
+        return hash;
+    }
+
+    bool frame_tracker::unchanged(void) const {
+        if (!has_previous || current_line_count != previous_line_count)
+            return false;
+
+        return hash_frame(current_backgrounds, current_lines, current_line_count) == previous_hash;
+    }
+
+    bool frame_tracker::same_backgrounds(void) const {
+        if (current_backgrounds.size() != previous_backgrounds.size())
+            return false;
+
+        for (size_t i = 0; i < current_backgrounds.size(); i++) {
+            const background_snapshot& now = current_backgrounds[i];
+            const background_snapshot& before = previous_backgrounds[i];
+
+            if (!same_bounds(now.region, before.region) || now.r != before.r || now.g != before.g || now.b != before.b)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool frame_tracker::plan_partial_redraw(void) {
+        erase_rects.clear();
+
+        // a new layout has to be drawn from scratch, and the sinks can only get a partial frame if we still have the last one to start from
+        if (!has_previous || current_line_count != previous_line_count || !same_backgrounds() || (!sinks.empty() && last_buffer == nullptr))
+            return false;
+
+        redraw_lines.assign(current_line_count, 0);
+
+        for (std::size_t i = 0; i < current_line_count; i++) {
+            if (same_look(current_lines[i], previous_lines[i])) {
+                current_lines[i].bounds = previous_lines[i].bounds;     // left alone, so it keeps the box it was drawn in
+            } else {
+                redraw_lines[i] = 1;
+
+                if (previous_lines[i].bounds.width > 0)
+                    erase_rects.push_back(previous_lines[i].bounds);    // the old text is painted over with the background first
+            }
+        }
+
+        // painting over a box also wipes whatever part of another line was inside it, so those lines are drawn again as well
+        for (std::size_t i = 0; i < current_line_count; i++) {
+            for (const dirty_rect& erased : erase_rects) {
+                if (!redraw_lines[i] && overlaps(previous_lines[i].bounds, erased))
+                    redraw_lines[i] = 1;
+            }
+        }
+
+        return true;
+    }
+
+    void frame_tracker::redraw_overlapping(std::size_t line) {
+        for (std::size_t later = line + 1; later < current_line_count; later++) {
+            if (!redraw_lines[later] && overlaps(current_lines[later].bounds, current_lines[line].bounds))
+                redraw_lines[later] = 1;
+        }
+    }
+
+    rgb_matrix::Canvas* frame_tracker::get_canvas(rgb_matrix::Canvas* offscreen, bool partial) {
+        if (sinks.empty())
+            return offscreen;   // nobody reads the pixels, draw straight onto the matrix
+
+        current_buffer = nullptr;
+
+        // make the usual amount of buffers up front instead of on some later frame, sized to the canvas so the first frame drawn
+        // into each of them does not allocate either
+        while (buffer_pool.size() < INITIAL_POOL_SIZE) {
+            buffer_pool.push_back(std::make_shared<frame_buffer>());
+            mirror.attach(offscreen, buffer_pool.back().get());
+        }
+
+        for (std::shared_ptr<frame_buffer>& pooled : buffer_pool) {   // reuse a buffer that no sink is holding on to anymore
+            if (pooled.use_count() == 1) {
+                current_buffer = pooled;
+                break;
+            }
+        }
+
+        if (current_buffer == nullptr) {    // every buffer is still in use by a sink, grow the pool (this only happens a couple of times)
+            current_buffer = std::make_shared<frame_buffer>();
+            buffer_pool.push_back(current_buffer);
+        }
+
+        mirror.attach(offscreen, current_buffer.get());
+
+        if (partial)    // both buffers have the size of the canvas, so this copies without allocating
+            std::copy(last_buffer->pixels.begin(), last_buffer->pixels.end(), current_buffer->pixels.begin());
+
+        return &mirror;
+    }
+
+    void frame_tracker::set_line_bounds(int line, int x, int y, int width, int height) {
+        current_lines[line].bounds = {x, y, width, height};
+    }
+
+    void frame_tracker::commit_frame(void) {
+        dirty_rects.clear();
+
+        if (!has_previous || current_line_count != previous_line_count || !same_backgrounds()) {
+            dirty_rects.push_back({0, 0, frame_width, frame_height});   // first frame, new background, or a different face: everything is dirty
+        } else {
+            for (size_t i = 0; i < current_line_count; i++) {
+                const line_snapshot& now = current_lines[i];
+                const line_snapshot& before = previous_lines[i];
+
+                if (same_look(now, before))
+                    continue;   // this line looks exactly the same as last frame
+
+                // the old text has to be erased and the new text drawn, so both boxes are dirty (they are usually the same box)
+                if (before.bounds.width > 0)
+                    dirty_rects.push_back(before.bounds);
+
+                if (now.bounds.width > 0 && !same_bounds(now.bounds, before.bounds))
+                    dirty_rects.push_back(now.bounds);
+            }
+        }
+
+        previous_hash = hash_frame(current_backgrounds, current_lines, current_line_count);     // remember the hash of this frame so the next identical frame can be skipped
+        previous_lines.swap(current_lines);     // swap instead of copying, the current snapshots are overwritten on the next frame
+        std::swap(previous_line_count, current_line_count);
+        previous_backgrounds.swap(current_backgrounds);
+        last_buffer = current_buffer;
+        has_previous = true;
+    }
+
+    void frame_tracker::clear_frame(rgb_matrix::Canvas* offscreen) {
+        get_canvas(offscreen, false)->Clear();     // the mirror clears the pooled buffer too when there are sinks
+
+        frame_width = offscreen->width();
+        frame_height = offscreen->height();
+        dirty_rects.clear();
+        dirty_rects.push_back({0, 0, frame_width, frame_height});
+        last_buffer = current_buffer;
+        has_previous = false;
+    }
+
+    void frame_tracker::notify_sinks(void) const {
+        if (current_buffer == nullptr)
+            return;
+
+        for (frame_sink* sink : sinks) {
+            sink->push_frame(current_buffer, dirty_rects);
+        }
+    }
+
+    void mirrored_canvas::attach(rgb_matrix::Canvas* target, frame_buffer* buffer) {
+        this->target = target;
+        this->buffer = buffer;
+
+        if (buffer->width != target->width() || buffer->height != target->height()) {
+            buffer->width = target->width();
+            buffer->height = target->height();
+            buffer->pixels.assign(buffer->width * buffer->height * 3, 0);
+        }
+    }
+
+    void mirrored_canvas::SetPixel(int x, int y, std::uint8_t red, std::uint8_t green, std::uint8_t blue) {
+        target->SetPixel(x, y, red, green, blue);
+
+        if (x < 0 || y < 0 || x >= buffer->width || y >= buffer->height)
+            return;     // the fonts happily draw off screen, the matrix ignores those pixels so we do too
+
+        std::uint8_t* pixel = &buffer->pixels[(y * buffer->width + x) * 3];
+        pixel[0] = red;
+        pixel[1] = green;
+        pixel[2] = blue;
+    }
+
+    void mirrored_canvas::Clear() {
+        target->Clear();
+        std::fill(buffer->pixels.begin(), buffer->pixels.end(), 0);
+    }
+
+    void mirrored_canvas::Fill(std::uint8_t red, std::uint8_t green, std::uint8_t blue) {
+        target->Fill(red, green, blue);
+
+        for (size_t i = 0; i < buffer->pixels.size(); i += 3) {
+            buffer->pixels[i] = red;
+            buffer->pixels[i + 1] = green;
+            buffer->pixels[i + 2] = blue;
+        }
+    }
+
+    headless_canvas::headless_canvas(int width, int height) {
+        buffer.width = width;
+        buffer.height = height;
+        buffer.pixels.assign(width * height * 3, 0);
+    }
+
+    void headless_canvas::SetPixel(int x, int y, std::uint8_t red, std::uint8_t green, std::uint8_t blue) {
+        if (x < 0 || y < 0 || x >= buffer.width || y >= buffer.height)
+            return;     // same as the matrix, pixels drawn off screen are dropped
+
+        std::uint8_t* pixel = &buffer.pixels[(y * buffer.width + x) * 3];
+        pixel[0] = red;
+        pixel[1] = green;
+        pixel[2] = blue;
+    }
+
+    void headless_canvas::Clear() {
+        std::fill(buffer.pixels.begin(), buffer.pixels.end(), 0);
+    }
+
+    void headless_canvas::Fill(std::uint8_t red, std::uint8_t green, std::uint8_t blue) {
+        for (size_t i = 0; i < buffer.pixels.size(); i += 3) {
+            buffer.pixels[i] = red;
+            buffer.pixels[i + 1] = green;
+            buffer.pixels[i + 2] = blue;
+        }
+    }
+}
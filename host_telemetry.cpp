@@ -0,0 +1,116 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// host_telemetry.cpp
+// Implementation of the host_telemetry class
+//
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // where every value is read from, indexed by host_telemetry::host_file
+    // the first thermal zone is the cpu on a Raspberry Pi
+    static const char* const HOST_PATHS[] = {
+        "/sys/class/thermal/thermal_zone0/temp", "/proc/loadavg", "/proc/meminfo", "/proc/uptime"
+    };
+
+    host_telemetry::host_telemetry() {
+        for (int i = 0; i < HOST_FILES; i++)
+            fds[i] = open(HOST_PATHS[i], O_RDONLY | O_CLOEXEC);     // the bot's commands fork, they do not need these
+
+        refreshed_ms = -1;
+        cpu_temp = load1 = 0;
+        mem_free = uptime_seconds = 0;
+    }
+
+    host_telemetry::~host_telemetry() {
+        for (int i = 0; i < HOST_FILES; i++) {
+            if (fds[i] != -1)
+                close(fds[i]);
+        }
+    }
+
+    bool host_telemetry::read_file(host_file file, char* buffer, std::size_t size) const {
+        if (fds[file] == -1)
+            return false;
+
+        // proc and sys files are generated again on every read from offset 0, so the same descriptor always gives the current value
+        ssize_t count = pread(fds[file], buffer, size - 1, 0);
+
+        if (count <= 0)
+            return false;
+
+        buffer[count] = '\0';
+        return true;
+    }
+
+    void host_telemetry::refresh(void) {
+        std::int64_t now = clock_source::get_monotonic_ms();
+
+        if (refreshed_ms != -1 && now - refreshed_ms < REFRESH_MS)
+            return;
+
+        refreshed_ms = now;
+        char buffer[256];   // MemAvailable is the third line of meminfo, well within the first 256 bytes
+
+        if (read_file(thermal, buffer, sizeof(buffer)))
+            cpu_temp = (int) ((std::strtol(buffer, nullptr, 10) + 500) / 1000);    // millidegrees
+
+        if (read_file(loadavg, buffer, sizeof(buffer)))
+            load1 = (int) ((std::strtod(buffer, nullptr) * 100) + 0.5);
+
+        if (read_file(meminfo, buffer, sizeof(buffer))) {
+            const char* available = std::strstr(buffer, "MemAvailable:");
+
+            if (available != nullptr)
+                mem_free = std::strtol(available + std::strlen("MemAvailable:"), nullptr, 10) / 1024;    // kilobytes
+        }
+
+        if (read_file(uptime, buffer, sizeof(buffer)))
+            uptime_seconds = std::strtol(buffer, nullptr, 10);
+    }
+
+    bool host_telemetry::append_variable(std::string_view name, std::string& output) {
+        host_file file;
+
+        if (name == "cpu_temp") file = thermal;
+        else if (name == "load1") file = loadavg;
+        else if (name == "mem_free") file = meminfo;
+        else if (name == "uptime") file = uptime;
+        else return false;
+
+        if (fds[file] == -1) {  // not there on this machine
+            output += '-';
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(telemetry_lock);
+        refresh();
+
+        if (file == thermal) {
+            append_number(output, cpu_temp);
+        } else if (file == loadavg) {
+            append_number(output, load1 / 100);
+            output += '.';
+            append_number(output, load1 % 100, 2);
+        } else if (file == meminfo) {
+            append_number(output, mem_free);
+        } else if (uptime_seconds >= 86400) {
+            append_number(output, uptime_seconds / 86400);
+            output += "d ";
+            append_number(output, (uptime_seconds % 86400) / 3600);
+            output += 'h';
+        } else {
+            append_number(output, uptime_seconds / 3600);
+            output += "h ";
+            append_number(output, (uptime_seconds % 3600) / 60);
+            output += 'm';
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,293 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// line_condition.cpp
+// Implementation of the line_condition class, compiling and running visible_if expressions
+//
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // the names an expression can use, indexed by line_condition::variable
+    static const char* const VARIABLE_NAMES[line_condition::VARIABLES] = {
+        "hour", "hour24", "minute", "second", "temp", "temp_feel", "humidity", "day_low", "day_high", "wind_speed",
+        "condition", "month", "month_day", "week_day_num", "year", "timer_running"
+    };
+
+    // parenthesis and unary operators do not grow the stack, this keeps them from nesting deep enough to run out of call stack
+    static const int MAX_NESTING = 64;
+
+    // condition_parser struct
+    //      A recursive descent parser writing the program in postfix order while it reads the expression
+    //      From loosest to tightest: ||, &&, comparisons, + and -, * / and %, then ! and unary -
+    struct condition_parser {
+        std::string_view text;
+        std::size_t position = 0;
+        std::vector<line_condition::op>& output;
+        int depth = 0;          // values on the stack at this point of the program
+        int nesting = 0;
+
+        condition_parser(std::string_view text, std::vector<line_condition::op>& output) : text(text), output(output) {}
+
+        [[noreturn]] void fail(const std::string& reason) const {
+            throw std::invalid_argument("visible_if \"" + std::string(text) + "\" " + reason + " at position " + std::to_string(position));
+        }
+
+        void skip_space(void) {
+            while (position < text.size() && std::isspace((unsigned char) text[position]))
+                position++;
+        }
+
+        // consumes the token if it is next, the text is never a prefix of a longer operator ("<" does not match "<=")
+        bool accept(std::string_view token) {
+            skip_space();
+
+            if (text.substr(position, token.size()) != token)
+                return false;
+
+            if (token.size() == 1 && position + 1 < text.size()) {
+                char next = text[position + 1];
+
+                if ((token == "<" || token == ">" || token == "!") && next == '=')
+                    return false;
+            }
+
+            position += token.size();
+            return true;
+        }
+
+        void emit(line_condition::op_code code, line_condition::variable value = line_condition::hour, float number = 0) {
+            if (code == line_condition::push_number || code == line_condition::push_variable) {
+                if (++depth > line_condition::MAX_STACK)
+                    fail("is too deeply nested");
+            } else if (code != line_condition::negate && code != line_condition::logical_not) {
+                depth--;    // every binary operator takes two values and leaves one
+            }
+
+            output.push_back({code, value, number});
+        }
+
+        void parse_or(void) {
+            parse_and();
+
+            while (accept("||")) {
+                parse_and();
+                emit(line_condition::logical_or);
+            }
+        }
+
+        void parse_and(void) {
+            parse_comparison();
+
+            while (accept("&&")) {
+                parse_comparison();
+                emit(line_condition::logical_and);
+            }
+        }
+
+        void parse_comparison(void) {
+            parse_sum();
+
+            // comparisons do not chain, "a < b < c" almost never means what it says
+            static const std::pair<std::string_view, line_condition::op_code> COMPARISONS[] = {
+                {"<=", line_condition::less_equal}, {">=", line_condition::greater_equal}, {"==", line_condition::equal},
+                {"!=", line_condition::not_equal}, {"<", line_condition::less}, {">", line_condition::greater}
+            };
+
+            for (const auto& comparison : COMPARISONS) {
+                if (accept(comparison.first)) {
+                    parse_sum();
+                    emit(comparison.second);
+                    return;
+                }
+            }
+        }
+
+        void parse_sum(void) {
+            parse_product();
+
+            while (true) {
+                if (accept("+")) {
+                    parse_product();
+                    emit(line_condition::add);
+                } else if (accept("-")) {
+                    parse_product();
+                    emit(line_condition::subtract);
+                } else {
+                    return;
+                }
+            }
+        }
+
+        void parse_product(void) {
+            parse_unary();
+
+            while (true) {
+                line_condition::op_code code;
+
+                if (accept("*")) code = line_condition::multiply;
+                else if (accept("/")) code = line_condition::divide;
+                else if (accept("%")) code = line_condition::modulo;
+                else return;
+
+                parse_unary();
+                emit(code);
+            }
+        }
+
+        void parse_unary(void) {
+            if (++nesting > MAX_NESTING)
+                fail("is too deeply nested");
+
+            if (accept("!")) {
+                parse_unary();
+                emit(line_condition::logical_not);
+            } else if (accept("-")) {
+                parse_unary();
+                emit(line_condition::negate);
+            } else {
+                parse_value();
+            }
+
+            nesting--;
+        }
+
+        void parse_value(void) {
+            skip_space();
+
+            if (accept("(")) {
+                parse_or();
+
+                if (!accept(")"))
+                    fail("is missing a )");
+
+                return;
+            }
+
+            if (position < text.size() && (std::isdigit((unsigned char) text[position]) || text[position] == '.')) {
+                std::size_t end = position;
+
+                while (end < text.size() && (std::isdigit((unsigned char) text[end]) || text[end] == '.'))
+                    end++;
+
+                std::string digits(text.substr(position, end - position));
+                char* parsed = nullptr;
+                float number = std::strtof(digits.c_str(), &parsed);
+
+                if (*parsed != '\0')
+                    fail("has a broken number " + digits);
+
+                position = end;
+                emit(line_condition::push_number, line_condition::hour, number);
+                return;
+            }
+
+            // variables may be written like in the text ({temp}) or without the braces (temp)
+            bool braced = accept("{");
+            std::size_t start = position;
+
+            while (position < text.size() && (std::isalnum((unsigned char) text[position]) || text[position] == '_'))
+                position++;
+
+            std::string_view name = text.substr(start, position - start);
+
+            if (name.empty())
+                fail(position < text.size() ? "has an unexpected " + std::string(1, text[position]) : "ends too early");
+
+            if (braced && !accept("}"))
+                fail("is missing a }");
+
+            if (name == "true" || name == "false") {
+                emit(line_condition::push_number, line_condition::hour, name == "true" ? 1 : 0);
+                return;
+            }
+
+            for (int i = 0; i < line_condition::VARIABLES; i++) {
+                if (name == VARIABLE_NAMES[i]) {
+                    emit(line_condition::push_variable, (line_condition::variable) i);
+                    return;
+                }
+            }
+
+            position = start;
+            fail("uses the unknown variable " + std::string(name));
+        }
+    };
+
+    void line_condition::compile(std::string_view expression, std::vector<op>& output) {
+        condition_parser parser(expression, output);
+        parser.parse_or();
+        parser.skip_space();
+
+        if (parser.position != expression.size())
+            parser.fail("has an unexpected " + std::string(1, expression[parser.position]));
+    }
+
+    bool line_condition::evaluate(array_view<op> program, const float values[]) {
+        if (program.empty())
+            return true;
+
+        float stack[MAX_STACK];
+        int top = 0;    // index of the first free slot
+
+        for (const op& instruction : program) {
+            if (instruction.code == push_number) {
+                stack[top++] = instruction.number;
+                continue;
+            }
+
+            if (instruction.code == push_variable) {
+                stack[top++] = values[instruction.value];
+                continue;
+            }
+
+            float& last = stack[top - 1];
+
+            if (instruction.code == negate) {
+                last = -last;
+                continue;
+            }
+
+            if (instruction.code == logical_not) {
+                last = last == 0;
+                continue;
+            }
+
+            float right = stack[--top];
+            float& left = stack[top - 1];
+
+            switch (instruction.code) {
+                case add: left += right; break;
+                case subtract: left -= right; break;
+                case multiply: left *= right; break;
+                case divide: left = right == 0 ? 0 : left / right; break;     // nothing to show for it, but no reason to stop the clock
+                case modulo: left = right == 0 ? 0 : std::fmod(left, right); break;
+                case less: left = left < right; break;
+                case less_equal: left = left <= right; break;
+                case greater: left = left > right; break;
+                case greater_equal: left = left >= right; break;
+                case equal: left = left == right; break;
+                case not_equal: left = left != right; break;
+                case logical_and: left = left != 0 && right != 0; break;
+                case logical_or: left = left != 0 || right != 0; break;
+                default: break;
+            }
+        }
+
+        return stack[0] != 0;
+    }
+
+    bool line_condition::uses(array_view<op> program, variable value) {
+        for (const op& instruction : program) {
+            if (instruction.code == push_variable && instruction.value == value)
+                return true;
+        }
+
+        return false;
+    }
+}
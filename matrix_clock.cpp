@@ -8,14 +8,18 @@
 //
 
 #include <chrono>
+#include <cmath>
+#include <future>
 #include <thread>
 #include <signal.h>
+#include <unistd.h>
 #include <iostream>
 #include <jsoncpp/json/json.h>
 #include <wiringPi.h>
 
 #include "matrix_clock.h"
 #include "matrix_telegram.h"
+#include "matrix_stream.h"
 #include "led-matrix.h"
 #include "graphics.h"
 
@@ -27,49 +31,766 @@ using namespace std;
 // boolean that checks if there is an interrupt pushed to the system
 volatile bool interrupt_received = false;
 
+// the eventfd the main loop waits on while the clock is in deep idle, -1 until there is one
+static int idle_wake_fd = -1;
+
 // Control-C interrupt to kill the program
 static void InterruptHandler(int signal) {
     interrupt_received = true;
+
+    if (idle_wake_fd != -1) {   // end a deep idle wait right away instead of up to a minute later
+        uint64_t one = 1;
+
+        if (write(idle_wake_fd, &one, sizeof(one)) != sizeof(one))
+            return;     // nothing else can be done from a signal handler
+    }
 }
 
-// loads in matrix default options from the given configuration file
+// reads and parses the config file, returns false (after saying why) if it is not valid JSON
+bool parse_config(const string& config_file, Json::Value* config);
+
+// loads in matrix default options from the matrix_options section of the parsed config file
 // values loaded: hardware mapping, rows, cols, chains, parallel displays, brightness, refresh rate limit, and gpio slowdown
-void load_matrix_defaults(string config_file, RGBMatrix::Options* options, rgb_matrix::RuntimeOptions* runtime_options);
+// the options only point at the hardware mapping, so it is stored in the given string which must outlive the matrix
+// deep_idle is set if the matrix should be shut down while the clock is off
+void load_matrix_defaults(const Json::Value& config, RGBMatrix::Options* options, rgb_matrix::RuntimeOptions* runtime_options, string* hardware_mapping, bool* deep_idle);
+
+// returns how long the main loop can sleep before something on screen may change
+// that is the next second of the wall clock, the next second shown on the timer, the next timer deadline, or the next frame
+// while centiseconds are shown (frame_time, -1 if they are not), whichever comes first
+int get_sleep_time(const matrix_clock::matrix_timer& shown_timer, const matrix_clock::timer_set& timers, int frame_time) {
+    int sleep_time = 1000 - (matrix_clock::clock_source::get_wall_ms() % 1000);    // the wall clock flips over to its next second
+    int timer_time = shown_timer.get_ms_to_next_second();
+    int deadline_time = timers.get_ms_to_next_deadline();
+
+    if (timer_time != -1) sleep_time = std::min(sleep_time, timer_time);
+    if (deadline_time != -1) sleep_time = std::min(sleep_time, deadline_time);
+
+    if (frame_time != -1 && frame_time < sleep_time)
+        return frame_time;      // frames only need to be roughly evenly spaced
+
+    return sleep_time + 2;      // wake up just after the change, not just before it
+}
+
+// plays the schedule in the config file through on a virtual clock instead of showing it on the matrix
+// it runs the very same ticks as the clock, every face change and every message the bot would send is logged with the simulated
+// time it happened at, and how fast the simulation ran is reported at the end
+// the faces are still drawn (on a headless canvas the size of the matrix) so drawing is part of what gets measured
+int run_simulation(const string& config_file, int days, int width, int height, bool deep_idle);
+
+// checks the parsed config file without running the clock, every problem config_checker finds is printed along with
+// an estimate of what each clock face costs to draw, returns EXIT_FAILURE if there were any errors
+// like a simulation it never touches the matrix, the GPIO pins, the network, or the variable sources
+int run_check(const string& config_file, const Json::Value& config, int width, int height);
+
+// fills a display of the canvas with its background color
+// a display covering the whole canvas uses the (much faster) Fill() of the canvas
+void fill_display(rgb_matrix::Canvas* canvas, const matrix_clock::display_region& display, const matrix_clock::matrix_color& color) {
+    if (display.get_x() == 0 && display.get_y() == 0 && display.get_width() == canvas->width() && display.get_height() == canvas->height()) {
+        canvas->Fill(color.get_red(), color.get_green(), color.get_blue());
+    } else if (color.get_red() != 0 || color.get_green() != 0 || color.get_blue() != 0) {  // black is already there from Clear()
+        for (int y = display.get_y(); y < display.get_y() + display.get_height(); y++) {
+            for (int x = display.get_x(); x < display.get_x() + display.get_width(); x++)
+                canvas->SetPixel(x, y, color.get_red(), color.get_green(), color.get_blue());
+        }
+    }
+}
+
+// paints the given region of the canvas the way the background of a full redraw would, black outside of the displays
+void erase_region(rgb_matrix::Canvas* canvas, const matrix_clock::dirty_rect& region, const std::vector<const matrix_clock::clock_face*>& faces,
+                  const std::vector<matrix_clock::display_region>& displays) {
+    int x1 = std::min(region.x + region.width, canvas->width()), y1 = std::min(region.y + region.height, canvas->height());
+
+    for (int y = std::max(region.y, 0); y < y1; y++) {
+        for (int x = std::max(region.x, 0); x < x1; x++) {
+            matrix_clock::matrix_color color(matrix_clock::matrix_prebuilt_colors::black);
+
+            for (size_t display_index = 0; display_index < displays.size(); display_index++) {
+                const matrix_clock::display_region& display = displays[display_index];
+
+                if (x >= display.get_x() && x < display.get_x() + display.get_width() && y >= display.get_y() && y < display.get_y() + display.get_height())
+                    color = faces[display_index]->get_background_color();
+            }
+
+            canvas->SetPixel(x, y, color.get_red(), color.get_green(), color.get_blue());
+        }
+    }
+}
 
 // update clock method
-// take in the offscreen canvas to draw to
-// the clock_face is the current clock face shown on the screen
+// take in the offscreen canvas to draw to, a frame canvas of the matrix or any other canvas when there is no matrix
+// onscreen is the canvas currently shown on the matrix (null if unknown), when only some lines changed it is copied and just those lines are drawn again
+// faces holds the clock face to show on every display, indexed the same as displays
 // variable utility is passed in to parse variables against
-void update_clock(rgb_matrix::FrameCanvas* offscreen, matrix_clock::clock_face* clock_face, matrix_clock::variable_utility* util, std::string font_folder, matrix_clock::matrix_timer* timer_info) {
-    offscreen->Clear(); // clear offscreen because it was previously swapped
+// fonts are grabbed from the font registry so every font is only read from disk once
+// text lines drawn before are copied out of the text cache, it may be null to draw every line glyph by glyph
+// the frame tracker remembers the last drawn frame, if nothing visible changed the canvas is left alone and false is returned
+// returns true if the canvas was redrawn and needs to be swapped onto the matrix
+// once the buffers below have grown to fit the faces being shown, this does not allocate anything
+bool update_clock(rgb_matrix::Canvas* offscreen, const rgb_matrix::FrameCanvas* onscreen, const std::vector<const matrix_clock::clock_face*>& faces, const std::vector<matrix_clock::display_region>& displays,
+                  matrix_clock::variable_utility* util, matrix_clock::font_registry* fonts, const std::string& font_folder,
+                  matrix_clock::text_raster_cache* text_cache, matrix_clock::frame_tracker* tracker) {
+    // a line after its variables were parsed, along with where it goes on the whole matrix
+    // the line itself is only referenced, it stays in the config arena
+    // weather icons are placed the same way with the sprite they show instead of a line
+    struct placed_line {
+        const matrix_clock::text_line* line;
+        const matrix_clock::sprite* image;
+        std::string text;
+        int x, y;
+    };
+
+    // parse every line first so we know if anything changed before drawing
+    // the lines are kept between calls (update_clock() only runs on the main thread) so their strings keep their memory,
+    // line_count says how many of them belong to this frame
+    static std::vector<placed_line> lines;
+    size_t line_count = 0;
+
+    // the values visible_if expressions run against, only read once a line with one comes up
+    float condition_values[matrix_clock::line_condition::VARIABLES];
+    bool have_condition_values = false;
+
+    tracker->begin_frame(offscreen->width(), offscreen->height());
+
+    for (size_t display_index = 0; display_index < displays.size(); display_index++) {
+        const matrix_clock::display_region& display = displays[display_index];
+        const matrix_clock::clock_face* clock_face = faces[display_index];
+
+        tracker->add_background({display.get_x(), display.get_y(), display.get_width(), display.get_height()}, clock_face->get_background_color());
+
+        for (int i = 0; i < clock_face->get_line_count(); i++) {    // loop through all lines to render
+            const matrix_clock::text_line& line = clock_face->get_line(i);
+
+            if (!line.get_visible_if().empty()) {
+                if (!have_condition_values) {
+                    util->get_condition_values(condition_values);
+                    have_condition_values = true;
+                }
+
+                if (!line.is_visible(condition_values))
+                    continue;   // hidden lines are left out of the frame altogether, the tracker sees them as gone
+            }
+
+            if (line_count == lines.size()) {   // more lines than ever before, give the new one plenty of room to grow
+                lines.emplace_back();
+                lines.back().text.reserve(128);
+            }
+
+            placed_line& placed = lines[line_count++];
+            placed.line = &line;  // grab current line from the clock face
+            placed.image = nullptr;
+            placed.line->parse_variables(util, display.get_width(), placed.text);     // parse the variables into actual data
+
+            // parse_x() can truncate the text, so grab the x before recording it
+            // positions in the config are relative to the display, move them to where the display is on the matrix
+            placed.x = placed.line->parse_x(display.get_width(), placed.text) + display.get_x();
+            placed.y = placed.line->get_y() + display.get_y();
+
+            tracker->add_line(placed.text, placed.line->get_font().get_font(), placed.x, placed.y, placed.line->get_color());
+        }
+
+        for (int i = 0; i < clock_face->get_icon_count(); i++) {    // the weather icons go on top of the text
+            const matrix_clock::weather_icon& icon = clock_face->get_icon(i);
+            const matrix_clock::sprite* image = icon.get_sprite(util->get_condition());
+
+            if (image == nullptr)
+                continue;   // no icon for the current weather
+
+            if (line_count == lines.size()) {
+                lines.emplace_back();
+                lines.back().text.reserve(128);
+            }
 
-    matrix_clock::matrix_color bg_color = clock_face->get_background_color();
-    offscreen->Fill(bg_color.get_red(), bg_color.get_green(), bg_color.get_blue());
+            placed_line& placed = lines[line_count++];
+            placed.line = nullptr;
+            placed.image = image;
+            placed.x = icon.get_x(display.get_width(), image->get_width()) + display.get_x();
+            placed.y = icon.get_y() + display.get_y();
 
-    for (int i = 0; i < clock_face->get_line_count(); i++) {    // loop through all lines to render
-        matrix_clock::text_line current_line = clock_face->get_line(i);  // grab current line from the clock face
-        current_line.parse_variables(util, offscreen->width());     // parse the variables into actual data
+            tracker->add_sprite(image->get_name(), placed.x, placed.y);
+        }
+    }
+
+    if (tracker->unchanged())   // the exact same pixels are already on the matrix, skip drawing and swapping
+        return false;
+
+    bool partial = onscreen != nullptr && tracker->plan_partial_redraw();
+    rgb_matrix::Canvas* canvas = tracker->get_canvas(offscreen, partial);   // either the offscreen canvas or a mirror of it for the frame sinks
+
+    if (partial) {
+        // start from what is on the matrix right now and only touch the lines that changed
+        // there only is an onscreen canvas when drawing on the matrix, and then offscreen is one of its frame canvases as well
+        static_cast<rgb_matrix::FrameCanvas*>(offscreen)->CopyFrom(*onscreen);
+
+        for (const matrix_clock::dirty_rect& region : tracker->get_erase_rects())
+            erase_region(canvas, region, faces, displays);
+    } else {
+        canvas->Clear(); // clear offscreen because it was previously swapped
+
+        for (size_t display_index = 0; display_index < displays.size(); display_index++)
+            fill_display(canvas, displays[display_index], faces[display_index]->get_background_color());
+    }
+
+    for (size_t i = 0; i < line_count; i++) {
+        if (partial && !tracker->needs_redraw(i))
+            continue;   // the copy already has this line
 
-        if (timer_info != nullptr)
-            current_line.parse_variables(util, offscreen->width());
+        placed_line& current = lines[i];
 
-        rgb_matrix::Font font; // convert our font to the font declared in the matrix_library
-        font.LoadFont(matrix_clock::matrix_font::get_font_file(font_folder, current_line.get_font().get_font()).c_str());
+        if (current.image != nullptr) {     // the sprite was decoded when the config was loaded, this only copies its pixels
+            current.image->draw(canvas, current.x, current.y);
+            tracker->set_line_bounds(i, current.x, current.y, current.image->get_width(), current.image->get_height());
+
+            if (partial)
+                tracker->redraw_overlapping(i);
+
+            continue;
+        }
+
+        // grab the already loaded font declared in the matrix_library for our font
+        const rgb_matrix::Font* font = fonts->get_font(font_folder, current.line->get_font().get_font());
 
         // draw the text using the color, positionings, and matrix_font size declared on the off screen campus
-        rgb_matrix::DrawText(offscreen, font, current_line.parse_x(offscreen->width()), current_line.get_y(),
-                             current_line.get_color(), current_line.get_parsed_text().c_str());
+        int width = text_cache != nullptr ? text_cache->draw(canvas, *font, current.x, current.y, current.line->get_color(), current.text)
+                                          : rgb_matrix::DrawText(canvas, *font, current.x, current.y, current.line->get_color(), current.text.c_str());
+
+        // the y position is the baseline, so the glyphs start baseline pixels above it
+        tracker->set_line_bounds(i, current.x, current.y - font->baseline(), width, font->height());
+
+        if (partial)
+            tracker->redraw_overlapping(i);
+    }
+
+    tracker->commit_frame();
+    return true;
+}
+
+// what the clock loop draws on, the matrix when the clock runs and a canvas in memory when a config is simulated
+// the loop makes every decision itself, the host only does what needs the hardware (or pretends to)
+class clock_host {
+    public:
+        virtual ~clock_host() {}
+
+        // starts the matrix (again, after deep idle), returns false if it could not be started
+        virtual bool start(void) = 0;
+
+        // stops the matrix altogether for deep idle
+        virtual void stop(void) = 0;
+
+        // returns true while the matrix runs
+        virtual bool is_running(void) const = 0;
+
+        // returns the canvas the next frame is drawn on
+        virtual rgb_matrix::Canvas* get_offscreen(void) = 0;
+
+        // returns the canvas shown right now, null if there is none to copy a partial redraw from
+        virtual const rgb_matrix::FrameCanvas* get_onscreen(void) const = 0;
+
+        // puts the frame drawn on the offscreen canvas up
+        virtual void present(void) = 0;
+
+        // switches the buzzer on the given pin on or off
+        virtual void set_buzzer(int pin, bool on) = 0;
+
+        // waits the given milliseconds until the next tick
+        virtual void sleep(int milliseconds) = 0;
+
+        // waits up to the given milliseconds in deep idle, turning the clock back on ends the wait right away
+        virtual void idle(matrix_clock::matrix_data& clock_data, int milliseconds) = 0;
+};
+
+// the clock on the LED matrix
+class matrix_host : public clock_host {
+    private:
+        const RGBMatrix::Options& options;
+        const rgb_matrix::RuntimeOptions& runtime_options;
+
+        RGBMatrix* matrix = NULL;
+        rgb_matrix::FrameCanvas* offscreen = nullptr;
+        rgb_matrix::FrameCanvas* onscreen = nullptr;    // SwapOnVSync() hands back the canvas that was shown before it
+    public:
+        inline matrix_host(const RGBMatrix::Options& options, const rgb_matrix::RuntimeOptions& runtime_options) : options(options), runtime_options(runtime_options) {}
+        inline ~matrix_host() { delete matrix; }   // free up the matrix memory
+
+        bool start(void) override {
+            matrix = RGBMatrix::CreateFromOptions(options, runtime_options);   // create matrix from options declared in config file
+
+            if (matrix == NULL)
+                return false;
+
+            if (matrix_clock::thread_placement::is_enabled())
+                matrix_clock::thread_placement::report_refresh_thread();
+
+            offscreen = matrix->CreateFrameCanvas();
+            onscreen = nullptr;
+            return true;
+        }
+
+        void stop(void) override {
+            delete matrix;  // this also stops the refresh thread and blanks the panels
+            matrix = NULL;
+            offscreen = onscreen = nullptr;
+        }
+
+        bool is_running(void) const override { return matrix != NULL; }
+        rgb_matrix::Canvas* get_offscreen(void) override { return offscreen; }
+        const rgb_matrix::FrameCanvas* get_onscreen(void) const override { return onscreen; }
+
+        void present(void) override {
+            onscreen = offscreen;
+            offscreen = matrix->SwapOnVSync(offscreen);
+        }
+
+        void set_buzzer(int pin, bool on) override { digitalWrite(pin, on ? HIGH : LOW); }
+        void sleep(int milliseconds) override { std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds)); }
+        void idle(matrix_clock::matrix_data& clock_data, int milliseconds) override { clock_data.wait_for_clock_on(milliseconds); }
+};
+
+// the clock on a canvas in memory, running on the virtual clock of a simulation
+class simulated_host : public clock_host {
+    private:
+        matrix_clock::headless_canvas canvas;
+        bool running = true;
+    public:
+        inline simulated_host(int width, int height) : canvas(width, height) {}
+
+        bool start(void) override { running = true; return true; }
+        void stop(void) override { running = false; }
+        bool is_running(void) const override { return running; }
+        rgb_matrix::Canvas* get_offscreen(void) override { return &canvas; }
+        const rgb_matrix::FrameCanvas* get_onscreen(void) const override { return nullptr; }   // the canvas still holds the last frame
+        void present(void) override {}
+        void set_buzzer(int pin, bool on) override {}   // a simulation never touches the GPIO pins
+
+        // jump straight to the next moment something could change instead of sleeping until then
+        void sleep(int milliseconds) override { matrix_clock::clock_source::advance(milliseconds); }
+        void idle(matrix_clock::matrix_data& clock_data, int milliseconds) override { matrix_clock::clock_source::advance(milliseconds); }
+};
+
+// the loop of the clock, the clock runs its ticks until the program is killed and a simulation until its days are over
+// both run the very same ticks, only the host (and with it the canvas, the buzzer, and how time passes) differs
+class clock_loop {
+    private:
+        clock_host& host;
+        matrix_clock::matrix_data& clock_data;
+        matrix_clock::variable_utility& time_util;
+        matrix_clock::font_registry& fonts;
+        matrix_clock::text_raster_cache& text_cache;
+        matrix_clock::frame_tracker& frame_tracker;
+        matrix_telegram_integration::matrix_telegram& telegram;
+        bool deep_idle;
+
+        matrix_clock::memory_stats* memory = nullptr;       // only the clock itself keeps stats and present timing
+        matrix_clock::present_timing* present = nullptr;
+
+        int times[4];
+
+        // the displays and the faces of this tick, copied out of clock_data so the bot can switch faces or reload while they are drawn
+        // it holds the configuration the faces come from for the whole tick, previous_config is the one previous_faces point into,
+        // held for as long as they are kept
+        matrix_clock::face_state state;
+        std::shared_ptr<const matrix_clock::config_arena> previous_config;
+
+        // the second last drawn
+        int previous_second;
+
+        // the second last shown on the timer, the timer runs on its own clock so its seconds do not line up with the wall clock's
+        int previous_timer_second = -1;
+
+        // the name of a timer that just finished, kept out here so it keeps its memory
+        std::string finished_timer;
+
+        // whether the timer was in its hold period last time around, the buzzer is turned off once it leaves it
+        bool was_holding = false;
+
+        // the faces drawn on the last tick, a tick showing the same faces without a forced update is steady and must not allocate
+        // timer_faces is where the faces are put together while a timer is shown, kept out here so it keeps its memory
+        std::vector<const matrix_clock::clock_face*> previous_faces;
+        std::vector<const matrix_clock::clock_face*> timer_faces;
+
+        // true while the faces on screen show {tcenti} and a timer is running, the screen is then redrawn many times a second
+        bool centisecond_mode = false;
+
+        // whether the time was inside one of the off periods last minute, the clock is switched when this changes
+        bool was_scheduled_off = false;
+
+        // copies the displays and the faces shown right now into state, call it again after the faces were updated
+        void refresh_faces(void);
+
+        // draws the faces on the offscreen canvas of the host, returns true if the frame changed
+        bool draw(const std::vector<const matrix_clock::clock_face*>& faces);
+
+        // hands the frame drawn to the sinks and puts it up
+        void present_frame(void);
+
+        // the tasks that run once a minute (new days, off periods, weather, faces, notifications, stats)
+        void run_minute_tasks(void);
+
+        // draws the current faces (or the timer) if anything on them could have changed
+        void draw_tick(bool new_minute);
+
+        // waits until the next tick is due, drawing the next second ahead of time if nothing but the wall clock can move until then
+        void wait(void);
+    public:
+        long renders = 0, frames = 0;
+
+        clock_loop(clock_host& host, matrix_clock::matrix_data& clock_data, matrix_clock::variable_utility& time_util, matrix_clock::font_registry& fonts,
+                   matrix_clock::text_raster_cache& text_cache, matrix_clock::frame_tracker& frame_tracker,
+                   matrix_telegram_integration::matrix_telegram& telegram, bool deep_idle);
+
+        inline void set_memory_stats(matrix_clock::memory_stats* stats) { memory = stats; }
+        inline void set_present_timing(matrix_clock::present_timing* timing) { present = timing; }
+
+        // draws the faces picked for the current time and puts them up right away, before the loop runs its first tick
+        void show_first_frame(void);
+
+        // runs one pass of the loop and waits until the next one is due
+        // returns false if the matrix could not be started again after deep idle
+        bool tick(void);
+};
+
+clock_loop::clock_loop(clock_host& host, matrix_clock::matrix_data& clock_data, matrix_clock::variable_utility& time_util, matrix_clock::font_registry& fonts,
+                       matrix_clock::text_raster_cache& text_cache, matrix_clock::frame_tracker& frame_tracker,
+                       matrix_telegram_integration::matrix_telegram& telegram, bool deep_idle)
+    : host(host), clock_data(clock_data), time_util(time_util), fonts(fonts), text_cache(text_cache), frame_tracker(frame_tracker), telegram(telegram), deep_idle(deep_idle) {
+    time_util.get_time(times);
+    previous_second = times[2];     // the first frame is already up, the loop starts drawing on the next second
+}
+
+void clock_loop::refresh_faces(void) {
+    clock_data.copy_state(state);
+}
+
+bool clock_loop::draw(const std::vector<const matrix_clock::clock_face*>& faces) {
+    renders++;
+    return update_clock(host.get_offscreen(), host.get_onscreen(), faces, state.displays, &time_util, &fonts, clock_data.get_fonts_folder(), &text_cache, &frame_tracker);
+}
+
+void clock_loop::present_frame(void) {
+    frame_tracker.notify_sinks();
+    host.present();
+    frames++;
+}
+
+void clock_loop::run_minute_tasks(void) {
+    if (time_util.is_new_day())     // if the day has changed, poll the new date data (date cannot change on a second)
+        time_util.poll_date();
+
+    // switch the clock on or off when an off period starts or ends, pressing the buttons in between still works
+    bool scheduled_off = clock_data.in_off_period(times[3], times[1], time_util.get_day_of_week());
+
+    if (scheduled_off != was_scheduled_off) {
+        was_scheduled_off = scheduled_off;
+        clock_data.set_clock_on(!scheduled_off);
+        clock_data.set_update_required(true);
+    }
+
+    if (!host.is_running()) {   // in deep idle the weather is polled rarely (or never), it is polled again on waking up
+        int idle_interval = clock_data.get_idle_weather_interval();
+
+        if (idle_interval > 0 && ((times[3] * 60) + times[1]) % idle_interval == 0)
+            time_util.poll_weather();
+    } else if (times[1] % 5 == 0) {   // if the minute is a multiple of 5, update weather info (weather API has a free polling limit, so i only update once every 5 minutes)
+        time_util.poll_weather();
+    }
+
+    // grab the interfaces again in case they changed, displays whose face is currently overridden keep it (interfaces cannot change on a second)
+    clock_data.update_clock_face(times[3], times[1], time_util.get_day_of_week());
+
+    if (telegram.is_enabled())  // as long as the bot is active, check to see if we need to send a push notification and do so if one is found
+        telegram.check_send_notifications(times[3], times[1], time_util.get_day_of_week());
+
+    if (text_cache.get_capacity() != clock_data.get_text_cache_size())    // pick up text cache settings changed by a reload
+        text_cache.resize(clock_data.get_text_cache_size());
+
+    if (memory != nullptr) {    // pick up stats settings changed by a reload, then write the stats if it is time to
+        memory->set_stats_file(clock_data.get_stats_file(), clock_data.get_stats_interval());
+        memory->write_stats(times[3], times[1]);
+    }
+}
+
+void clock_loop::draw_tick(bool new_minute) {
+    std::shared_ptr<matrix_clock::matrix_timer> shown_timer = time_util.get_timer();
+    bool timer_holding = shown_timer->is_shown(clock_data.get_timer_hold()) && shown_timer->in_hold_period();
+
+    if (was_holding && !timer_holding && clock_data.get_buzzer_pin() != -1)
+        host.set_buzzer(clock_data.get_buzzer_pin(), false);    // the hold period is over, make sure the buzzer does not stay on
+
+    was_holding = timer_holding;
+
+    // update only if:
+    //      1) we have a second count displayed on the screen that must update every second
+    //      2) there is no second count, BUT it is a new minute so we have to update anyways
+    //      3) there is a forced update
+    //      4) there is a timer
+    // do not update under ANY OTHER CIRCUMSTANCES
+    // in terms of the forced update above, this should not run a second time in the same loop unless it is somehow pressed at a new minute
+    if (!(state.contains_second_variable() || (!state.contains_second_variable() && new_minute) || clock_data.update_required() || time_util.has_timer()))
+        return;
+
+    if (clock_data.is_clock_on() && host.is_running()) {    // we check this here because we still want to update the interfaces and weather so it is accurate if the clock was off and turned back on
+        matrix_clock::allocation_guard tick_guard;  // only checks anything in ALLOC_CHECK builds
+        bool steady = !clock_data.update_required();
+        bool frame_changed;
+
+        if (shown_timer->is_shown(clock_data.get_timer_hold())) {    // show the timer until it is past its hold period
+            // the default next face to push to the clock, if we can blink then it will go to empty every other second
+            const matrix_clock::clock_face* next_timer_face = state.config->get_timer_face();
+
+            if (shown_timer->in_hold_period()) {
+                if (shown_timer->get_hold_seconds() % 2 == 1) { // buzz and show the clock face every other second starting right when the timer finishes
+                    if (clock_data.get_buzzer_pin() != -1)
+                        host.set_buzzer(clock_data.get_buzzer_pin(), true);
+                } else {
+                    if (clock_data.can_blink())
+                        next_timer_face = clock_data.get_empty_face();
+
+                    if (clock_data.get_buzzer_pin() != -1)  // stop buzzing and go black after every other second
+                        host.set_buzzer(clock_data.get_buzzer_pin(), false);
+                }
+            }
+
+            // update the clock with the timer face shown on the timer's display, the other displays keep their faces
+            // the display is read off the timer face of this tick, it always belongs to the displays copied along with it
+            timer_faces.assign(state.faces.begin(), state.faces.end());
+            timer_faces[state.config->get_timer_face()->get_display()] = next_timer_face;
+
+            steady = steady && timer_faces == previous_faces;
+            previous_faces.assign(timer_faces.begin(), timer_faces.end());
+            previous_config = state.config;
+
+            frame_changed = draw(timer_faces);
+        } else {
+            steady = steady && state.faces == previous_faces;
+            previous_faces.assign(state.faces.begin(), state.faces.end());
+            previous_config = state.config;
+
+            frame_changed = draw(state.faces);  // update normally if we do not have a timer
+        }
+
+        if (frame_changed)  // only swap if the frame is different from what is already on the matrix
+            present_frame();
+
+        tick_guard.check(steady);
+    }
+
+    if (clock_data.update_required()) {  // if there is a required update, set it to false so we do not force update again on new second
+        clock_data.set_update_required(false);
+
+        if (!clock_data.is_clock_on() && host.is_running()) {   // clear the screen if it was just turned off
+            // the tracked frame is no longer on the screen, it is redrawn once the clock turns back on
+            frame_tracker.clear_frame(host.get_offscreen());
+            present_frame();
+
+            if (deep_idle) {    // stop the matrix altogether, its refresh thread would otherwise keep scanning a black frame
+                host.stop();
+                cout << "Entering deep idle until the clock is turned back on" << endl;
+            }
+        }
+    }
+}
+
+void clock_loop::show_first_frame(void) {
+    refresh_faces();
+
+    // if we do not find a valid clock face for the given time, we will fill with an empty clock face to display nothing on the screen
+    update_clock(host.get_offscreen(), nullptr, state.faces, state.displays, &time_util, &fonts, clock_data.get_fonts_folder(), &text_cache, &frame_tracker);
+    renders++;
+    present_frame();
+}
+
+bool clock_loop::tick(void) {
+    if (!host.is_running() && clock_data.is_clock_on()) {   // coming out of deep idle, start the matrix again and catch up on everything
+        if (!host.start()) {
+            cerr << "Could not restart the matrix after deep idle" << endl;
+            return false;
+        }
+
+        time_util.poll_date();
+        time_util.poll_weather();   // the weather was polled rarely or not at all while idle
+        time_util.get_time(times);
+        clock_data.update_clock_face(times[3], times[1], time_util.get_day_of_week());
+        clock_data.set_update_required(true);
+        frame_tracker.invalidate();
+        previous_second = -1;       // draw right away instead of on the next second
+        cout << "Leaving deep idle" << endl;
+    }
+
+    refresh_faces();
+    time_util.get_time(times);  // update our times variable
+
+    int new_second = times[2];  // check the new second
+
+    // the loop wakes up right at timer deadlines, send a notification for every countdown that reached zero
+    while (time_util.get_timers().pop_finished(finished_timer)) {
+        if (clock_data.get_notify_on_timer_completion()) {  // send a push notification when a timer has completed if configured true in the config
+            if (finished_timer.empty())
+                telegram.send_message("Your timer has just ended!", true);
+            else
+                telegram.send_message("Your timer " + finished_timer + " has just ended!", true);
+        }
+    }
+
+    // a running timer is redrawn as soon as the second it shows changes instead of waiting for the wall clock's next second
+    std::shared_ptr<matrix_clock::matrix_timer> shown_timer = time_util.get_timer();
+    // once a countdown sits at zero its hold seconds keep counting instead, they drive the blinking and buzzing
+    int timer_second = shown_timer->is_shown(clock_data.get_timer_hold()) ? shown_timer->get_second() + (shown_timer->get_hold_seconds() * 60) : -1;
+    bool timer_changed = timer_second != previous_timer_second;
+
+    // only run the following code if the seconds have changed OR if the timer moved on to its next second
+    // otherwise sleep until one of them could
+    if (previous_second != new_second || timer_changed) {
+        bool wall_second = previous_second != new_second;
+        previous_timer_second = timer_second;
+
+        if (!wall_second || !clock_data.skip_second()) {   // we want to skip an extra second if the config was recently reloaded, more information in header file
+            bool new_minute = wall_second && times[2] == 0;    // create boolean for if the minute changed
+            previous_second = new_second;       // update previous second for next loop
+
+            if (new_minute) {   // specific tasks that happen every minute
+                run_minute_tasks();
+                refresh_faces();
+            }
+
+            // a source read in the background changed what it shows, faces without seconds would otherwise keep the old value until the minute
+            if (time_util.get_source_scheduler() != nullptr && time_util.get_source_scheduler()->take_changed())
+                clock_data.set_update_required(true);
+
+            draw_tick(new_minute);
+        } else {
+            clock_data.update_clock_face(times[3], times[1], time_util.get_day_of_week());
+        }
+    } else if (centisecond_mode && clock_data.is_clock_on() && host.is_running() && !clock_data.update_required()) {
+        // in between seconds only the centiseconds move, so the faces already on screen are drawn again
+        // the frame tracker sees that only the lines with centiseconds changed, and update_clock() only draws those
+        matrix_clock::allocation_guard tick_guard;
+
+        if (draw(previous_faces))
+            present_frame();
+
+        tick_guard.check(true);
     }
+
+    centisecond_mode = std::any_of(previous_faces.begin(), previous_faces.end(), [](const matrix_clock::clock_face* face) {
+        return face->contains_centisecond_variable();
+    }) && time_util.get_timers().any_running();
+
+    wait();
+    return true;
 }
 
+void clock_loop::wait(void) {
+    if (!host.is_running()) {
+        // in deep idle nothing is drawn, only the minute tasks (notifications, off periods, weather) and timer deadlines need
+        // the loop, turning the clock back on ends the wait right away
+        int idle_time = 60000 - (int) (matrix_clock::clock_source::get_wall_ms() % 60000) + 2;
+        int deadline_time = time_util.get_timers().get_ms_to_next_deadline();
+
+        if (deadline_time != -1)
+            idle_time = std::min(idle_time, deadline_time + 2);
+
+        host.idle(clock_data, idle_time);
+        previous_second = -1;   // a minute later the second is the same again, make sure the minute tasks still run
+        return;
+    }
+
+    // draw the next second ahead of time and put it up right as that second starts, instead of drawing it once it is already
+    // there, this is only done while nothing but the wall clock can move until then (timers run on their own clock, and
+    // forced updates, skipped seconds, new days, and off periods are all left to the tick itself)
+    std::int64_t next_second_ms = ((matrix_clock::clock_source::get_wall_ms() / 1000) + 1) * 1000;
+    bool next_minute = next_second_ms % 60000 == 0;
+    bool drawn_ahead = false;
+
+    if (clock_data.get_render_ahead() && !centisecond_mode && clock_data.is_clock_on() && !clock_data.update_required() && !clock_data.skipping_seconds()
+        && !time_util.get_timer()->is_shown(clock_data.get_timer_hold()) && !time_util.get_timers().any_running()
+        && (next_minute || state.contains_second_variable())) {
+        matrix_clock::clock_source::pin_wall_ms(next_second_ms);    // every variable on this thread now reads the coming second
+        time_util.get_time(times);
+
+        bool new_day = next_minute && times[3] == 0 && times[1] == 0;
+        bool switches_off = next_minute && clock_data.in_off_period(times[3], times[1], time_util.get_day_of_week()) != was_scheduled_off;
+
+        if (!new_day && !switches_off) {
+            if (next_minute) {  // the faces of the coming minute, the minute tasks pick the same ones again
+                clock_data.update_clock_face(times[3], times[1], time_util.get_day_of_week());
+                refresh_faces();
+            }
+
+            matrix_clock::allocation_guard ahead_guard;
+            bool steady = state.faces == previous_faces;
+            previous_faces.assign(state.faces.begin(), state.faces.end());
+            previous_config = state.config;
+
+            drawn_ahead = draw(state.faces);
+
+            ahead_guard.check(steady);
+        }
+
+        matrix_clock::clock_source::pin_wall_ms(0);
+    }
+
+    if (drawn_ahead) {
+        // swap first, the tick for the new second then finds the frame already up and has nothing left to draw
+        if (matrix_clock::clock_source::sleep_until_wall(next_second_ms)) {
+            host.present();
+            frames++;
+
+            if (present != nullptr)
+                present->record(matrix_clock::clock_source::get_wall_us() - (next_second_ms * 1000));
+
+            frame_tracker.notify_sinks();
+        } else {    // the wall clock was set back while waiting, the frame drawn ahead is for the wrong time and is drawn again
+            frame_tracker.invalidate();
+            clock_data.set_update_required(true);
+            previous_second = -1;
+        }
+    } else {
+        // sleep until the next time something on screen could change instead of checking every so often
+        int frame_time = centisecond_mode ? 1000 / clock_data.get_centisecond_rate() : -1;
+        host.sleep(get_sleep_time(*time_util.get_timer(), time_util.get_timers(), frame_time));
+    }
+}
+
+// returns the simulated time for the simulation log
+static string simulated_time(void) {
+    time_t now = matrix_clock::clock_source::get_wall_time();
+    char text[32];
+    strftime(text, sizeof(text), "%a %Y-%m-%d %H:%M:%S", localtime(&now));
+    return text;
+}
+
+// logs everything a simulated clock does besides drawing, with the simulated time it happened at
+class simulation_log : public matrix_clock::clock_observer {
+    private:
+        const matrix_clock::matrix_data& clock_data;
+    public:
+        long transitions = 0, messages = 0;
+
+        inline simulation_log(const matrix_clock::matrix_data& clock_data) : clock_data(clock_data) {}
+
+        void face_changed(std::size_t display, const matrix_clock::clock_face* from, const matrix_clock::clock_face* to) override {
+            cout << "[" << simulated_time() << "] " << clock_data.get_displays()[display].get_name() << ": " << from->get_name() << " -> " << to->get_name() << endl;
+            transitions++;
+        }
+
+        void message_sent(const std::string& message) override {
+            cout << "[" << simulated_time() << "] message: " << message << endl;
+            messages++;
+        }
+};
+
 int main(int argc, char* argv[]) {
+    matrix_clock::startup_report startup;   // times every phase from here until the clock is fully up
+
     if (argc < 3) { // make sure the minimum amount of arguments were provided for the program to run
         cerr << "Only " << argc << " arguments provided:" << endl;
-        cerr << "Usage: " << argv[0] << " --CONFIG <config file location>" << endl;
+        cerr << "Usage: " << argv[0] << " --CONFIG <config file location> [--SIMULATE <days> | --CHECK]" << endl;
         return EXIT_FAILURE;
     }
 
     string config_file;     // we are going to load both the config file path and the weather url the command arguments
+    int simulate_days = 0;  // how many days to simulate, 0 to run the clock normally
+    bool check_only = false;    // only check the config file, do not run the clock
 
     for (int i = 1; i < argc; i++) {    // loop through all the given arguments
         if (string(argv[i]) == "--CONFIG") {           // check if we found the config file specifier
@@ -78,37 +799,69 @@ int main(int argc, char* argv[]) {
             } else {
                 cerr << "--CONFIG requires an argument" << endl;   // otherwise warn the user
             }
+        } else if (string(argv[i]) == "--SIMULATE") {    // play the schedule through instead of running the clock
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                simulate_days = atoi(argv[++i]);
+            } else {
+                cerr << "--SIMULATE requires a number of days" << endl;
+                return EXIT_FAILURE;
+            }
+        } else if (string(argv[i]) == "--CHECK") {       // check the config file for mistakes and exit
+            check_only = true;
         }
     }
 
     if (config_file.empty())    // if either file is empty, count on the previous error messages saying what is wrong
         return EXIT_FAILURE;    // kill the program
 
-    // setup GPIO pins for the buzzer sensor
-    wiringPiSetupGpio();
-
     RGBMatrix::Options options;
     rgb_matrix::RuntimeOptions runtime_options;
+    string hardware_mapping;
+    bool deep_idle = false;
+    Json::Value config;     // the config file is read once, the matrix options and the clock data both come out of it
+
+    if (!parse_config(config_file, &config)) {
+        cerr << "Killing program, please enter valid JSON data into " << config_file << " and run again." << endl;
+        return EXIT_FAILURE;
+    }
 
     // load defaults declared in config file
-    load_matrix_defaults(config_file, &options, &runtime_options);
+    load_matrix_defaults(config, &options, &runtime_options, &hardware_mapping, &deep_idle);
+    startup.phase("config");
+
+    if (check_only)     // checked before anything else runs, it is meant to be used before the clock is ever started on a config
+        return run_check(config_file, config, options.cols * options.chain_length, options.rows * options.parallel);
 
-    // create matrix from options declared in config file
-    RGBMatrix *matrix = RGBMatrix::CreateFromOptions(options, runtime_options);
+    signal(SIGTERM, InterruptHandler); // declare interrupts for Control-C
+    signal(SIGINT, InterruptHandler);
+
+    if (simulate_days > 0)  // a simulation never touches the matrix or the GPIO pins
+        return run_simulation(config_file, simulate_days, options.cols * options.chain_length, options.rows * options.parallel, deep_idle);
+
+    // setup GPIO pins for the buzzer sensor
+    wiringPiSetupGpio();
+
+    // deep idle keeps root for starting the matrix again, but only on this thread, every other thread gives it up as it starts
+    if (deep_idle && !matrix_clock::thread_privileges::keep_for_render("daemon"))
+        cerr << "There is no daemon user to run the bot and variable sources as, with deep idle they run as root" << endl;
+
+    // the render loop runs on this thread, it is placed before the matrix library drops root (real time priority needs it)
+    matrix_clock::thread_placement::apply(matrix_clock::thread_placement::render);
+
+    matrix_host host(options, runtime_options);
 
-    if (matrix == NULL) {   // kill the program if we cannot find the matrix
+    if (!host.start()) {   // kill the program if we cannot find the matrix
         cerr << "Could not create matrix" << endl;
         return EXIT_FAILURE;
     }
 
-    signal(SIGTERM, InterruptHandler); // declare interrupts for Control-C
-    signal(SIGINT, InterruptHandler);
-
-    rgb_matrix::FrameCanvas* offscreen = matrix->CreateFrameCanvas();   // create an offscreen canvas
+    startup.phase("matrix");
 
     matrix_clock::matrix_data clock_data(config_file);    // create clock data object and load data from the config file
+    clock_data.set_canvas_size(host.get_offscreen()->width(), host.get_offscreen()->height());    // displays without a size fill the matrix
+    clock_data.enable_gpio();   // wiringPiSetupGpio() ran above, the buzzer pin is set up as it is loaded (and on every reload)
 
-    if (!clock_data.load_clock_data()) {
+    if (!clock_data.load_clock_data(config)) {
         cerr << "Killing program, please enter valid JSON data into " << config_file << " and run again." << endl;
         return EXIT_FAILURE;
     }
@@ -118,10 +871,16 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE;
     }
 
-    matrix_clock::variable_utility time_util(clock_data.get_weather_url());   // generate a time util
+    idle_wake_fd = clock_data.get_wake_fd();
+    config = Json::Value();     // everything has been read out of it
+    startup.phase("clock faces");
 
-    time_util.poll_date();  // on first run, poll date and weather because they have not been loaded yet
-    time_util.poll_weather();
+    // generate a time util, polling the weather from the provider in the config
+    matrix_clock::variable_utility time_util(matrix_clock::weather_provider::create(clock_data.get_weather_provider(), clock_data.get_weather_url(), clock_data.get_weather_file()));
+    time_util.get_timers().set_hold(clock_data.get_timer_hold());
+    time_util.set_weather_cache(clock_data.get_weather_cache(), clock_data.get_weather_cache_ttl());    // shows the last good weather until the first poll
+
+    time_util.poll_date();  // on first run, poll the date because it has not been loaded yet, the weather is polled once the first frame is up
 
     int times[4];           // declare a times array to frequently update
     time_util.get_time(times);
@@ -129,147 +888,195 @@ int main(int argc, char* argv[]) {
     // load initial clock face by setting it to the current one in the container
     clock_data.update_clock_face(times[3], times[1], time_util.get_day_of_week());
 
+    // remembers what is on the screen so unchanged frames are not redrawn or swapped
+    matrix_clock::frame_tracker frame_tracker;
+
+    // every font is loaded once and shared by all displays
+    matrix_clock::font_registry fonts;
+
+    // publish every changed frame to remote viewers if a stream socket or port is configured
+    // the stream is only set up on launch, changing it requires a restart of the program
+    matrix_stream::frame_stream stream(clock_data.get_stream_socket(), clock_data.get_stream_bind(), clock_data.get_stream_port());
+
+    if (!clock_data.get_stream_socket().empty() || clock_data.get_stream_port() > 0) {
+        if (stream.start())
+            frame_tracker.add_sink(&stream);
+    }
+
+    // keeps the latest frame around for the /screenshot command of the telegram bot
+    matrix_clock::frame_capture screenshot_capture;
+
+    // lines of text that come back (minutes, day names, forecast words) are copied out of here instead of drawn glyph by glyph
+    matrix_clock::text_raster_cache text_cache;
+    text_cache.resize(clock_data.get_text_cache_size());
+
+    // tracks memory use from here on, reported through the bot and appended to the stats file if one is configured
+    matrix_clock::memory_stats memory;
+    memory.set_stats_file(clock_data.get_stats_file(), clock_data.get_stats_interval());
+    memory.set_text_cache(&text_cache);
+
+    // how long after the start of their second the frames drawn ahead were up on the matrix
+    matrix_clock::present_timing present;
+    memory.set_present_timing(&present);
+
     matrix_telegram_integration::matrix_telegram telegram_bot(&clock_data, &time_util);
+    telegram_bot.set_memory_stats(&memory);
+
+    if (clock_data.get_bot_token() != "disabled")
+        frame_tracker.add_sink(&screenshot_capture);
+
+    clock_loop loop(host, clock_data, time_util, fonts, text_cache, frame_tracker, telegram_bot, deep_idle);
+    loop.set_memory_stats(&memory);
+    loop.set_present_timing(&present);
+
+    // the first frame only waits for the fonts it shows, the weather is the cached one (or placeholders) until the poll below is done
+    loop.show_first_frame();
+
+    startup.phase("first frame");
+    startup.print_first_frame();
+
+    // everything below comes up in the background while the clock is already running
+    // the futures wait for their work to finish when they go out of scope, so nothing outlives what it uses
+    // both are started from this thread, so they are placed first instead of running on the cores and priority of the render loop
+    std::future<void> weather_ready = std::async(std::launch::async, [&time_util, &clock_data, &startup] {
+        matrix_clock::thread_placement::apply(matrix_clock::thread_placement::background);
+        matrix_clock::thread_privileges::drop_thread();
+
+        std::int64_t started = startup.background_start();
+        time_util.poll_weather();
+        clock_data.set_update_required(true);   // show the fresh weather right away instead of on the next minute
+        startup.background_done("weather", started);
+    });
+
+    // the fonts of the faces not shown yet are read now, so switching faces later never waits on the disk
+    std::future<void> fonts_ready = std::async(std::launch::async, [&fonts, &startup, sizes = clock_data.get_font_sizes(), folder = clock_data.get_fonts_folder()] {
+        matrix_clock::thread_placement::apply(matrix_clock::thread_placement::background);
+        matrix_clock::thread_privileges::drop_thread();
+
+        std::int64_t started = startup.background_start();
+
+        for (const std::string& size : sizes)
+            fonts.get_font(folder, size);
+
+        startup.background_done("fonts", started);
+    });
+
+    // reads the variable sources in the background, {src:name} variables only ever copy the last value read
+    matrix_clock::source_scheduler sources;
+    sources.set_sources(clock_data.get_variable_sources());
+    time_util.set_source_scheduler(&sources);
 
     // only enable the telegram bot if a valid key is entered
     // otherwise the user SHOULD put in disabled as instructed in the repo
     if (clock_data.get_bot_token() != "disabled") {
+        telegram_bot.set_frame_capture(&screenshot_capture);
         telegram_bot.enable_bot();
     }
 
-    // if we do not find a valid clock face for the given time, we will fill with an empty clock face to display nothing on the screen
-    update_clock(offscreen, clock_data.get_current(), &time_util, clock_data.get_fonts_folder(), nullptr);
-    offscreen = matrix->SwapOnVSync(offscreen);
-
     // inform console we are starting so there is at least some feedback in console
     cout << "Starting clock loop..." << endl;
 
-    // declare the previous second
-    int previous_second = times[2];
+    while (!interrupt_received) { // loop until the program is killed
+        if (!loop.tick())
+            return EXIT_FAILURE;
+    }
 
-    // on/off boolean for the state of the timer when it ends (whether to blink or buzz)
-    bool timer_notify = false;
+    return EXIT_SUCCESS;
+}
 
-    while (!interrupt_received) { // loop until the program is killed
-        time_util.get_time(times);  // update our times variable
+int run_simulation(const string& config_file, int days, int width, int height, bool deep_idle) {
+    // start at the beginning of the current minute, so the first minute change comes right away
+    matrix_clock::clock_source::simulate((matrix_clock::clock_source::get_wall_ms() / 60000) * 60000);
 
-        int new_second = times[2];  // check the new second
+    matrix_clock::matrix_data clock_data(config_file);
+    clock_data.set_canvas_size(width, height);
 
-        // only run the following code if the seconds have changed OR if a clock face has demanded an immediate update
-        // otherwise sleep for 0.2 seconds
-        if (previous_second != new_second) {
-            if (!clock_data.skip_second()) {   // we want to skip an extra second if the config was recently reloaded or if a timer started, more information in header file
-                bool new_minute = times[2] == 0;    // create boolean for if the minute changed
-                previous_second = new_second;       // update previous second for next loop
+    if (!clock_data.load_clock_data() || clock_data.get_clock_face_count() == 0) {
+        cerr << "Could not simulate " << config_file << ", it has no valid clock faces." << endl;
+        return EXIT_FAILURE;
+    }
 
-                if (new_minute) {            // specific tasks that happen every minute
-                    if (time_util.is_new_day())     // if the day has changed, poll the new date data (date cannot change on a second)
-                        time_util.poll_date();
+    // the weather is polled as often as on the clock, from the stub provider so a week of polls in a few seconds never runs
+    // into the API limit
+    matrix_clock::variable_utility time_util(std::make_unique<matrix_clock::stub_weather_provider>());
+    time_util.get_timers().set_hold(clock_data.get_timer_hold());
+    time_util.poll_date();
 
-                    if (times[1] % 5 == 0)   // if the minute is a multiple of 5, update weather info (weather API has a free polling limit, so i only update once every 5 minutes)
-                        time_util.poll_weather();
+    simulated_host host(width, height);
+    matrix_clock::frame_tracker frame_tracker;
+    matrix_clock::font_registry fonts;
+    matrix_clock::text_raster_cache text_cache;
+    text_cache.resize(clock_data.get_text_cache_size());
 
-                    if (!clock_data.clock_face_overridden())   // grab the interface again in case it changed as long as the face is not currently overridden (interfaces cannot change on a second)
-                        clock_data.update_clock_face(times[3], times[1], time_util.get_day_of_week());
+    // the bot is never started, whatever it would send goes to the log instead (whether or not a bot token is configured)
+    simulation_log log(clock_data);
+    matrix_telegram_integration::matrix_telegram telegram(&clock_data, &time_util);
+    telegram.set_dry_run(&log);
 
-                    if (clock_data.get_bot_token() != "disabled")   // as long as the bot is active, check to see if we need to send a push notification and do so if one is found
-                        telegram_bot.check_send_notifications(times[3], times[1], time_util.get_day_of_week());
-                }
+    int times[4];
+    time_util.get_time(times);
+    clock_data.update_clock_face(times[3], times[1], time_util.get_day_of_week());
 
-                // update only if:
-                //      1) we have a second count displayed on the screen that must update every second
-                //      2) there is no second count, BUT it is a new minute so we have to update anyways
-                //      3) there is a forced update
-                //      4) there is a timer
-                // do not update under ANY OTHER CIRCUMSTANCES
-                // in terms of the forced update above, this should not run a second time in the same loop unless it is somehow pressed at a new minute
-                if (clock_data.get_current()->contains_second_variable() || (!clock_data.get_current()->contains_second_variable() && new_minute) || clock_data.update_required() || time_util.has_timer()) {
-                    if (clock_data.is_clock_on()) {    // we check this here because we still want to update the interfaces and weather so it is accurate if the clock was off and turned back on
-                        if (time_util.has_timer() && time_util.get_timer()->can_tick(clock_data.get_timer_hold())) {    // update timer info as long as we can tick further (not past our hold period and started)
-                            matrix_clock::matrix_timer* timer = time_util.get_timer();
-
-                            if (timer->is_started()) {      // tick only if the timer is started
-                                int current_tick = timer->tick(clock_data.get_timer_hold());
-
-                                if (current_tick == 0) {    // tick is 0, the timer has just ended
-                                    if (clock_data.get_notify_on_timer_completion())
-                                        telegram_bot.send_message("Your timer has just ended!",true);  // send a push notification when a timer has completed if configured true in the config
-
-                                    timer_notify = true;    // set to true to begin the blinking/buzzing as applicable
-                                }
-                            }
-
-                            // the default next face to push to the clock, if we can blink then it will go to empty every other second
-                            matrix_clock::clock_face* next_timer_face = clock_data.get_timer_face();
-
-                            if (timer->in_hold_period()) {
-                                if (timer_notify) { // buzz and show the clock face every other second starting right when the timer finishes
-                                    if (clock_data.get_buzzer_pin() != -1)
-                                        digitalWrite(clock_data.get_buzzer_pin(), HIGH);
-                                } else {
-                                    if (clock_data.can_blink())
-                                        next_timer_face = clock_data.get_empty_face();
-
-                                    if (clock_data.get_buzzer_pin() != -1)  // stop buzzing and go black after every other second
-                                        digitalWrite(clock_data.get_buzzer_pin(), LOW);
-                                }
-
-                                timer_notify = !timer_notify;   // flip the flag variable for the next loop
-                            }
-
-                            update_clock(offscreen, next_timer_face, &time_util, clock_data.get_fonts_folder(), timer);     // update the clock face with the timer info and the timer face to show
-                        } else {
-                            update_clock(offscreen, clock_data.get_current(), &time_util, clock_data.get_fonts_folder(), nullptr); // update normally if we do not have a timer
-                        }
-
-                        offscreen = matrix->SwapOnVSync(offscreen);
-                    }
-
-                    if (clock_data.update_required()) {  // if there is a required update, set it to false so we do not force update again on new second
-                        clock_data.set_update_required(false);
-
-                        if (!clock_data.is_clock_on()) {   // clear the screen if it was just turned off
-                            offscreen->Clear();
-                            offscreen = matrix->SwapOnVSync(offscreen);
-                        }
-                    }
-                }
-            } else {
-                clock_data.update_clock_face(times[3], times[1], time_util.get_day_of_week());
-            }
-        }
+    cout << "Simulating " << days << " day(s) starting " << simulated_time() << endl;
+
+    matrix_clock::face_state start;
+    clock_data.copy_state(start);
+
+    for (size_t i = 0; i < start.displays.size(); i++)
+        cout << "[" << simulated_time() << "] " << start.displays[i].get_name() << " starts on " << start.faces[i]->get_name() << endl;
+
+    clock_data.set_observer(&log);  // every face change from here on is logged
 
-        // sleep for 0.2 seconds and check again
-        // we do this because C++ system time is not the most accurate
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    clock_loop loop(host, clock_data, time_util, fonts, text_cache, frame_tracker, telegram, deep_idle);
+    loop.show_first_frame();
+
+    std::int64_t end_ms = matrix_clock::clock_source::get_wall_ms() + (days * 86400000LL);
+    std::chrono::steady_clock::time_point real_start = std::chrono::steady_clock::now();
+    long ticks = 0;
+
+    while (!interrupt_received && matrix_clock::clock_source::get_wall_ms() < end_ms) {
+        ticks++;
+        loop.tick();    // the simulated host always starts again
     }
 
-    // free up the matrix memory
-    delete matrix;
+    clock_data.set_observer(nullptr);
+
+    double real_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - real_start).count();
+    double simulated_seconds = days * 86400.0;
+
+    cout << "Simulation finished at " << simulated_time() << endl;
+    cout << "    " << simulated_seconds << " simulated seconds in " << real_seconds << " seconds ("
+         << (long) (simulated_seconds / std::max(real_seconds, 0.000001)) << "x real time)" << endl;
+    cout << "    " << ticks << " ticks (" << (long) (ticks / std::max(real_seconds, 0.000001)) << " per second), "
+         << loop.renders << " renders, " << loop.frames << " frames drawn" << endl;
+    cout << "    " << log.transitions << " face transitions, " << log.messages << " messages" << endl;
+    cout << "    " << text_cache.report() << endl;
 
     return EXIT_SUCCESS;
 }
 
-void load_matrix_defaults(string config_file, RGBMatrix::Options* options, rgb_matrix::RuntimeOptions* runtime_options) {
-    try {
-        Json::Value jsonData;
-        JSONCPP_STRING error;
-        ifstream file_stream(config_file);  // open the config file
+bool parse_config(const string& config_file, Json::Value* config) {
+    JSONCPP_STRING error;
+    ifstream file_stream(config_file);  // open the config file
 
-        Json::CharReaderBuilder builder;
+    Json::CharReaderBuilder builder;
 
-        // try to parse into JSON object, return if not
-        if (!parseFromStream(builder, file_stream, &jsonData, &error)) {
-            cout << "Invalid config file provided." << endl << error << endl;
-            return;
-        }
+    // try to parse into JSON object, return if not
+    if (!parseFromStream(builder, file_stream, config, &error)) {
+        cout << "Invalid config file provided." << endl << error << endl;
+        return false;
+    }
 
-        file_stream.close();
+    return true;
+}
 
-        Json::Value matrix_data = jsonData["matrix_options"];
+void load_matrix_defaults(const Json::Value& config, RGBMatrix::Options* options, rgb_matrix::RuntimeOptions* runtime_options, string* hardware_mapping, bool* deep_idle) {
+    try {
+        Json::Value matrix_data = config["matrix_options"];
 
         // load all defaults into our options and runtime options objects
-        options->hardware_mapping = (new string(matrix_data["hardware_mapping"].asString()))->c_str();
+        *hardware_mapping = matrix_data["hardware_mapping"].asString();
+        options->hardware_mapping = hardware_mapping->c_str();
         options->rows = matrix_data["rows"].asInt();
         options->cols = matrix_data["cols"].asInt();
         options->chain_length = matrix_data["chain"].asInt();
@@ -278,9 +1085,134 @@ void load_matrix_defaults(string config_file, RGBMatrix::Options* options, rgb_m
         options->disable_hardware_pulsing = matrix_data["disable_hardware_pulse"].asBool();
         options->limit_refresh_rate_hz = matrix_data["refresh_rate_limit"].asInt();
         runtime_options->gpio_slowdown = matrix_data["gpio_slowdown"].asInt();
+
+        // shutting the matrix down while the clock is off means starting it again later, which needs the root access the library
+        // would otherwise drop right after starting
+        *deep_idle = matrix_data["deep_idle"].asBool();
+
+        if (*deep_idle)
+            runtime_options->drop_privileges = 0;
+
+        // where every thread of the clock runs and how it is scheduled, leaving the section out keeps the defaults of the kernel
+        const Json::Value& threading = matrix_data["threading"];
+
+        for (Json::Value::const_iterator iter = threading.begin(); iter != threading.end(); iter++) {
+            matrix_clock::thread_placement::subsystem which = matrix_clock::thread_placement::find(iter.name());
+
+            if (which == matrix_clock::thread_placement::SUBSYSTEMS) {
+                cerr << "Unknown thread " << iter.name() << " in threading, it can be render, telegram, messages, sources, stream, or background." << endl;
+                continue;
+            }
+
+            matrix_clock::thread_policy policy;
+
+            for (Json::Value::ArrayIndex cpu_index = 0; cpu_index != (*iter)["cpus"].size(); cpu_index++)
+                policy.cpus.push_back((*iter)["cpus"][cpu_index].asInt());
+
+            policy.priority = std::clamp((*iter)["priority"].asInt(), 0, 99);
+            policy.nice = std::clamp((*iter)["nice"].asInt(), -20, 19);
+            matrix_clock::thread_placement::configure(which, policy);
+
+            // only the render thread is placed before the matrix library drops root, every other thread starts after it
+            if (which != matrix_clock::thread_placement::render && !*deep_idle && (policy.priority > 0 || policy.nice < 0))
+                cerr << "The " << iter.name() << " thread starts after root is dropped, it can not get a priority or a nice level below 0." << endl;
+        }
     } catch (const Json::Exception& exception) {
         cerr << endl;
         cerr << exception.what() << endl;   // print error if we could not load defaults
         cerr << "--- COULD NOT PARSE CONFIG FILE ---" << endl;
     }
-}
\ No newline at end of file
+}
+
+// a headless canvas that counts every pixel written to it, which is what drawing a frame mostly comes down to on the matrix
+class pixel_counter : public matrix_clock::headless_canvas {
+    public:
+        long pixels = 0;
+
+        inline pixel_counter(int width, int height) : matrix_clock::headless_canvas(width, height) {}
+
+        void SetPixel(int x, int y, std::uint8_t red, std::uint8_t green, std::uint8_t blue) override {
+            pixels++;
+            matrix_clock::headless_canvas::SetPixel(x, y, red, green, blue);
+        }
+
+        void Fill(std::uint8_t red, std::uint8_t green, std::uint8_t blue) override {
+            pixels += (long) width() * height();
+            matrix_clock::headless_canvas::Fill(red, green, blue);
+        }
+};
+
+int run_check(const string& config_file, const Json::Value& config, int width, int height) {
+    matrix_clock::matrix_data clock_data(config_file);
+    clock_data.set_canvas_size(width, height);
+
+    if (!clock_data.load_clock_data(config)) {  // this is also where every visible_if is compiled, load_clock_data() says what is wrong
+        cout << "error: " << config_file << " could not be loaded" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (clock_data.get_clock_face_count() == 0) {
+        cout << "error: " << config_file << " has no clock faces" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // made up weather, so the weather variables come out about as long as real ones and nothing is polled over the network
+    matrix_clock::variable_utility time_util(std::make_unique<matrix_clock::stub_weather_provider>());
+    time_util.poll_date();
+    time_util.poll_weather();
+
+    matrix_clock::config_checker checker(config, clock_data, time_util);
+    checker.run();
+
+    // every face is drawn on its own display a number of times from scratch, that is what a change of the time costs
+    // first glyph by glyph, then again with every line already in the text cache, the way most frames are drawn once the clock runs
+    // the pixel count is the same everywhere, the time is from the machine the check runs on and only compares the faces to each other
+    static const int RENDERS = 50;
+    pixel_counter canvas(width, height);
+    matrix_clock::font_registry fonts;
+    matrix_clock::frame_tracker frame_tracker;
+    matrix_clock::text_raster_cache text_cache;
+    text_cache.resize(clock_data.get_text_cache_size());
+    std::vector<const matrix_clock::clock_face*> faces;
+    std::vector<const matrix_clock::clock_face*> checked;
+
+    for (const matrix_clock::clock_face& face : clock_data.get_clock_faces())
+        checked.push_back(&face);
+
+    checked.push_back(clock_data.get_timer_face());
+    cout << "Render cost (" << width << "x" << height << ", full redraws):" << endl;
+
+    for (const matrix_clock::clock_face* face : checked) {
+        faces.assign(clock_data.get_displays().size(), clock_data.get_empty_face());
+        faces[face->get_display()] = face;
+
+        double frame_us = 0, cached_us = 0;
+
+        for (matrix_clock::text_raster_cache* cache : {(matrix_clock::text_raster_cache*) nullptr, &text_cache}) {
+            if (cache != nullptr)   // fill the cache first, only the frames after that are timed
+                update_clock(&canvas, nullptr, faces, clock_data.get_displays(), &time_util, &fonts, clock_data.get_fonts_folder(), cache, &frame_tracker);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (int i = 0; i < RENDERS; i++) {
+                canvas.pixels = 0;
+                frame_tracker.invalidate();
+                update_clock(&canvas, nullptr, faces, clock_data.get_displays(), &time_util, &fonts, clock_data.get_fonts_folder(), cache, &frame_tracker);
+            }
+
+            (cache == nullptr ? frame_us : cached_us) = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / RENDERS;
+        }
+
+        int frames_per_minute = face->contains_centisecond_variable() ? 60 * clock_data.get_centisecond_rate() : face->contains_second_variable() ? 60 : 1;
+        long minute_cost = std::lround(frame_us * frames_per_minute / 100);   // in tenths of a millisecond
+
+        cout << "    " << (face == clock_data.get_timer_face() ? "timer" : "clock face \"" + string(face->get_name()) + "\"")
+             << " on " << clock_data.get_displays()[face->get_display()].get_name() << ": "
+             << face->get_line_count() << " line(s), " << face->get_icon_count() << " icon(s), " << canvas.pixels << " pixels, "
+             << (long) frame_us << " us a frame (" << (long) cached_us << " us from the text cache), " << frames_per_minute << " frame(s) a minute ("
+             << minute_cost / 10 << "." << minute_cost % 10 << " ms of drawing a minute)" << endl;
+    }
+
+    cout << config_file << ": " << checker.get_errors() << " error(s), " << checker.get_warnings() << " warning(s)" << endl;
+    return checker.get_errors() > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -10,19 +10,37 @@
 #define MATRIXCLOCK_MATRIX_CLOCK_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <map>
 #include <ctime>
 #include <cstring>
 #include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <charconv>
+#include <sys/types.h>
 #include "graphics.h"
 
+namespace rgb_matrix {
+    class FrameCanvas;
+}
+
+namespace Json {
+    class Value;
+}
+
 namespace matrix_clock {
     // time_period class
     //      Represents a period of time between a start and end time
     class time_period {
         private:
             int hour_start, minute_start, hour_end, minute_end;
-            std::vector<int> days;
+            std::uint8_t days;      // one bit per day of the week, bit 0 is Sunday
         public:
             // constructor (hour_start, minute_start, hour_end, minute_end)
             //   creates a time period object with the specified start and end times
@@ -33,49 +51,72 @@ namespace matrix_clock {
             bool in_time_period(int, int, int) const;
 
             // add a day to the time period
-            inline void add_day(int day) { days.push_back(day); }
+            inline void add_day(int day) { if (day >= 0 && day < 7) days |= 1 << day; }
 
             // return true if the clock face should be active on the day given
             // day_of_week = the day you want to test
-            inline bool active_today(int day_of_week) const { return std::find(days.begin(), days.end(), day_of_week) != days.end(); }
+            inline bool active_today(int day_of_week) const { return (days >> day_of_week) & 1; }
     };
 
+    // append_number(std::string& output, long value, int digits)
+    //      appends the number to the output padded with leading zeros to at least the given amount of digits
+    //      uses std::to_chars so nothing is allocated as long as the output has room left
+    inline void append_number(std::string& output, long value, int digits = 1) {
+        char buffer[24];
+        char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+
+        for (long length = end - buffer; length < digits; length++)
+            output += '0';
+
+        output.append(buffer, end);
+    }
+
     // enum for colors hardcoded in this project
     enum matrix_prebuilt_colors {
         red, orange, yellow, green, blue, purple, pink,
         white, gray, black, brown, night_time
     };
 
+    // entry of the prebuilt color table: the name used in the config file and the rgb values it stands for
+    struct prebuilt_color_entry {
+        const char* name;
+        std::uint8_t r, g, b;
+    };
+
+    // the rgb values of every prebuilt color, indexed by matrix_prebuilt_colors (i decided on these rgb values out of personal preference)
+    // this is only searched by name while loading the config file, once loaded a color is just its three rgb values
+    constexpr prebuilt_color_entry prebuilt_color_table[] = {
+        {"red", 128, 0, 0},         {"orange", 253, 88, 0},     {"yellow", 255, 228, 0},
+        {"green", 0, 160, 0},       {"blue", 0, 64, 255},       {"purple", 128, 0, 128},
+        {"pink", 228, 0, 228},      {"white", 255, 255, 255},   {"gray", 128, 128, 128},
+        {"black", 0, 0, 0},         {"brown", 101, 67, 33},     {"night_time", 128, 0, 0}
+    };
+
     // matrix_color class
     //      Represents a color that can be used to print text in on the matrix display
+    //      This is just the three rgb bytes so it is trivially copyable and costs nothing to pass around by value
     class matrix_color {
         private:
-            std::map<std::string, matrix_prebuilt_colors> colors{     {"red", matrix_prebuilt_colors::red},
-                {"orange", matrix_prebuilt_colors::orange}, {"yellow", matrix_prebuilt_colors::yellow},
-                {"green", matrix_prebuilt_colors::green},   {"blue", matrix_prebuilt_colors::blue},
-                {"purple", matrix_prebuilt_colors::purple}, {"pink", matrix_prebuilt_colors::pink},
-                {"white", matrix_prebuilt_colors::white},   {"gray", matrix_prebuilt_colors::gray},
-                {"black", matrix_prebuilt_colors::black},   {"brown", matrix_prebuilt_colors::brown},
-                                                                  {"night_time", matrix_prebuilt_colors::night_time} };
-            int r = 0, g = 0, b = 0;
-
-            // parses a prebuilt color into the object as rgb values
-            void parse_color(matrix_prebuilt_colors);
+            std::uint8_t r = 0, g = 0, b = 0;
         public:
             // constructor that takes in 3 values: red, green, and blue
             //      these values should all be between 0 and 255
-            matrix_color(int, int, int);
+            constexpr matrix_color(int red, int green, int blue) : r(red), g(green), b(blue) {}
 
             // default constructor that creates a black color object (all 0's in the rgb values)
-            inline matrix_color() { r = g = b = 0; }
+            constexpr matrix_color() {}
 
-            // constructor that takes in a prebuilt color and parses it into the object
-            inline matrix_color(matrix_prebuilt_colors hardcoded_color) { parse_color(hardcoded_color); }
+            // constructor that takes in a prebuilt color and looks up its rgb values
+            constexpr matrix_color(matrix_prebuilt_colors hardcoded_color) : r(prebuilt_color_table[hardcoded_color].r),
+                g(prebuilt_color_table[hardcoded_color].g), b(prebuilt_color_table[hardcoded_color].b) {}
 
             // constructor that takes in a color name as a string, and parses it into the class
-            //      the color should be one of the prebuilt colors
+            //      the color should be one of the prebuilt colors, unknown names are loaded as red
             //      this constructor will be used most when getting data from json
-            inline matrix_color(std::string color_name) { parse_color(colors[color_name]); }
+            matrix_color(const std::string& color_name);
+
+            // looks up a prebuilt color by name, returns false (and leaves color alone) if there is no prebuilt color with that name
+            static bool find_prebuilt(const std::string& color_name, matrix_color& color);
 
             // getter for the red value of the color
             inline int get_red(void) const { return r; }
@@ -94,127 +135,666 @@ namespace matrix_clock {
     //      Helper methods to parse a matrix_font enum into a matrix_font usable on the matrix display
     class matrix_font {
         private:
-            std::string font_size;
+            std::string_view font_size;     // either a string literal or a custom font name interned in the config_arena
+            int char_width;
 
             // parse the string value of a font into a valid font that the application we can use
             // if you pass in the string version of any matrix_built_in_font enums, it will automatically convert it to a valid string value
             // if not it will make sure that you passed in a valid font file name and load that to the field
             // if the file name is not valid, it loads the 6x9 font size (i think this is the most readable size) as a placeholder and sends an error to console
-            void parse_font(std::string font_folder, std::string font);
+            void parse_font(std::string font_folder, std::string_view font);
         public:
             // default constructor to instantiate to a default (medium fault)
-            inline matrix_font() { font_size = "6x9"; }
+            inline matrix_font() { font_size = "6x9"; char_width = 6; }
 
             // constructor to parse matrix_font from file
-            inline matrix_font(std::string font_folder, std::string font_size) { parse_font(font_folder, font_size); }
+            // a custom font name is not copied, it must stay alive as long as the font does (it is interned in the config_arena)
+            inline matrix_font(std::string font_folder, std::string_view font_size) { parse_font(font_folder, font_size); }
 
             // constructor to parse font information from a built in font
             matrix_font(matrix_built_in_font built_font);
 
             // get the width of a character of a font
-            int get_x() const;
+            inline int get_x() const { return char_width; }
 
             // get the current font size
-            inline std::string get_font(void) const { return font_size; }
-
-            // change the font size of an already created object
-            inline void set_font_size(std::string new_font) { font_size = new_font; }
+            inline std::string_view get_font(void) const { return font_size; }
 
             // get the font file for the
-            static std::string get_font_file(std::string font_folder, std::string font_size);
+            static std::string get_font_file(std::string font_folder, std::string_view font_size);
+
+            // returns the font size a prebuilt font name (small, medium, large, or large_bold) stands for, any other name is returned as it is
+            static std::string_view resolve_name(std::string_view font);
+    };
+
+    // clock_source class
+    //      Where every part of the clock reads the time from
+    //      Normally that is the system clocks, a simulation swaps both of them for one virtual clock that only moves when it is
+    //      advanced, so a schedule can be played through as fast as the clock can be drawn
+    class clock_source {
+        private:
+            static std::atomic<bool> simulated;
+            static std::atomic<std::int64_t> virtual_ms;    // milliseconds since the epoch on the virtual clock
+            static thread_local std::int64_t pinned_ms;     // what the wall clock reads on this thread, 0 if it is not pinned
+        public:
+            // milliseconds on a clock that never jumps with the wall clock, for timers
+            static std::int64_t get_monotonic_ms(void);
+
+            // milliseconds since the epoch on the wall clock
+            static std::int64_t get_wall_ms(void);
+
+            // seconds since the epoch on the wall clock, what std::time() would return
+            inline static std::time_t get_wall_time(void) { return (std::time_t) (get_wall_ms() / 1000); }
+
+            // microseconds since the epoch on the wall clock, never pinned, for measuring how close to a second something happened
+            static std::int64_t get_wall_us(void);
+
+            // makes the wall clock read the given milliseconds since the epoch on the calling thread only, 0 lets it run again
+            // this is how a frame is drawn ahead of time for a second that has not come yet
+            inline static void pin_wall_ms(std::int64_t wall_ms) { pinned_ms = wall_ms; }
+
+            // sleeps until the wall clock reaches the given milliseconds since the epoch (a virtual clock is moved there instead)
+            // returns false right away if that is more than a second off, which only happens when the wall clock was set back
+            static bool sleep_until_wall(std::int64_t wall_ms);
+
+            // switches every clock over to a virtual clock starting at the given milliseconds since the epoch
+            static void simulate(std::int64_t start_ms);
+
+            // moves the virtual clock forward, does nothing unless simulating
+            static void advance(std::int64_t ms);
+
+            // returns true if the clocks are virtual
+            inline static bool is_simulated(void) { return simulated; }
+    };
+
+    // thread_policy struct
+    //      Where a thread may run and how the kernel schedules it, read from the threading section of the matrix options
+    struct thread_policy {
+        std::vector<int> cpus;      // the cores the thread may run on, empty for any core
+        int priority = 0;           // a SCHED_FIFO priority (1-99), 0 to stay on the normal scheduler
+        int nice = 0;               // the nice level (-20 to 19) on the normal scheduler, unused with a priority
+    };
+
+    // thread_placement class
+    //      Pins every thread of the clock to its configured cores with its configured scheduling
+    //      Each thread applies its own policy as it starts, so threads started later (like the one sending a message) are placed too
+    //      Nothing is changed unless configure() was called, and the achieved placement of every kind of thread is printed once
+    class thread_placement {
+        public:
+            enum subsystem { render, telegram, messages, sources, stream, background, SUBSYSTEMS };
+        private:
+            static thread_policy policies[SUBSYSTEMS];
+            static bool enabled;
+            static std::atomic<bool> reported[SUBSYSTEMS];
+        public:
+            // sets the policy of one kind of thread, must be called before any threads are started
+            // once anything is configured, threads without a policy of their own are moved back to the normal scheduler on any core
+            // (otherwise they would take over the cores and real time priority of the render thread that started them)
+            static void configure(subsystem which, const thread_policy& policy);
+
+            // applies the policy of the subsystem to the calling thread
+            // the first thread of every subsystem prints where it ended up, including anything the kernel refused
+            static void apply(subsystem which);
+
+            // prints the placement the matrix library gave its refresh thread, the library places that one itself
+            static void report_refresh_thread(void);
+
+            // returns the subsystem with the given name (as used in the config), SUBSYSTEMS if there is none
+            static subsystem find(const std::string& name);
+
+            // returns true if any policy was configured
+            inline static bool is_enabled(void) { return enabled; }
+    };
+
+    // thread_privileges class
+    //      Lets deep idle keep root on the render thread alone, which needs it to start the matrix again after shutting it down
+    //      Every other thread gives root up for itself as it starts (right after it is placed), so the bot, the messages, the
+    //      stream, and the commands of the variable sources never run as root
+    //      Linux keeps the user of every thread apart, only the glibc wrappers change all of them at once
+    class thread_privileges {
+        private:
+            static bool kept;
+            static uid_t uid;
+            static gid_t gid;
+        public:
+            // looks up the user the other threads drop to, call this while still root and before any threads are started
+            // returns false if there is no such user
+            static bool keep_for_render(const char* user);
+
+            // gives up root on the calling thread and every thread it starts from then on
+            // does nothing unless keep_for_render() was called, without deep idle the matrix library drops root for the whole process
+            static void drop_thread(void);
     };
 
     // matrix_timer class
     //      Stores information for a timer embedded in the matrix
+    //      A timer is a start instant on the monotonic clock plus the time it ran before its last pause,
+    //      so it is evaluated on demand with millisecond precision no matter how often the main loop gets to it
     class matrix_timer {
         private:
-            int hour, minute, second;
-            int tick_num;
+            std::int64_t duration_ms;       // how long a countdown runs for, 0 for a stopwatch
+            std::int64_t start_ms = 0;      // monotonic instant the timer was last started or resumed
+            std::int64_t run_ms = 0;        // time the timer ran for before it was last paused
             bool started = false;
             bool paused = false;
             bool stopwatch = false;
-            int hold_ending = 0;
-            int original_hour, original_minute, original_second;
+            bool empty = false;             // the placeholder timer used while no timer is set
+            bool ended = false;
+
+            // how long the timer has been running for, not counting time spent paused
+            std::int64_t elapsed_ms(void) const;
 
-            // calculates the current hour, minute, and second depending on the tick of the clock
-            void calculate_current_time(void);
+            // the whole seconds shown on screen, rounded up for a countdown so it only reads 0 once it is actually done
+            int shown_seconds(void) const;
         public:
             // instantiates a default countdown timer of 0 seconds
-            inline matrix_timer() { hour = minute = second = 0; }
+            inline matrix_timer() { duration_ms = 0; }
 
             // default constructor - instantiates a timer
-            // set all values to -2 to create a stopwatch timer
+            // set all values to -2 to create a stopwatch timer, or the hour to -1 for an empty timer
             matrix_timer(int hour, int minute, int second);
 
-            // represents one second for the timer in the program
-            // returns the current tick in the timer
-            //      will be positive if it is still ticking
-            //      will be 0 if it just finished ticking
-            //      will be negative if it is in the hold period
-            int tick(int hold_max);
+            // milliseconds on the monotonic clock, which never jumps with the wall clock
+            inline static std::int64_t get_monotonic_ms(void) { return clock_source::get_monotonic_ms(); }
 
             // stops the timer
             void end_timer(void);
 
-            // format the timer into a nice string
-            std::string format_timer(void);
+            // format the timer into a nice string and append it to the output
+            void format_timer(std::string& output) const;
 
-            // check if we can do another tick before performing it
-            bool can_tick(int hold_max) const;
+            // returns true while the timer should take over its display (not ended and not past its hold period)
+            bool is_shown(int hold_max) const;
 
             // reset the timer to its original settings
             void reset_timer(void);
 
             // starts the timer
-            inline void start_timer(void) { started = true; }
+            void start_timer(void);
 
             // pauses or unpauses the timer
-            inline void pause(void) { paused = !paused; }
+            void pause(void);
+
+            // returns how many whole seconds a countdown has been over for, 0 while it is still running
+            int get_hold_seconds(void) const;
 
             // returns true if we are in the holding period (the timer has ended and we are displaying the finished timer on screen)
-            inline bool in_hold_period(void) const { return hold_ending > 0; }
+            inline bool in_hold_period(void) const { return get_hold_seconds() > 0; }
 
             // returns true if the timer has started, false otherwise
             inline bool is_started(void) const { return started; }
 
+            // returns true if the timer is paused, false otherwise
+            inline bool is_paused(void) const { return paused; }
+
             // returns true if the timer is a stopwatch instance, false if not
             inline bool is_stopwatch(void) const { return stopwatch; }
 
-            // returns the hour the timer is currently on
-            inline int get_hour(void) const { return hour; }
+            // returns the time left on a countdown or the time a stopwatch has run for, in milliseconds
+            std::int64_t get_time_ms(void) const;
+
+            // returns the monotonic instant a running countdown reaches zero, -1 if it is not counting down right now
+            std::int64_t get_finish_ms(void) const;
+
+            // returns how many milliseconds until the time shown on screen changes, -1 if it is standing still
+            int get_ms_to_next_second(void) const;
+
+            // returns the hour the timer is currently on, -1 once the timer has ended
+            inline int get_hour(void) const { return ended ? -1 : shown_seconds() / 3600; }
 
             // returns the minute the timer is currently on
-            inline int get_minute(void) const { return minute; }
+            inline int get_minute(void) const { return ended ? 0 : (shown_seconds() / 60) % 60; }
 
             // returns the second the timer is currently on
-            inline int get_second(void) const { return second; }
+            inline int get_second(void) const { return ended ? 0 : shown_seconds() % 60; }
+
+            // returns the hundredths of a second the timer is currently on
+            inline int get_centisecond(void) const { return (int) ((get_time_ms() / 10) % 100); }
+    };
+
+    // timer_set class
+    //      Holds any number of timers by name, the unnamed timer is the one that takes over its display
+    //      The deadlines of running countdowns sit in a min-heap, so the next one is found in O(log n) without looking at every timer
+    class timer_set {
+        private:
+            struct timer_deadline {
+                std::int64_t due_ms;        // when this deadline comes up on the monotonic clock
+                std::int64_t finish_ms;     // the finish instant of the timer when this was scheduled, if the timer no longer matches it is stale
+                bool hold_over;             // false for the moment a countdown reaches zero, true for the end of its hold period
+                std::string name;
+
+                inline bool operator>(const timer_deadline& other) const { return due_ms > other.due_ms; }
+            };
+
+            std::map<std::string, std::shared_ptr<matrix_timer>, std::less<>> timers;
+            std::vector<timer_deadline> deadlines;      // a min-heap on due_ms, stale entries are dropped as they reach the top
+            std::shared_ptr<matrix_timer> empty_timer;  // handed out for names without a timer
+            int hold_seconds;
+            mutable std::mutex timer_lock;      // the bot changes timers while the render thread reads them
+
+            // pushes the next deadline of the timer onto the heap, the lock must be held
+            void schedule(const std::string& name, const matrix_timer& timer, std::int64_t now);
+
+            // returns true if the deadline still matches the timer it was scheduled for, the lock must be held
+            bool is_current(const timer_deadline& deadline) const;
+
+            // drops stale deadlines off the top of the heap, the lock must be held
+            void drop_stale(void);
+        public:
+            // the longest a timer name can be, so it still fits in the callback data of a telegram button
+            static const std::size_t MAX_NAME_LENGTH = 32;
+
+            timer_set();
+
+            // returns the timer with the given name, or an ended placeholder if there is none
+            // hold on to the returned pointer while using the timer, it stays alive even if the timer is replaced meanwhile
+            std::shared_ptr<matrix_timer> get(std::string_view name) const;
+
+            // returns true if there is a timer with the given name that has not ended
+            bool has(std::string_view name) const;
+
+            // adds a timer under the given name, replacing any timer that had it before
+            void set(const std::string& name, std::shared_ptr<matrix_timer> timer);
+
+            // ends and removes the timer with the given name, returns false if there was none
+            bool remove(std::string_view name);
+
+            // starts, pauses or unpauses, or resets the timer with the given name, returns false if there was none
+            bool start(std::string_view name);
+            bool pause(std::string_view name);
+            bool reset(std::string_view name);
+
+            // returns the names of every timer, the unnamed timer is left out
+            std::vector<std::string> get_names(void) const;
+
+            // returns true if any timer is counting right now (started, not paused, and not ended)
+            bool any_running(void) const;
+
+            // sets how many seconds a finished countdown stays around before it ends
+            void set_hold(int seconds);
+
+            // returns how many milliseconds until the next deadline, -1 if no countdown is running
+            int get_ms_to_next_deadline(void) const;
+
+            // handles every deadline that has come up, ending timers whose hold period is over
+            // returns true and puts its name into finished for each countdown that just reached zero, call it until it returns false
+            bool pop_finished(std::string& finished);
+
+            // returns true if the name can be used for a timer (letters, numbers, - and _)
+            static bool is_valid_name(std::string_view name);
+    };
+
+    // weather_report class
+    //      Pulls the few values the clock shows out of a OneCall weather response while it is being downloaded
+    //      The response is scanned one chunk at a time and never built into a JSON tree, every value that is not on
+    //      one of the wanted paths is skipped over, so reading a response of any size does not allocate anything
+    class weather_report {
+        public:
+            enum number_field { temp, feels_like, wind_speed, humidity, day_low, day_high, condition, NUMBER_FIELDS };
+            enum text_field { forecast, short_forecast, day_forecast, TEXT_FIELDS };
+
+            static const std::size_t MAX_TEXT = 64;     // longer forecasts are cut off, nothing that long fits on the matrix anyway
+            static const std::size_t MAX_PATH = 128;    // deeper or longer paths can never match one we want
+            static const std::size_t MAX_DEPTH = 32;
+        private:
+            enum scan_state { between, in_key, in_string, in_token };
+
+            // an object or array the scanner is inside of
+            struct container {
+                bool array;
+                bool expect_key;
+                int index;
+                std::size_t base;       // the length of the path up to this container
+            };
+
+            container stack[MAX_DEPTH];
+            std::size_t depth;
+            char path[MAX_PATH];        // where the scanner is, for example "daily.0.temp.min"
+            std::size_t path_length;
+            bool path_overflow;
+            scan_state state;
+            char token[32];             // the number or literal being read
+            std::size_t token_length;
+            bool escaped;
+            int unicode_digits;         // hex digits left in a \u escape
+            std::uint32_t codepoint;
+            int text_target;            // the text field the current string goes into, -1 if it is skipped
+            bool done, failed;
+
+            float numbers[NUMBER_FIELDS];
+            bool has_numbers[NUMBER_FIELDS];
+            char texts[TEXT_FIELDS][MAX_TEXT];
+            std::size_t text_lengths[TEXT_FIELDS];
+            bool has_texts[TEXT_FIELDS];
+
+            // handles a single character of the response, returns false if it cannot be part of valid JSON here
+            bool scan(char c);
+
+            // appends a character to the key or the text being read, whichever the scanner is in
+            void put_char(char c);
+
+            // appends the utf-8 encoding of a \u escape to the key or the text being read
+            void put_codepoint(std::uint32_t value);
+
+            // points the path at the next element of the array on top of the stack
+            void set_array_path(void);
+
+            // handles a finished number or literal
+            void end_token(void);
+
+            // handles the end of any value, the document is done once the outermost value ends
+            void end_value(void);
+
+            // returns the field whose path is the current path out of the given table, -1 if there is none
+            int match_path(const char* const paths[], int count) const;
+        public:
+            weather_report();
+
+            // scans the next chunk of the response, returns false once the response turned out not to be valid JSON
+            bool feed(const char* data, std::size_t length);
+
+            // returns true if a whole JSON document was read without errors
+            inline bool is_complete(void) const { return done && !failed; }
+
+            // returns the number on the path of the field, or 0 if the response did not have it
+            inline float get_number(number_field field) const { return has_numbers[field] ? numbers[field] : 0; }
+
+            // returns the text on the path of the field, or an empty string if the response did not have it
+            inline std::string_view get_text(text_field field) const { return std::string_view(texts[field], has_texts[field] ? text_lengths[field] : 0); }
+    };
+
+    // weather_snapshot struct
+    //      Everything the clock shows about the weather as of one successful poll, in the form it is shown in
+    //      The last good snapshot is saved to disk so a restart can show it right away
+    struct weather_snapshot {
+        int temp = 0, real_feel = 0, humidity = 0, day_high = 0, day_low = 0;
+        float wind_speed = 0;       // rounded to one decimal place
+        std::string short_forecast, forecast, day_forecast;
+        int condition = 0;          // the OpenWeatherMap condition code of the current weather, 0 if unknown
+        std::time_t fetched_at = 0; // when the snapshot was taken, in seconds since the epoch
+
+        // fills the snapshot in from a complete OneCall response
+        void read_report(const weather_report& report);
+
+        // writes the snapshot to the given file, returns false if it could not be written
+        bool save(const std::string& path) const;
+
+        // reads a snapshot saved by save(), returns false (leaving the snapshot alone) if there is none or it is unreadable
+        bool load(const std::string& path);
+    };
+
+    // weather_provider class
+    //      Where the weather comes from, picked with "weather_provider" in the config
+    //          openweathermap: polls the OneCall API at the weather URL (the default)
+    //          file: reads a saved OneCall response from a file on every poll, to test without the live API
+    //          stub: makes up the weather without touching the network, every poll moves on to different weather
+    class weather_provider {
+        public:
+            virtual ~weather_provider() {}
+
+            // fetches the current weather into the snapshot
+            // returns false if it could not be fetched, the snapshot is then left alone
+            virtual bool fetch(weather_snapshot& snapshot) = 0;
+
+            // creates the provider with the given name, an unknown name falls back to openweathermap
+            // url is used by the openweathermap provider, file by the file provider
+            static std::unique_ptr<weather_provider> create(const std::string& name, const std::string& url, const std::string& file);
+    };
+
+    // openweathermap_provider class
+    //      Polls the OpenWeatherMap OneCall API, the response is streamed through a weather_report as it downloads
+    class openweathermap_provider : public weather_provider {
+        private:
+            std::string url;
+        public:
+            inline openweathermap_provider(std::string url) { this->url = url; }
+
+            bool fetch(weather_snapshot& snapshot) override;
+    };
+
+    // file_weather_provider class
+    //      Reads a OneCall response saved to a file, the file is read again on every poll so it can be edited while the clock runs
+    class file_weather_provider : public weather_provider {
+        private:
+            std::string path;
+        public:
+            inline file_weather_provider(std::string path) { this->path = path; }
+
+            bool fetch(weather_snapshot& snapshot) override;
+    };
+
+    // stub_weather_provider class
+    //      Makes up the weather without any network access, cycling through a few kinds of weather (long forecasts included)
+    //      so clock faces can be checked against all of them
+    class stub_weather_provider : public weather_provider {
+        private:
+            int poll_count = 0;
+        public:
+            bool fetch(weather_snapshot& snapshot) override;
+    };
+
+    // variable_source struct
+    //      A site specific value shown by {src:name}, read from a file or taken from the output of a command every so often
+    struct variable_source {
+        std::string name;
+        std::string path;           // the file to read, or the shell command to run
+        bool command = false;       // true if path is a command to run instead of a file to read
+        int interval = 60;          // seconds between reads
+        int timeout = 5;            // seconds a command may run for before it is killed
+    };
+
+    // source_scheduler class
+    //      Reads every variable source on a background thread, each at its own interval, and keeps the last value of each
+    //      Only the first line of a file or of the output of a command is kept, cut off at MAX_VALUE_LENGTH characters
+    //      The render loop only ever copies a kept value, so a slow file or command never holds up a frame
+    class source_scheduler {
+        public:
+            static const std::size_t MAX_VALUE_LENGTH = 64;
+        private:
+            // a source along with what it last read
+            struct source_state {
+                variable_source source;
+                std::string value;
+                std::int64_t due_ms = 0;        // when the source is read next, on the steady clock
+                std::int64_t updated_ms = -1;   // when the source last read successfully, -1 if it never has
+                int latency_ms = -1;            // how long the last read took, -1 if it was never read
+                bool failing = false;           // the last read failed, only the first failure in a row is logged
+            };
+
+            std::map<std::string, source_state, std::less<>> sources;
+            mutable std::mutex source_lock;
+            std::condition_variable sources_changed;
+            std::thread worker;
+            bool running;
+            std::atomic<bool> changed;      // a read changed what a {src:} or {src_ms:} variable shows since take_changed()
+
+            // reads the sources as they come due until the scheduler is destroyed
+            void scheduler_loop(void);
+
+            // reads the first line of the file into value, returns false if the file could not be read
+            static bool read_file(const variable_source& source, std::string& value);
+
+            // runs the command and puts the first line of its output into value
+            // returns false if it could not be run, exited with an error, or was killed for running longer than its timeout
+            static bool run_command(const variable_source& source, std::string& value);
+
+            // milliseconds on the steady clock, sources read on real time even while simulating
+            static std::int64_t now_ms(void);
+        public:
+            source_scheduler();
+
+            // stops the background thread, waiting for a read in progress to finish
+            ~source_scheduler();
+
+            // replaces the sources, sources that keep their name also keep their last value and are read again right away
+            // the background thread is started the first time there are sources
+            void set_sources(const std::vector<variable_source>& new_sources);
+
+            // appends a source variable for the source with the given name to the output, returns false if there is no such source
+            //      src: the last value read (empty until the first successful read)
+            //      src_age: whole seconds since the last successful read (- if there was none)
+            //      src_ms: how many milliseconds the last read took (- if there was none)
+            bool append_variable(std::string_view kind, std::string_view name, std::string& output) const;
+
+            // returns true once after a read changed the value or latency of a source, so the clock can redraw mid minute
+            inline bool take_changed(void) { return changed.exchange(false); }
+    };
+
+    // host_telemetry class
+    //      Reads the health of the Pi the clock runs on for {cpu_temp}, {load1}, {mem_free}, and {uptime}
+    //      Every file is opened once and read again with pread() at most every REFRESH_MS, in between the values parsed last time
+    //      are shown, so a face showing them every second costs next to nothing and never allocates
+    class host_telemetry {
+        public:
+            static const int REFRESH_MS = 2000;
+        private:
+            enum host_file { thermal, loadavg, meminfo, uptime, HOST_FILES };
+
+            int fds[HOST_FILES];            // -1 for a file that could not be opened, its variables show -
+            std::int64_t refreshed_ms;      // when the values were last read, -1 if they never were
+            int cpu_temp;                   // degrees celsius
+            int load1;                      // the one minute load average in hundredths
+            long mem_free;                  // megabytes available to new programs
+            long uptime_seconds;
+            std::mutex telemetry_lock;      // the bot parses variables on its own thread
+
+            // reads every file again if the values are older than REFRESH_MS
+            void refresh(void);
+
+            // reads the whole file into buffer (null terminated) from the start, returns false if there is nothing to read
+            bool read_file(host_file file, char* buffer, std::size_t size) const;
+        public:
+            // opens every file, they stay open until the object is destroyed
+            host_telemetry();
+
+            // closes every file
+            ~host_telemetry();
+
+            host_telemetry(const host_telemetry&) = delete;
+            host_telemetry& operator=(const host_telemetry&) = delete;
+
+            // appends the host variable with the given name to the output, returns false for any other name
+            //      cpu_temp: the cpu temperature in degrees celsius
+            //      load1: the one minute load average, for example 0.42
+            //      mem_free: the memory available to new programs in MB
+            //      uptime: how long the Pi has been up, for example 3d 4h or 5h 12m
+            bool append_variable(std::string_view name, std::string& output);
+    };
+
+    // time_zone class
+    //      One time zone (America/New_York, UTC, ...) read from its file in the zoneinfo folder, used by {hour@Zone} style variables
+    //      The offset from UTC is looked up once and kept until the next transition of the zone (a daylight saving change), in between
+    //      the time there is the time here plus that offset, so showing it on every tick never touches the file again
+    class time_zone {
+        private:
+            // when daylight saving starts or ends in the rule at the end of the file, Mm.w.d, Jn, or n in the POSIX TZ format
+            struct rule_date {
+                char kind = 'M';                    // 'M' for a weekday of a month, 'J' for a day of the year without Feb 29, 'n' with it
+                int month = 0, week = 0, day = 0;   // day is the weekday for 'M' and the day of the year otherwise
+                int time = 7200;                    // seconds after local midnight, 2:00 unless the rule says otherwise
+            };
+
+            std::string name;
+            bool loaded;
+            std::vector<std::int64_t> transitions;  // seconds since the epoch the offset changes at, oldest first
+            std::vector<std::int32_t> offsets;      // the offset from UTC in seconds from each transition on
+            std::int32_t first_offset;              // the offset before the first transition
+
+            // the rule the file ends with, it covers every time after the last transition
+            bool has_rule, rule_has_dst;
+            std::int32_t std_offset, dst_offset;
+            rule_date dst_start, dst_end;
+
+            // the offset looked up last time and the times it holds between
+            std::int64_t cached_from, cached_until;
+            std::int32_t cached_offset;
+
+            // reads the zone's file, returns false if it is not a zoneinfo file
+            bool load(const std::string& path);
+
+            // reads the POSIX TZ rule at the end of the file, for example EST5EDT,M3.2.0,M11.1.0
+            bool parse_rule(std::string_view rule);
+
+            // returns the UTC time the rule date happens at in the given year, for a clock that is local_offset ahead of UTC
+            static std::int64_t rule_time(const rule_date& date, int year, std::int32_t local_offset);
+
+            // looks up the offset at the given time and the times it holds between
+            void resolve(std::int64_t utc);
+        public:
+            // reads the zone with the given name from the zoneinfo folder (TZDIR if it is set, /usr/share/zoneinfo otherwise)
+            time_zone(std::string_view zone_name);
+
+            // returns the name the zone was loaded with
+            inline const std::string& get_name(void) const { return name; }
+
+            // returns true if the zone's file could be read
+            inline bool is_loaded(void) const { return loaded; }
+
+            // returns the offset from UTC in seconds at the given time, only the first call after a transition looks it up
+            std::int32_t get_offset(std::int64_t utc);
+
+            // fills in the time of day, date, and weekday in the zone at the given time (tm_isdst and tm_gmtoff are left alone)
+            void get_local_time(std::int64_t utc, std::tm& local);
+    };
+
+    // time_zone_set class
+    //      The time zones {hour@Zone} style variables have asked for, a zone is read the first time a variable uses it
+    //      A zone whose file cannot be read is kept as well, so its variables do not try to read it again on every tick
+    class time_zone_set {
+        private:
+            std::vector<std::unique_ptr<time_zone>> zones;
+            std::mutex zones_lock;      // the bot parses variables on its own thread
+        public:
+            // fills in the time in the zone with the given name at the given time, returns false if there is no such zone
+            bool get_local_time(std::string_view zone_name, std::int64_t utc, std::tm& local);
     };
 
     // variable_utility class
     //      A helper class that reads weather data from the web and time/date information from the system
     class variable_utility {
         private:
-            std::string weather_url;
-            int temp, real_feel, humidity, day_high, day_low;
-            float wind_speed;
-            std::string short_forecast, forecast, day_forecast;
+            std::unique_ptr<weather_provider> provider;
+            std::string cache_file;     // where the last good weather is kept, empty to not keep it
+            int cache_ttl;              // minutes the kept weather is good for after a restart
+            std::mutex poll_lock;       // one poll at a time (the bot and the startup poll run on their own threads), held across the fetch
+            // the weather shown, only ever read and replaced through std::atomic_load() and std::atomic_store()
+            // a poll fetches into a snapshot of its own and swaps it in whole, so readers never wait on the network or see half of one
+            std::shared_ptr<const weather_snapshot> weather;
             std::string formatted_date, month_name, day_name;
             int month_num, day_of_month, day_of_week, year;
-            matrix_timer* timer;
+            timer_set timers;       // the unnamed timer is the one shown by {ftimer}, the others by {ftimer:name}
+            source_scheduler* sources = nullptr;    // values for {src:name}, none until set_source_scheduler() is called
+            host_telemetry telemetry;   // values for {cpu_temp}, {load1}, {mem_free}, and {uptime}
+            time_zone_set zones;        // values for {hour@Zone} and the other time variables in another time zone
 
             // returns the time construct that helps us gather date and time data
             std::tm* get_tm();
 
+            // shows the weather in the snapshot from now on
+            void publish_weather(weather_snapshot snapshot);
+
+            // appends the value of the variable with the given name (without braces) to the output
+            // returns false if there is no variable with that name
+            bool append_variable(std::string_view name, const int times[], matrix_timer& current_timer, const weather_snapshot& shown, std::string& output);
+
+            // appends a timer variable ({thour}, {tminute}, {tsecond}, {tcenti} or {ftimer}) for the given timer, returns false for any other name
+            static bool append_timer_variable(std::string_view name, const matrix_timer& current_timer, std::string& output);
+
+            // appends a time variable in another time zone ({hour@America/New_York}, {hour24@UTC}, ...), returns false if the part
+            // before the @ is not a time or date variable or the zone cannot be read
+            bool append_zone_variable(std::string_view name, std::string& output);
+
             const std::string months[12] {"January", "February", "March", "April",
                                           "May", "June", "July", "August", "September",
                                           "October", "November", "December"};
             const std::string days[7] {"Sunday", "Monday", "Tuesday", "Wednesday",
                                        "Thursday", "Friday", "Saturday"};
         public:
-            // constructor that requires a weather URL from OpenWeatherMap as a string to parse weather data with
-            variable_utility(std::string url);
+            // constructor that requires the provider to poll the weather from
+            variable_utility(std::unique_ptr<weather_provider> provider);
 
-            // polls the weather URL and updates the weather fields with the new data
+            // polls the weather provider and updates the weather fields with the new data
+            // if the weather cannot be polled the last weather stays, and a good poll is saved to the cache file if there is one
             void poll_weather(void);
 
             // polls the system for new date information and updates the date field with the new data
@@ -223,9 +803,17 @@ namespace matrix_clock {
             // replace all valid variables in the string parameter into a new string and return it
             std::string parse_variables(std::string vars);
 
+            // replace all valid variables in the text and write the result into output
+            // this is what the render loop uses: once output has grown large enough it never allocates
+            void parse_variables(std::string_view text, std::string& output);
+
             // returns true if the time is exactly midnight (and on the first second), false if not
             bool is_new_day(void);
 
+            // fills in every value a visible_if expression can use, indexed by line_condition::variable
+            // this is done once per frame and shared by every line, values must have room for line_condition::VARIABLES
+            void get_condition_values(float values[]);
+
             // loads time data into an array of length 4
             //      index 0: 12 hour time
             //      index 1: minute (1-60)
@@ -233,43 +821,51 @@ namespace matrix_clock {
             //      index 3: 24 hour time
             void get_time(int times[]);
 
+            // returns the weather shown right now, it is never changed after this (a poll swaps in a new one), so keep it to read
+            // more than one value of the same poll
+            inline std::shared_ptr<const weather_snapshot> get_weather(void) const { return std::atomic_load(&weather); }
+
             // returns the current temperature
             //      poll_weather() must be called before this is usable
-            inline int get_temp(void) const { return temp; }
+            inline int get_temp(void) const { return get_weather()->temp; }
 
             // returns the current real feel
             //      poll_weather() must be called before this is usable
-            inline int get_real_feel(void) const { return real_feel; }
+            inline int get_real_feel(void) const { return get_weather()->real_feel; }
 
             // returns the current humidity
             //      poll_weather() must be called before this is usable
-            inline int get_humidity(void) const { return humidity; }
+            inline int get_humidity(void) const { return get_weather()->humidity; }
 
             // returns the day's low
             //      poll_weather() must be called before this is usable
-            inline int get_day_low(void) const { return day_low; }
+            inline int get_day_low(void) const { return get_weather()->day_low; }
 
             // returns the day's high
             //      poll_weather() must be called before this is usable
-            inline int get_day_high(void) const { return day_high; }
+            inline int get_day_high(void) const { return get_weather()->day_high; }
 
             // returns the current wind speed rounded to one decimal place
             //      poll_weather() must be called before this is usable
-            inline float get_wind_speed(void) const { return wind_speed; }
+            inline float get_wind_speed(void) const { return get_weather()->wind_speed; }
+
+            // returns the OpenWeatherMap condition code of the current weather (for example 800 for a clear sky), 0 if unknown
+            //      poll_weather() must be called before this is usable
+            inline int get_condition(void) const { return get_weather()->condition; }
 
             // returns the current forecast
             //      poll_weather() must be called before this is usable
             //      this string will typically be too long to fit on the matrix but is included
             //      in case someone wants to parse it further and wrap around
-            inline std::string get_current_forecast(void) const { return forecast; }
+            inline std::string get_current_forecast(void) const { return get_weather()->forecast; }
 
             // returns the current weather outside as one word
             //      poll_weather() must be called before this is usable
-            inline std::string get_current_forecast_short(void) const { return short_forecast; }
+            inline std::string get_current_forecast_short(void) const { return get_weather()->short_forecast; }
 
             // returns the full day's forecast outside as one word
             //      poll_weather() must be called before this is usable
-            inline std::string get_day_forecast(void) const { return day_forecast; }
+            inline std::string get_day_forecast(void) const { return get_weather()->day_forecast; }
 
             // returns the date formatted as MM-DD-YYYY
             //      poll_date() must be called before this is usable
@@ -302,97 +898,263 @@ namespace matrix_clock {
             //      poll_date() must be called before this is usable
             inline int get_year(void) const { return year; }
 
-            // returns the timer object embedded in the variable utility
-            inline matrix_timer* get_timer(void) const { return timer; }
+            // returns the unnamed timer embedded in the variable utility
+            // hold on to the returned pointer while using the timer, it stays alive even if the timer is replaced meanwhile
+            inline std::shared_ptr<matrix_timer> get_timer(void) const { return timers.get(""); }
+
+            // returns true if the object has an unnamed timer, false otherwise
+            inline bool has_timer(void) const { return timers.has(""); }
+
+            // sets the unnamed timer embedded in the object
+            // the previous timer is freed as soon as nobody is using it anymore
+            inline void set_timer(std::shared_ptr<matrix_timer> new_timer) { timers.set("", new_timer); }
+
+            // returns every timer, named or not
+            inline timer_set& get_timers(void) { return timers; }
+
+            // sets where {src:name} variables get their values from
+            inline void set_source_scheduler(source_scheduler* scheduler) { sources = scheduler; }
 
-            // returns true if the object has a timer, false otherwise
-            inline bool has_timer(void) const { return timer->get_hour() != -1; }
+            // returns where {src:name} variables get their values from, or nullptr if there is nowhere
+            inline source_scheduler* get_source_scheduler(void) const { return sources; }
 
-            // sets the timer embedded in the object
-            inline void set_timer(matrix_timer* new_timer) { timer = new_timer; }
+            // replaces the weather provider, for example after the config was reloaded
+            void set_weather_provider(std::unique_ptr<weather_provider> new_provider);
 
-            // manually set the weather URL
-            // only use this after reloading clock data via a telegram bot
-            // the load_clock_data() method automatically loads the weather URL from the config file
-            //          on first run into the variable_utility object
-            inline void set_weather_url(std::string url) { weather_url = url; }
+            // sets the file the last good weather is kept in (empty to not keep it) and how many minutes it is good for
+            // weather already in the file that is still good is shown right away, so a restart does not show ~Error~ until the first poll
+            void set_weather_cache(std::string path, int ttl);
+    };
+
+    // array_view class
+    //      A read only view of objects stored one after another somewhere else (the same idea as std::span)
+    //      Used to hand out the lines and time periods of a clock face without copying them out of the config_arena
+    template <typename T>
+    class array_view {
+        private:
+            const T* first;
+            std::size_t count;
+        public:
+            // creates an empty view
+            constexpr array_view() : first(nullptr), count(0) {}
+
+            // creates a view of count objects starting at first
+            constexpr array_view(const T* first, std::size_t count) : first(first), count(count) {}
+
+            inline const T* begin(void) const { return first; }
+            inline const T* end(void) const { return first + count; }
+            inline const T& operator[](std::size_t index) const { return first[index]; }
+            inline std::size_t size(void) const { return count; }
+            inline bool empty(void) const { return count == 0; }
+    };
+
+    // line_condition class
+    //      Compiles the visible_if expression of a text line (for example "temp < 32 && !timer_running") once when the config
+    //      is loaded into a short postfix program, which is run on a small stack against numbers the variable_utility fills in
+    //      once per frame, so deciding whether a line is shown never formats or parses any text
+    class line_condition {
+        public:
+            // every value an expression can use, the names are the same as the text variables without braces
+            enum variable : std::uint8_t { hour, hour24, minute, second, temp, temp_feel, humidity, day_low, day_high, wind_speed,
+                                           condition, month, month_day, week_day_num, year, timer_running, VARIABLES };
+
+            enum op_code : std::uint8_t { push_number, push_variable, negate, logical_not, add, subtract, multiply, divide, modulo,
+                                          less, less_equal, greater, greater_equal, equal, not_equal, logical_and, logical_or };
+
+            // one instruction of a compiled expression, number is only used by push_number and value only by push_variable
+            struct op {
+                op_code code;
+                variable value;
+                float number;
+            };
+
+            // the deepest an expression may nest its values, anything deeper is refused when compiling
+            static const int MAX_STACK = 16;
+
+            // compiles the expression and appends its program to the output
+            // throws std::invalid_argument saying what is wrong if the expression cannot be compiled
+            static void compile(std::string_view expression, std::vector<op>& output);
+
+            // runs a compiled program against the values (indexed by variable), anything other than 0 counts as true
+            // an empty program is always true
+            static bool evaluate(array_view<op> program, const float values[]);
+
+            // returns true if the program reads the given variable
+            static bool uses(array_view<op> program, variable value);
     };
 
     // text_line class
     //      Represents a line of text that can be shown on the matrix
+    //      The line itself never changes after loading, the parsed text is written into a string owned by whoever renders it
     class text_line {
         private:
             matrix_color color;
             matrix_font font_size;
             int x_pos;
             int y_pos;
-            std::string text;
-            std::string parsed_text;
+            std::string_view text;      // interned in the config_arena
+            array_view<line_condition::op> visible_if;     // compiled into the config_arena, empty if the line is always shown
         public:
             // constructor that takes in a color, matrix_font, x position, y position, and a text string
             //      instantiates the text_line object using these values
-            text_line(matrix_color, matrix_font, int, int, std::string);
+            //      the text is not copied, it must live as long as the line (it is interned in the config_arena)
+            text_line(matrix_color, matrix_font, int, int, std::string_view);
 
-            // parse all variables passed into the text object as actual data
+            // parse all variables passed into the text object as actual data into parsed_text
             // use the variable_utility to convert these variables into readable data
             // also give the matrix width to ensure everything fits on the screen before parsing
-            void parse_variables(matrix_clock::variable_utility* util, int MATRIX_WIDTH);
+            void parse_variables(matrix_clock::variable_utility* util, int MATRIX_WIDTH, std::string& parsed_text) const;
 
-            // get the current x position of the variable using the given width of the matrix (int)
+            // get the current x position of the parsed text using the given width of the matrix (int)
             //      if the x position is -1, then it will return an x value that will center the text line on the screen
             //      if the position is NOT -1, then it will return whatever x value was passed in
-            int parse_x(int MATRIX_WIDTH);
+            //      the parsed text is truncated if it does not fit on the screen from that position
+            int parse_x(int MATRIX_WIDTH, std::string& parsed_text) const;
 
             // get the current color converted to a color that the matrix library can use to draw text
             const rgb_matrix::Color get_color(void) const;
 
-            // return the text that has all the variables replaced to readable data
-            // it is assumed that you will call parse_variables() before this
-            inline std::string get_parsed_text(void) { return parsed_text; }
+            // return the text of the line before any variables are replaced
+            inline std::string_view get_text(void) const { return text; }
+
+            // sets the compiled visible_if expression of the line
+            inline void set_visible_if(array_view<line_condition::op> program) { visible_if = program; }
+
+            // get the compiled visible_if expression of the line, empty if the line is always shown
+            inline array_view<line_condition::op> get_visible_if(void) const { return visible_if; }
+
+            // returns true if the line is shown with the given condition values (see variable_utility::get_condition_values())
+            inline bool is_visible(const float values[]) const { return line_condition::evaluate(visible_if, values); }
 
             // get the matrix_font specified for the text line
-            inline matrix_font get_font(void) const { return font_size; }
+            inline const matrix_font& get_font(void) const { return font_size; }
 
             // get the y positioning of the text line
             // the y positioning is considered the bottom of the line of text
-            inline int get_y(void) { return y_pos; }
+            inline int get_y(void) const { return y_pos; }
+    };
+
+    // sprite class
+    //      A small image decoded once when the config is loaded (from a png or a binary ppm file) and drawn by update_clock()
+    //      Only the opaque pixels are kept, as runs of packed RGB pixels along each row, so drawing it walks straight through
+    //      memory without decoding, blending, or skipping transparent pixels
+    class sprite {
+        private:
+            // a stretch of opaque pixels on one row of the sprite
+            struct pixel_run {
+                int x, y, length;
+                std::size_t offset;     // where the run's pixels start in pixels
+            };
+
+            std::string_view name;      // the file it was loaded from, interned in the config_arena
+            int width, height;
+            std::vector<std::uint8_t> pixels;
+            std::vector<pixel_run> runs;
+
+            // splits the decoded image into runs of opaque pixels, alpha is null for an image without transparency
+            // pixels with an alpha below half are left out
+            void build_runs(const std::uint8_t* rgb, const std::uint8_t* alpha, int stride);
+
+            // decodes a png file, returns false if it could not be read
+            bool load_png(const std::string& path);
+
+            // decodes a binary (P6) ppm file, returns false if it could not be read
+            bool load_ppm(const std::string& path);
+        public:
+            // decodes the file, png files are recognized by their extension and anything else is read as a ppm file
+            // returns false (after saying why) if the file could not be decoded
+            bool load(std::string_view path);
+
+            // draws the sprite with its top left corner at (x, y), anything off the canvas is cut off
+            void draw(rgb_matrix::Canvas* canvas, int x, int y) const;
+
+            // get the file the sprite was loaded from
+            inline std::string_view get_name(void) const { return name; }
+
+            // get the width of the sprite in pixels
+            inline int get_width(void) const { return width; }
+
+            // get the height of the sprite in pixels
+            inline int get_height(void) const { return height; }
+    };
+
+    // icon_rule struct
+    //      Shows the sprite for every OpenWeatherMap condition code from low to high (inclusive)
+    struct icon_rule {
+        int low, high;
+        const sprite* image;
+    };
+
+    // weather_icon class
+    //      A sprite on a clock face picked by the current weather condition code, placed like a text line
+    //      The sprites and rules are views into the config_arena the clock face was loaded into
+    class weather_icon {
+        private:
+            int x_pos, y_pos;
+            array_view<icon_rule> rules;
+        public:
+            // creates an icon with its top left corner at (x, y) on the display, an x of -1 centers it
+            inline weather_icon(int x, int y, array_view<icon_rule> rules) { x_pos = x; y_pos = y; this->rules = rules; }
+
+            // returns the sprite of the narrowest rule covering the condition code, nullptr if no rule covers it
+            const sprite* get_sprite(int condition) const;
+
+            // get the x position of the icon for a sprite of the given width on a display of the given width
+            inline int get_x(int display_width, int sprite_width) const { return x_pos == -1 ? (display_width - sprite_width) / 2 : x_pos; }
+
+            // get the y position of the icon, unlike a text line this is the top edge of the sprite
+            inline int get_y(void) const { return y_pos; }
     };
 
     // clock_face class
     //      Represents all the visible information of the matrix
     //      Contains all the lines of text and the time periods it is visible
+    //      The name, lines, and time periods are views into the config_arena the clock face was loaded into
     class clock_face {
         private:
-            std::string name;
+            std::string_view name;
             matrix_color background_color;
-            std::vector<text_line> text_lines;
-            std::vector<time_period> time_periods;
+            array_view<text_line> text_lines;
+            array_view<weather_icon> icons;
+            array_view<time_period> time_periods;
             bool contains_seconds_code;
+            bool contains_centis_code;
+            int display;
         public:
             // instantiates a clock face with a specified name
-            inline clock_face(std::string name, matrix_color bg_color) { this->name = name; contains_seconds_code = false;
-                background_color = bg_color; }
+            // the name is not copied, it must live as long as the clock face
+            inline clock_face(std::string_view name, matrix_color bg_color) { this->name = name; contains_seconds_code = contains_centis_code = false;
+                background_color = bg_color; display = 0; }
 
-            // adds a time period to the clock face
+            // sets the time periods of the clock face
             // (a clock face can contain many time periods)
-            inline void add_time_period(time_period period) { time_periods.push_back(period); }
+            inline void set_time_periods(array_view<time_period> periods) { time_periods = periods; }
 
-            // returns a vector of all the time periods
-            inline std::vector<time_period> get_time_periods(void) const { return time_periods; }
+            // returns all the time periods
+            inline array_view<time_period> get_time_periods(void) const { return time_periods; }
 
-            // adds a new line of text to the matrix as a text_line object
+            // sets the lines of text shown on the matrix
             // (a clock can contain many lines of text)
-            inline void add_text(text_line text) { text_lines.push_back(text); }
+            inline void set_text_lines(array_view<text_line> lines) { text_lines = lines; }
 
             // get a text_line object contained by the "line" index of the text_line on the matrix
-            inline text_line get_line(int line) { return text_lines.data()[line]; }
+            inline const text_line& get_line(int line) const { return text_lines[line]; }
 
             // get the total amount of text_lines contained in the clock face object
-            inline int get_line_count(void) { return text_lines.size(); }
+            inline int get_line_count(void) const { return text_lines.size(); }
+
+            // sets the weather icons shown on the matrix, they are drawn on top of the text lines
+            inline void set_weather_icons(array_view<weather_icon> weather_icons) { icons = weather_icons; }
+
+            // get the weather icon at the given index
+            inline const weather_icon& get_icon(int icon) const { return icons[icon]; }
+
+            // get the total amount of weather icons on the clock face
+            inline int get_icon_count(void) const { return icons.size(); }
 
             // gets the name of the interface
             // this will be relevant more later when telegram bot implementation is added
-            inline std::string get_name(void) const { return name; }
+            inline std::string_view get_name(void) const { return name; }
 
             // get the background color of the clock face
             inline matrix_color get_background_color(void) const { return background_color; }
@@ -406,26 +1168,457 @@ namespace matrix_clock {
             // need to update the clock every minute
             // if there is a second variable, then we know we need to update the clock every second
             inline bool contains_second_variable(void) const { return contains_seconds_code; }
+
+            // set if the clock face contains a {tcenti} variable or not
+            inline void set_contains_centisecond_variable(bool contained) { contains_centis_code = contained; }
+
+            // return whether the clock has a centisecond variable
+            // while a face like this is shown and a timer is running it is redrawn many times a second instead of once
+            inline bool contains_centisecond_variable(void) const { return contains_centis_code; }
+
+            // get the index of the display the clock face is shown on (0 is the first display)
+            inline int get_display(void) const { return display; }
+
+            // set the index of the display the clock face is shown on
+            inline void set_display(int display_index) { display = display_index; }
+    };
+
+    // display_region class
+    //      One independent display inside the matrix, for example one panel of a chain, with its own set of clock faces
+    //      The positions of text lines on a clock face are relative to the top left corner of the display it is shown on
+    class display_region {
+        private:
+            std::string name;
+            int x, y, width, height;
+        public:
+            // creates a display covering width x height pixels starting at (x, y) on the matrix
+            inline display_region(std::string name, int x, int y, int width, int height) {
+                this->name = name;      this->x = x;    this->y = y;    this->width = width;    this->height = height;
+            }
+
+            // get the name of the display used by clock faces in the config file
+            inline std::string get_name(void) const { return name; }
+
+            // get the left edge of the display on the matrix
+            inline int get_x(void) const { return x; }
+
+            // get the top edge of the display on the matrix
+            inline int get_y(void) const { return y; }
+
+            // get the width of the display in pixels
+            inline int get_width(void) const { return width; }
+
+            // get the height of the display in pixels
+            inline int get_height(void) const { return height; }
+    };
+
+    // font_registry class
+    //      Loads every bdf font once and hands the same loaded font out to every line on every display that uses it
+    class font_registry {
+        private:
+            // fonts by folder, then by font size
+            // std::less<> lets both be looked up without building a std::string on every frame
+            std::map<std::string, std::map<std::string, rgb_matrix::Font*, std::less<>>, std::less<>> fonts;
+            std::mutex registry_lock;
+        public:
+            // frees every loaded font
+            ~font_registry();
+
+            // returns the font of the given size in the given folder, it is only read from disk the first time it is asked for
+            const rgb_matrix::Font* get_font(const std::string& font_folder, std::string_view font_size);
+    };
+
+    // text_raster_cache class
+    //      Keeps the pixels of recently drawn lines of text, keyed by font, color, and text, so a line that comes back (a day name,
+    //      a minute, a forecast word) is copied onto the canvas from a bitmap instead of being drawn glyph by glyph again
+    //      Every entry is allocated when the cache is sized, so looking lines up, adding them, and evicting the least recently
+    //      used one never touches the heap
+    //      Lines wider than MAX_WIDTH, fonts taller than MAX_HEIGHT, and text longer than MAX_TEXT are drawn directly instead,
+    //      without pushing a cached line out for them
+    class text_raster_cache {
+        public:
+            static const int MAX_WIDTH = 256;
+            static const int MAX_HEIGHT = 32;
+            static const int MAX_TEXT = 64;
+        private:
+            static const int ROW_WORDS = MAX_WIDTH / 64;
+
+            struct entry {
+                const rgb_matrix::Font* font;
+                std::uint8_t r, g, b;
+                std::uint8_t text_length;
+                char text[MAX_TEXT];
+                int width;                  // what rgb_matrix::DrawText() returned for the text
+                int rows;                   // the font height, row 0 is baseline pixels above the y the text is drawn at
+                std::uint64_t last_used;    // 0 while the entry is free
+                std::uint64_t bits[MAX_HEIGHT * ROW_WORDS];     // one bit per pixel, the leftmost pixel is the lowest bit
+            };
+
+            std::vector<entry> entries;
+            std::vector<std::uint64_t> hashes;      // kept apart from the entries so a lookup only scans this
+            std::uint64_t use_count;
+            std::atomic<std::uint64_t> hits, misses;    // the render thread counts, the bot reads them
+
+            // adds up the advance of every glyph of the text, the same way rgb_matrix::DrawText() moves along when drawing it
+            static int measure(const rgb_matrix::Font& font, const std::string& text);
+
+            // draws the text into the bitmap of the entry, returns false if any pixel fell outside of it
+            static bool rasterize(entry& target, const rgb_matrix::Font& font, const rgb_matrix::Color& color, const std::string& text);
+
+            // sets the pixels of the entry on the canvas with the baseline at y
+            static void blit(const entry& source, rgb_matrix::Canvas* canvas, int x, int y, const rgb_matrix::Color& color);
+        public:
+            inline text_raster_cache() { use_count = 0; hits = misses = 0; }
+
+            // sizes the cache to hold the given number of lines (0 turns it off), everything cached so far is dropped
+            void resize(int capacity);
+
+            // get the number of lines the cache can hold
+            inline int get_capacity(void) const { return entries.size(); }
+
+            // draws the text with its baseline at y the same way rgb_matrix::DrawText() would, from the cache if it was drawn before
+            // returns the width of the text
+            int draw(rgb_matrix::Canvas* canvas, const rgb_matrix::Font& font, int x, int y, const rgb_matrix::Color& color, const std::string& text);
+
+            // get the number of lines drawn from the cache
+            inline std::uint64_t get_hits(void) const { return hits; }
+
+            // get the number of lines that had to be drawn glyph by glyph
+            inline std::uint64_t get_misses(void) const { return misses; }
+
+            // returns a readable summary of how well the cache is doing, used by the telegram bot
+            std::string report(void) const;
+    };
+
+    // dirty_rect struct
+    //      A region of the matrix (in pixels) that changed between two rendered frames
+    struct dirty_rect {
+        int x, y, width, height;
+    };
+
+    // frame_buffer struct
+    //      A plain RGB copy of what was drawn on a frame (3 bytes per pixel, row major) that frame sinks can read
+    struct frame_buffer {
+        int width = 0, height = 0;
+        std::vector<std::uint8_t> pixels;
+    };
+
+    // mirrored_canvas class
+    //      A canvas that forwards every drawing call to the matrix's offscreen canvas while writing the same pixels into a frame_buffer
+    //      The offscreen canvas only stores pixels in the panel's internal bit plane format, so this is how sinks get readable pixels
+    //      without ever copying the framebuffer after it is drawn
+    class mirrored_canvas : public rgb_matrix::Canvas {
+        private:
+            rgb_matrix::Canvas* target;
+            frame_buffer* buffer;
+        public:
+            inline mirrored_canvas() { target = nullptr; buffer = nullptr; }
+
+            // start mirroring drawing calls on the target canvas into the given buffer (the buffer is resized to the canvas if needed)
+            void attach(rgb_matrix::Canvas* target, frame_buffer* buffer);
+
+            inline int width() const override { return target->width(); }
+            inline int height() const override { return target->height(); }
+            void SetPixel(int x, int y, std::uint8_t red, std::uint8_t green, std::uint8_t blue) override;
+            void Clear() override;
+            void Fill(std::uint8_t red, std::uint8_t green, std::uint8_t blue) override;
+    };
+
+    // headless_canvas class
+    //      A canvas that is not backed by a matrix at all, the pixels drawn on it only end up in a frame_buffer
+    //      Lets the clock render without any hardware attached, for example while simulating a schedule
+    class headless_canvas : public rgb_matrix::Canvas {
+        private:
+            frame_buffer buffer;
+        public:
+            headless_canvas(int width, int height);
+
+            // returns everything drawn on the canvas so far
+            inline const frame_buffer& get_buffer(void) const { return buffer; }
+
+            inline int width() const override { return buffer.width; }
+            inline int height() const override { return buffer.height; }
+            void SetPixel(int x, int y, std::uint8_t red, std::uint8_t green, std::uint8_t blue) override;
+            void Clear() override;
+            void Fill(std::uint8_t red, std::uint8_t green, std::uint8_t blue) override;
+    };
+
+    // frame_sink class
+    //      Interface for anything other than the physical matrix that consumes rendered frames
+    //      Sinks are only notified when a frame actually changed, and are handed the regions that changed
+    //      so they only have to process those
+    //      The frame is shared and never written to again while a sink holds on to it, so sinks may keep it and process it on their own thread
+    class frame_sink {
+        public:
+            virtual ~frame_sink() {}
+
+            // called with the freshly rendered frame right before it is swapped onto the matrix
+            virtual void push_frame(std::shared_ptr<const frame_buffer> frame, const std::vector<dirty_rect>& dirty_rects) = 0;
+    };
+
+    // frame_capture class
+    //      A frame sink that holds on to the most recent frame so it can be looked at later (for example for a screenshot)
+    //      Frames are shared with the renderer, so keeping the latest one costs no copy at all on the render thread
+    class frame_capture : public frame_sink {
+        private:
+            mutable std::mutex capture_lock;
+            std::shared_ptr<const frame_buffer> latest;
+        public:
+            // remembers the frame as the latest one, releasing the previous frame back to the renderer
+            void push_frame(std::shared_ptr<const frame_buffer> frame, const std::vector<dirty_rect>& dirty_rects) override;
+
+            // returns the latest frame, or nullptr if nothing has been drawn yet
+            std::shared_ptr<const frame_buffer> get_latest(void) const;
+    };
+
+    // encodes the frame as a png image, blowing every pixel up into a scale x scale square (nearest neighbor) so small panels are readable
+    // the png file is written into output, returns false if the image could not be encoded
+    bool encode_png(const frame_buffer& frame, int scale, std::string& output);
+
+    // frame_tracker class
+    //      Remembers what was drawn on the previous frame so identical frames are never redrawn or swapped
+    //      Each frame is summarized by a fast hash of everything visible (background, and every line's text, font, position, and color)
+    //      When the hash changes, the bounding boxes of the lines that changed are collected as dirty rectangles
+    class frame_tracker {
+        private:
+            // what a single line looked like when it was drawn
+            struct line_snapshot {
+                std::string text;
+                std::string font;
+                int x, y;
+                int r, g, b;
+                dirty_rect bounds;
+            };
+
+            // what the background of a single display looked like when it was drawn
+            struct background_snapshot {
+                dirty_rect region;
+                int r, g, b;
+            };
+
+            // the line vectors only ever grow, the counts say how many of their snapshots belong to the frame
+            // this way the strings of the snapshots keep their memory from frame to frame instead of being freed and allocated again
+            std::vector<line_snapshot> previous_lines;
+            std::vector<line_snapshot> current_lines;
+            std::size_t previous_line_count, current_line_count;
+            std::vector<background_snapshot> previous_backgrounds;
+            std::vector<background_snapshot> current_backgrounds;
+            std::vector<dirty_rect> dirty_rects;
+            std::vector<frame_sink*> sinks;
+            std::vector<std::shared_ptr<frame_buffer>> buffer_pool;
+            std::shared_ptr<frame_buffer> current_buffer;
+            std::shared_ptr<frame_buffer> last_buffer;      // the buffer of the last committed frame, a partial redraw starts from a copy of it
+            std::vector<dirty_rect> erase_rects;
+            std::vector<char> redraw_lines;
+            mirrored_canvas mirror;
+            std::uint64_t previous_hash;
+            bool has_previous;
+            int frame_width, frame_height;
+
+            // hashes the given backgrounds and lines into a single value
+            std::uint64_t hash_frame(const std::vector<background_snapshot>& backgrounds, const std::vector<line_snapshot>& lines, std::size_t line_count) const;
+
+            // returns true if the given backgrounds are the same as the ones on the previous frame
+            bool same_backgrounds(void) const;
+
+            // returns true if both lines put the exact same pixels on the screen
+            static bool same_look(const line_snapshot& first, const line_snapshot& second);
+        public:
+            // instantiates a tracker with no previous frame, so the first frame is always drawn
+            inline frame_tracker() { has_previous = false; previous_hash = 0; frame_width = frame_height = 0; previous_line_count = current_line_count = 0; }
+
+            // starts a new frame on a canvas of the given size
+            void begin_frame(int width, int height);
+
+            // records the background color of a display on the current frame
+            void add_background(const dirty_rect& region, const matrix_color& bg_color);
+
+            // records a line that will be drawn on the current frame (before the bounds are known)
+            void add_line(std::string_view text, std::string_view font, int x, int y, const rgb_matrix::Color& color);
+
+            // records a sprite that will be drawn on the current frame, it is tracked as a line without a font from then on
+            // (the name of the sprite stands in for the text), so set_line_bounds() and needs_redraw() take its index like a line's
+            inline void add_sprite(std::string_view name, int x, int y) { add_line(name, "", x, y, rgb_matrix::Color(0, 0, 0)); }
+
+            // returns true if the frame started with begin_frame() is identical to the last committed frame
+            bool unchanged(void) const;
+
+            // works out whether the current frame can be drawn on top of a copy of the last one instead of from scratch
+            // that is the case when it shows the same backgrounds and the same number of lines, then only the changed lines are drawn again
+            // returns true if it can, get_erase_rects() and needs_redraw() then say what has to be drawn
+            bool plan_partial_redraw(void);
+
+            // returns the boxes of the last frame that have to be painted over with the background before a partial redraw
+            inline const std::vector<dirty_rect>& get_erase_rects(void) const { return erase_rects; }
+
+            // returns true if the line at the given index has to be drawn again in a partial redraw
+            inline bool needs_redraw(std::size_t line) const { return redraw_lines[line] != 0; }
+
+            // a line drawn again in a partial redraw may have grown over lines after it, which are normally drawn on top of it
+            // call this once its new bounds are set so those lines are drawn again too
+            void redraw_overlapping(std::size_t line);
+
+            // returns the canvas the current frame should be drawn on
+            // without any sinks this is just the offscreen canvas, otherwise it is a mirror that also fills a pooled frame_buffer for the sinks
+            // for a partial redraw the mirror starts out as a copy of the last frame, the offscreen canvas has to be copied by the caller
+            rgb_matrix::Canvas* get_canvas(rgb_matrix::Canvas* offscreen, bool partial);
+
+            // sets the on screen bounds of the line at the given index once it has been drawn
+            void set_line_bounds(int line, int x, int y, int width, int height);
+
+            // finishes the current frame, computing the dirty rectangles against the previous frame and remembering it for next time
+            void commit_frame(void);
+
+            // forget the previous frame so the next one is always drawn (used when the screen is cleared outside of update_clock())
+            inline void invalidate(void) { has_previous = false; }
+
+            // clears the offscreen canvas along with the frame the sinks get, then forgets the previous frame like invalidate()
+            // call notify_sinks() afterwards so remote viewers and screenshots see the blank screen instead of the last lit frame
+            void clear_frame(rgb_matrix::Canvas* offscreen);
+
+            // returns the regions that changed in the last committed frame
+            inline const std::vector<dirty_rect>& get_dirty_rects(void) const { return dirty_rects; }
+
+            // registers a sink that gets notified with every changed frame
+            inline void add_sink(frame_sink* sink) { sinks.push_back(sink); }
+
+            // hands the committed frame and its dirty rectangles to every registered sink
+            void notify_sinks(void) const;
+    };
+
+    // present_timing class
+    //      Measures how long after the start of a second the frame drawn ahead for it was up on the matrix
+    //      The render thread records, the bot reads the report, so everything is kept in atomics
+    class present_timing {
+        private:
+            std::atomic<std::uint64_t> count, total_us, late;
+            std::atomic<std::int64_t> best_us, worst_us;
+        public:
+            // frames presented more than this long after their second are counted as late
+            static const int LATE_US = 10000;
+
+            inline present_timing() { count = total_us = late = 0; best_us = worst_us = 0; }
+
+            // records a frame that was up the given number of microseconds after the start of its second
+            void record(std::int64_t offset_us);
+
+            // get the number of frames recorded
+            inline std::uint64_t get_count(void) const { return count; }
+
+            // returns a readable summary of the offsets so far, used by the telegram bot and the stats file
+            std::string report(void) const;
+    };
+
+    // memory_stats class
+    //      Keeps an eye on how much memory the clock uses so slow growth over weeks of running can be spotted
+    //      All numbers are in kilobytes, the resident set comes from /proc/self/statm and the heap from the allocator
+    class memory_stats {
+        private:
+            long start_rss, start_heap;
+            std::time_t start_time;
+            std::string stats_file;
+            int stats_interval;
+            const text_raster_cache* text_cache;
+            const present_timing* timing;
+        public:
+            // remembers the memory used right now as the baseline everything is compared against
+            memory_stats();
+
+            // returns the resident set size of the process
+            static long get_rss(void);
+
+            // returns the highest resident set size the process has ever had
+            static long get_peak_rss(void);
+
+            // returns the amount of heap currently handed out by malloc/new
+            static long get_heap(void);
+
+            // returns a readable summary of the memory use and how much it grew since startup, used by the telegram bot
+            std::string report(void) const;
+
+            // sets the file a line of stats is appended to every interval minutes, an empty path disables it
+            inline void set_stats_file(std::string path, int interval) { stats_file = path; stats_interval = interval > 0 ? interval : 60; }
+
+            // sets the text cache whose hits and misses are reported along with the memory, nullptr if there is none
+            inline void set_text_cache(const text_raster_cache* cache) { text_cache = cache; }
+
+            // sets the timing of the frames drawn ahead that is reported along with the memory, nullptr if there is none
+            inline void set_present_timing(const present_timing* present) { timing = present; }
+
+            // appends a line of stats to the stats file if one is set and the minute of the day lines up with the interval
+            // the line holds the date, seconds since startup, resident set, peak resident set, heap in use, text cache hits and misses,
+            // and how long after their second the frames drawn ahead were up
+            void write_stats(int hour, int minute) const;
+    };
+
+    // startup_report class
+    //      Times the phases of starting up so slow starts (and slow recoveries after a power cut) can be tracked down
+    //      The phases on the main thread are printed together once the first frame is up, the ones that finish in the background
+    //      print a line of their own when they are done
+    class startup_report {
+        private:
+            std::int64_t launch_ms, phase_ms;
+            std::string phases;
+            std::mutex report_lock;     // background phases report from their own threads
+
+            static std::int64_t now_ms(void);
+        public:
+            // starts timing, this is taken as the moment of launch
+            startup_report();
+
+            // ends the phase running on the main thread under the given name, the next phase starts right away
+            void phase(const std::string& name);
+
+            // prints every phase so far along with how long after launch the first frame was up
+            void print_first_frame(void);
+
+            // returns the time a background phase starts at, to hand to background_done() later
+            inline std::int64_t background_start(void) const { return now_ms(); }
+
+            // prints how long a background phase took and how long after launch it was done
+            void background_done(const std::string& name, std::int64_t started_ms);
+    };
+
+    // allocation_guard class
+    //      Checks that the render tick it wraps does not touch the heap once the clock is running steadily
+    //      It only does something in builds made with "make ALLOC_CHECK=1", where the global operator new is hooked to count
+    //      allocations per thread (see alloc_check.cpp); in normal builds the guard is empty and costs nothing
+    class allocation_guard {
+#ifdef MATRIX_ALLOC_CHECK
+        private:
+            long allocations_before;
+        public:
+            // starts counting the allocations made on the current thread
+            allocation_guard();
+
+            // if the tick was steady (the same faces as last tick, nothing forced) and anything was allocated since the guard
+            // was made, prints how many allocations there were and aborts
+            void check(bool steady) const;
+#else
+        public:
+            inline void check(bool steady) const {}
+#endif
     };
 
     // telegram_push class
     //      Represents the data that would be used for a scheduled push notification
     class telegram_push {
     private:
-        std::string message;
+        std::string_view message;   // interned in the config_arena
         int hour, minute;
-        std::vector<int> days;
+        std::uint8_t days;          // one bit per day of the week, bit 0 is Sunday
     public:
         // default constructor, takes in all data for the field variables (it is assumed this will be used while parsing the config json file)
-        telegram_push(std::string message, int hour, int minute, std::vector<int> days) {
+        // days is a bit mask of the days of the week the notification is sent on
+        telegram_push(std::string_view message, int hour, int minute, std::uint8_t days) {
             this->message = message;        this->hour = hour;      this->minute = minute;      this->days = days;
         }
 
         // checks if it is time to send a push notification, returns true if so
         // if hour is -1, we consider it hourly and this is acceptable
-        inline bool is_push_time(int current_hour, int current_minute, int day_of_week) {
+        inline bool is_push_time(int current_hour, int current_minute, int day_of_week) const {
             if (hour >= 0) {        // return true of the hour, minute, and day of the week line up, false otherwise
-                return current_hour == hour && current_minute == minute && std::find(days.begin(), days.end(), day_of_week) != days.end();
+                return current_hour == hour && current_minute == minute && ((days >> day_of_week) & 1);
             } else {
                 if (current_hour == 0 && current_minute == minute) return true;     // 0 is the root of every repetition
                 else return (current_hour % abs(hour) == 0 && current_minute == minute);    // 24 % current value (to positive + 1) must equal 0 to hit our intervals
@@ -433,53 +1626,211 @@ namespace matrix_clock {
         }
 
         // grab the message for the notification
-        inline std::string get_message(void) const { return message; }
+        inline std::string_view get_message(void) const { return message; }
+    };
+
+    // config_arena class
+    //      Owns everything loaded from matrix_config.json that the clock faces are made of
+    //      Clock faces, text lines, time periods, and notifications are each kept in one flat array, and every piece of text
+    //      (names, lines, font names, messages) lives in one interned buffer the objects only hold views into
+    //      Everything is reserved up front so nothing moves while loading, and a whole configuration is freed at once with the arena
+    class config_arena {
+        private:
+            std::string text;
+            std::vector<clock_face> faces;
+            std::vector<text_line> lines;
+            std::vector<time_period> periods;
+            std::vector<telegram_push> notifications;
+            std::vector<sprite> sprites;
+            std::vector<icon_rule> icon_rules;
+            std::vector<weather_icon> icons;
+            std::vector<line_condition::op> condition_ops;
+            clock_face timer_face;
+        public:
+            // creates an empty arena
+            inline config_arena() : timer_face("timer", matrix_color(matrix_prebuilt_colors::black)) {}
+
+            // reserves room for everything that will be added, adding more than this afterwards is refused
+            // every icon rule can bring a sprite of its own, so rule_count is also the room kept for sprites
+            // a visible_if expression never compiles into more ops than it has characters, so condition_op_count is their total length
+            void reserve(std::size_t text_bytes, std::size_t face_count, std::size_t line_count, std::size_t period_count, std::size_t notification_count,
+                         std::size_t icon_count, std::size_t rule_count, std::size_t condition_op_count);
+
+            // copies the string into the text buffer and returns a view of it, identical strings are only stored once
+            std::string_view intern(const std::string& value);
+
+            // add a clock face to the arena and return it so its lines and time periods can be filled in
+            clock_face& add_face(const clock_face& face);
+
+            // add a line to the arena, lines of the same clock face must be added one after another
+            void add_line(const text_line& line);
+
+            // add a time period to the arena, time periods of the same clock face must be added one after another
+            void add_period(const time_period& period);
+
+            // add a telegram push notification to the arena
+            void add_notification(const telegram_push& notification);
+
+            // returns the sprite decoded from the given file, decoding it only the first time the file is asked for
+            // returns nullptr if the file could not be decoded
+            const sprite* add_sprite(const std::string& path);
+
+            // add an icon rule to the arena, rules of the same icon must be added one after another
+            void add_icon_rule(const icon_rule& rule);
+
+            // add a weather icon to the arena, icons of the same clock face must be added one after another
+            void add_icon(const weather_icon& icon);
+
+            // compiles a visible_if expression into the arena and returns a view of its program
+            // throws std::invalid_argument if the expression cannot be compiled
+            array_view<line_condition::op> add_condition(std::string_view expression);
+
+            // returns a view of all icon rules added since the rule count was first
+            inline array_view<icon_rule> icon_rules_since(std::size_t first) const { return array_view<icon_rule>(icon_rules.data() + first, icon_rules.size() - first); }
+
+            // returns a view of all weather icons added since the icon count was first
+            inline array_view<weather_icon> icons_since(std::size_t first) const { return array_view<weather_icon>(icons.data() + first, icons.size() - first); }
+
+            // get the amount of icon rules added so far
+            inline std::size_t get_icon_rule_count(void) const { return icon_rules.size(); }
+
+            // get the amount of weather icons added so far
+            inline std::size_t get_icon_count(void) const { return icons.size(); }
+
+            // returns a view of all lines added since the line count was first
+            inline array_view<text_line> lines_since(std::size_t first) const { return array_view<text_line>(lines.data() + first, lines.size() - first); }
+
+            // returns a view of all time periods added since the time period count was first
+            inline array_view<time_period> periods_since(std::size_t first) const { return array_view<time_period>(periods.data() + first, periods.size() - first); }
+
+            // get the amount of lines added so far
+            inline std::size_t get_line_count(void) const { return lines.size(); }
+
+            // get the amount of time periods added so far
+            inline std::size_t get_period_count(void) const { return periods.size(); }
+
+            // get every clock face
+            inline const std::vector<clock_face>& get_faces(void) const { return faces; }
+
+            // get every telegram push notification
+            inline const std::vector<telegram_push>& get_notifications(void) const { return notifications; }
+
+            // get the clock face for the timer
+            inline const clock_face* get_timer_face(void) const { return &timer_face; }
+
+            // set the clock face for the timer
+            inline void set_timer_face(const clock_face& face) { timer_face = face; }
+    };
+
+    // clock_observer class
+    //      Gets told about what the clock does besides drawing, a simulation logs all of it with the simulated time
+    class clock_observer {
+        public:
+            virtual ~clock_observer() {}
+
+            // the display at the given index switched from one clock face to another
+            virtual void face_changed(std::size_t display, const clock_face* from, const clock_face* to) = 0;
+
+            // a telegram message would have been sent (a push notification or a finished timer)
+            virtual void message_sent(const std::string& message) = 0;
+    };
+
+    // face_state struct
+    //      A copy of the displays and the clock face shown on every one of them, taken in one go by matrix_data::copy_state()
+    //      The configuration the faces come from is held along with them, so a reload can not free them while the copy is kept
+    struct face_state {
+        std::shared_ptr<const config_arena> config;
+        std::vector<display_region> displays;
+        std::vector<const clock_face*> faces;   // indexed the same as displays
+
+        // returns true if any display is showing a clock face with a {second} variable
+        inline bool contains_second_variable(void) const {
+            return std::any_of(faces.begin(), faces.end(), [](const clock_face* face) { return face->contains_second_variable(); });
+        }
     };
 
     // matrix_data class
     //      Represents a container of clock faces to hold everything needed for the matrix
     class matrix_data {
         private:
-            std::vector<clock_face*> clock_faces;
-            std::vector<telegram_push*> push_notifications;
-            clock_face* current;
-            clock_face* empty;
-            clock_face* timer_face;
+            // the configuration the clock faces come from, only ever read and replaced through std::atomic_load() and std::atomic_store()
+            // a reload swaps in a new arena, the old one is freed once the last thread drawing from it lets go of it
+            std::shared_ptr<const config_arena> config;
+            // the bot switches faces and reloads the config while the render thread draws, the configuration, the displays, the
+            // faces shown on them, and the off periods are only ever changed (and copied out) while holding this
+            mutable std::mutex state_lock;
+            std::vector<display_region> displays;
+            std::vector<const clock_face*> current_faces;
+            std::vector<bool> overridden;
+            clock_face empty;
             std::string config_file;
             std::string weather_url;
+            std::string weather_provider_name;
+            std::string weather_file;
+            std::string weather_cache;
+            int weather_cache_ttl;
             std::string bot_token;
             std::int64_t bot_chat_id;
             std::string fonts_folder;
+            std::string stream_socket;
+            std::string stream_bind;
+            int stream_port;
+            std::string stats_file;
+            int stats_interval;
+            std::vector<time_period> off_periods;     // when the clock turns itself off, copied out of the config on every load
+            int idle_weather_interval;
+            std::vector<variable_source> variable_sources;
             int skip_seconds;
-            bool override_interface;
-            bool force_update;
-            bool clock_on;
+            int canvas_width, canvas_height;
+            int timer_display;
+            std::atomic<bool> force_update;     // set by the bot and the background startup work, read by the render loop
+            std::atomic<bool> clock_on;     // switched by the bot, read by the render loop
+            int wake_fd;                    // an eventfd written to whenever the clock is turned on, see wait_for_clock_on()
             bool timer_notify_on_complete;
             int timer_hold;
             bool timer_blink;
+            int centisecond_rate;
+            int text_cache_size;
+            bool render_ahead;
             int buzzer_pin;
+            bool gpio_enabled;      // wiringPiSetupGpio() ran, so the buzzer pin can be set up
+            clock_observer* observer;       // told about every face change, null unless set_observer() is called
+
+            // puts the face on the display, telling the observer if that changes what the display shows
+            void show_face(std::size_t display, const clock_face* face);
         public:
             // default constructor, instantiates an empty container
             matrix_data(std::string config_file);
 
-            // add a new clock_face pointer to the container
-            inline void add_clock_face(clock_face* new_clock_face) { clock_faces.push_back(new_clock_face); }
+            ~matrix_data();
 
-            // add a new push notification pointer to the container
-            inline void add_notification(telegram_push* notification) { push_notifications.push_back(notification); }
+            // get the configuration the clock faces come from, the faces it holds stay valid for as long as it is held
+            inline std::shared_ptr<const config_arena> get_config(void) const { return std::atomic_load(&config); }
 
             // return the amount of clock faces in the container
-            inline size_t get_clock_face_count(void) const { return clock_faces.size(); }
+            inline size_t get_clock_face_count(void) const { return get_config()->get_faces().size(); }
+
+            // get every font size used by a text line of any clock face or the timer, each one once
+            std::vector<std::string> get_font_sizes(void) const;
 
-            // get the names of all the clock faces as a string array
-            std::string* get_names(void) const;
+            // get every clock face, in the order they are declared in the config file
+            // Note: the faces belong to the current configuration, hold get_config() instead if the bot may reload while they are used
+            inline const std::vector<clock_face>& get_clock_faces(void) const { return get_config()->get_faces(); }
+
+            // get the names of all the clock faces
+            std::vector<std::string> get_names(void) const;
 
             // update the clock face to one with the given name
+            // only the display the clock face belongs to changes, and that display is overridden so it will not change with time
             void update_clock_face(std::string name);
 
-            // update the clock face in the given time and day
+            // update the clock face of every display that is not overridden to the one for the given time and day
             void update_clock_face(int hour, int minute, int day_of_week);
 
+            // set the size of the whole matrix canvas, displays that do not specify their size fill whatever is left of it
+            // this MUST BE called before load_clock_data()
+            inline void set_canvas_size(int width, int height) { canvas_width = width; canvas_height = height; }
+
             //this loads all the clock faces and other data from the matrix_config.json in the repository
             //you can edit matrix_config.json all you want, as long as valid json and data is submitted than it will load the
             //program using that data and update everything when needed
@@ -487,13 +1838,41 @@ namespace matrix_clock {
             //otherwise nothing will be loaded and there will be no information to grab for writing
             bool load_clock_data();
 
-            // get the current clock face
-            inline clock_face* get_current(void) const { return current; }
+            // the same as load_clock_data() with the config file already parsed, so startup only reads and parses it once
+            bool load_clock_data(const Json::Value& jsonData);
+
+            // copies the displays and the clock face currently shown on every one of them into state
+            // the vectors of state keep their memory, so once they have grown to fit the displays this does not allocate anything
+            void copy_state(face_state& state) const;
+
+            // get all the displays declared in matrix_config.json (there is always at least one)
+            // Note: you MUST run load_clock_data() before this is valid, and a reload from the bot replaces them, the render
+            // thread and the bot use copy_state() instead
+            inline const std::vector<display_region>& get_displays(void) const { return displays; }
+
+            // get the index of the display the timer is shown on
+            inline int get_timer_display(void) const { return timer_display; }
 
             // get the weather URL declared in matrix_config.json
             // Note: you MUST run load_clock_data() before this is valid
             inline std::string get_weather_url(void) const { return weather_url; }
 
+            // get the name of the weather provider (openweathermap, file, or stub)
+            // Note: you MUST run load_clock_data() before this is valid
+            inline std::string get_weather_provider(void) const { return weather_provider_name; }
+
+            // get the file the file weather provider reads from
+            // Note: you MUST run load_clock_data() before this is valid
+            inline std::string get_weather_file(void) const { return weather_file; }
+
+            // get the file the last good weather is kept in (empty if disabled)
+            // Note: you MUST run load_clock_data() before this is valid
+            inline std::string get_weather_cache(void) const { return weather_cache; }
+
+            // get how many minutes the kept weather is good for
+            // Note: you MUST run load_clock_data() before this is valid
+            inline int get_weather_cache_ttl(void) const { return weather_cache_ttl; }
+
             // get the bot token declared in matrix_config.json
             // Note: you MUST run load_clock_data() before this is valid
             inline std::string get_bot_token(void) const { return bot_token; }
@@ -504,16 +1883,41 @@ namespace matrix_clock {
 
             // get the folder the rgb matrix fonts are stored in
             // Note: you MUST run load_clock_data() before this is valid
-            inline std::string get_fonts_folder(void) const { return fonts_folder; }
+            inline const std::string& get_fonts_folder(void) const { return fonts_folder; }
+
+            // get the unix socket path the live frame stream is published on (empty if disabled)
+            // Note: you MUST run load_clock_data() before this is valid
+            inline std::string get_stream_socket(void) const { return stream_socket; }
+
+            // get the tcp port the live frame stream is published on (0 if disabled)
+            // Note: you MUST run load_clock_data() before this is valid
+            inline int get_stream_port(void) const { return stream_port; }
+
+            // get the address the tcp port of the live frame stream listens on (127.0.0.1 unless set, so only this machine can watch)
+            // Note: you MUST run load_clock_data() before this is valid
+            inline std::string get_stream_bind(void) const { return stream_bind; }
+
+            // get the file memory stats are appended to (empty if disabled)
+            // Note: you MUST run load_clock_data() before this is valid
+            inline std::string get_stats_file(void) const { return stats_file; }
+
+            // get how many minutes apart memory stats are written to the stats file
+            // Note: you MUST run load_clock_data() before this is valid
+            inline int get_stats_interval(void) const { return stats_interval; }
 
             // get the telegram push notifications vector
-            inline std::vector<telegram_push*> get_notifications(void) const { return push_notifications; }
+            // Note: the same as get_clock_faces(), hold get_config() instead if the bot may reload while they are used
+            inline const std::vector<telegram_push>& get_notifications(void) const { return get_config()->get_notifications(); }
+
+            // get the variable sources declared in matrix_config.json
+            // Note: you MUST run load_clock_data() before this is valid
+            inline const std::vector<variable_source>& get_variable_sources(void) const { return variable_sources; }
 
-            // check whether the clock face is overridden via the telegram bot
-            inline bool clock_face_overridden(void) const { return override_interface; }
+            // check whether the clock face of any display is overridden via the telegram bot
+            bool clock_face_overridden(void) const;
 
-            // set whether the clock face is overridden
-            inline void set_clock_face_override(bool override) { override_interface = override; }
+            // stop overriding the clock faces of every display so they change with time again
+            void clear_clock_face_overrides(void);
 
             // check if we need to force a clock face update
             inline bool update_required(void) const { return force_update; }
@@ -524,8 +1928,22 @@ namespace matrix_clock {
             // check if the clock is on or not
             inline bool is_clock_on(void) const { return clock_on; }
 
-            // set the clock on (true) or off (false)
-            inline void set_clock_on(bool on) { clock_on = on; }
+            // set the clock on (true) or off (false), turning it on wakes up wait_for_clock_on()
+            void set_clock_on(bool on);
+
+            // sleeps until the clock is turned on or the timeout (in milliseconds) runs out, returns true if the clock is on
+            // this is how the main loop idles while the clock is off, it wakes right away when the bot turns the clock back on
+            bool wait_for_clock_on(int timeout_ms);
+
+            // get the eventfd wait_for_clock_on() waits on, writing to it (from a signal handler, for example) ends the wait early
+            inline int get_wake_fd(void) const { return wake_fd; }
+
+            // returns true if the time is inside one of the periods the clock turns itself off for
+            bool in_off_period(int hour, int minute, int day_of_week) const;
+
+            // get how many minutes apart the weather is polled while the clock is off, 0 to not poll it at all
+            // Note: you MUST run load_clock_data() before this is valid
+            inline int get_idle_weather_interval(void) const { return idle_weather_interval; }
 
             // checks to see whether we should skip the next second or not
             // important because we want to check whether the config was recently reloaded
@@ -533,17 +1951,17 @@ namespace matrix_clock {
             // that a natural update could run while we are clearing it
             // in this scenario we want to make sure it is not in the process of being reloaded while we are accessing
             // data because it could potentially become null halfway through updating
-            // the same reason as the configuration reload is used but for the timer as well
             bool skip_second(void);
 
             // sets how many seconds we should skip of update
             inline void set_skip_second(int skip_count)  { skip_seconds = skip_count; }
 
-            // adds the timer clock face
-            inline void set_timer_face(clock_face* new_timer_face) { timer_face = new_timer_face; }
+            // returns true if there are still seconds to skip
+            inline bool skipping_seconds(void) const { return skip_seconds > 0; }
 
             // returns the clock face for the timer
-            inline clock_face* get_timer_face(void) { return timer_face; }
+            // Note: the same as get_clock_faces(), hold get_config() instead if the bot may reload while it is used
+            inline const clock_face* get_timer_face(void) const { return get_config()->get_timer_face(); }
 
             // returns the length of time the timer will stay on the screen once it ends
             inline int get_timer_hold(void) const { return timer_hold; }
@@ -557,21 +1975,79 @@ namespace matrix_clock {
             // sets whether the timer should blink once its complete
             inline void set_timer_blink(bool new_blink) { timer_blink = new_blink; }
 
+            // returns how many times a second a face showing {tcenti} is redrawn while a timer runs
+            inline int get_centisecond_rate(void) const { return centisecond_rate; }
+
+            // returns how many lines of text the text_raster_cache should hold, 0 if it is turned off
+            inline int get_text_cache_size(void) const { return text_cache_size; }
+
+            // returns true if the frame for the next second should be drawn ahead of time and swapped in right as the second starts
+            inline bool get_render_ahead(void) const { return render_ahead; }
+
             // returns an empty clock face
-            inline clock_face* get_empty_face(void) const { return empty; }
+            inline const clock_face* get_empty_face(void) const { return &empty; }
 
             // get the (BCM) pin for the buzzer sensor
             inline int get_buzzer_pin(void) const { return buzzer_pin; }
 
-            // set the (BCM) pin for the buzzer sensor
+            // set the (BCM) pin for the buzzer sensor, it is only made an output once enable_gpio() was called
             void set_buzzer_pin(int pin);
 
+            // sets who is told about every face a display switches to (null for nobody)
+            inline void set_observer(clock_observer* face_observer) { observer = face_observer; }
+
+            // lets the buzzer pin be set up, call this after wiringPiSetupGpio() (a simulation or --CHECK never calls it and
+            // only reads the pin, wiringPi exits the program when a pin is set up without it)
+            void enable_gpio(void);
+
             // sets whether the telegram integration should send a push notification when the timer completes
             inline void set_notify_on_complete(bool flag) { timer_notify_on_complete = flag; }
 
             // returns true if the bot should send a notification when the timer completes, false otherwise
             inline bool get_notify_on_timer_completion(void) const { return timer_notify_on_complete; }
     };
+
+    // config_checker class
+    //      Looks for the mistakes in a config that the clock would otherwise only run into while it is running, where most of them
+    //      are quietly worked around: unknown colors load as red, missing fonts as 6x9, unknown {variables} are shown as written,
+    //      and a display without a clock face for the time goes blank
+    //      Nothing is drawn, polled, or run, the parsed config and the clock data loaded from it are all it looks at
+    class config_checker {
+        private:
+            const Json::Value& config;
+            const matrix_data& clock_data;
+            variable_utility& util;     // tells known variables apart from unknown ones, it never has to poll anything for that
+            std::map<std::string, bool> loaded_fonts;   // font files already tried, by path
+            time_zone_set zones;        // tells a zone that cannot be read apart from a variable that does not exist
+            int errors, warnings;
+
+            // prints a problem that makes the clock show something other than what the config says
+            void report_error(const std::string& where, const std::string& problem);
+
+            // prints something that may well be on purpose, but is worth a second look
+            void report_warning(const std::string& where, const std::string& problem);
+
+            void check_color(const Json::Value& color_data, const std::string& where);
+            void check_text_line(const Json::Value& line_data, const std::string& where);
+            void check_text(const std::string& text, const std::string& where);
+            void check_time(int hour, int minute, const std::string& where);
+            void check_days(const Json::Value& days, const std::string& where);
+            void check_period(const Json::Value& period_data, const std::string& where);
+
+            // works out which face every display shows at every minute of the week, reporting gaps, overlaps, and faces never shown
+            void check_schedule(void);
+        public:
+            config_checker(const Json::Value& config, const matrix_data& clock_data, variable_utility& util);
+
+            // runs every check, printing each problem as it is found
+            void run(void);
+
+            // get the amount of errors found
+            inline int get_errors(void) const { return errors; }
+
+            // get the amount of warnings found
+            inline int get_warnings(void) const { return warnings; }
+    };
 }
 
 #endif //MATRIXCLOCK_MATRIX_CLOCK_H
\ No newline at end of file
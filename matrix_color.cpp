@@ -6,58 +6,28 @@
 // Implementation of the matrix_color class
 //
 
+#include <type_traits>
 #include "matrix_clock.h"
 
 namespace matrix_clock {
-    matrix_color::matrix_color(int red, int green, int blue) {
-        this->r = red;      // basic constructor, save values to field variables
-        this->g = green;
-        this->b = blue;
+    // colors are copied into every text line and clock face, make sure they stay plain bytes
+    static_assert(std::is_trivially_copyable<matrix_color>::value, "matrix_color must stay trivially copyable");
+    static_assert(sizeof(matrix_color) == 3, "matrix_color should only hold its rgb values");
+    static_assert(sizeof(prebuilt_color_table) / sizeof(prebuilt_color_table[0]) == night_time + 1, "every prebuilt color needs an entry in the table");
+
+    matrix_color::matrix_color(const std::string& color_name) {
+        if (!find_prebuilt(color_name, *this))
+            *this = matrix_color(red);  // unknown names have always loaded as red
     }
 
-    void matrix_color::parse_color(matrix_prebuilt_colors hardcoded_color) {
-        switch (hardcoded_color) {      // i decided on these rgb values out of personal preference
-            case red:                   // convert our enums to rgb values
-                r = 128;
-                break;
-            case orange:
-                r = 253;
-                g = 88;
-                break;
-            case yellow:
-                r = 255;
-                g = 228;
-                break;
-            case green:
-                g = 160;
-                break;
-            case blue:
-                g = 64;
-                b = 255;
-                break;
-            case purple:
-                r = b = 128;
-                break;
-            case pink:
-                r = b = 228;
-                break;
-            case white:
-                r = g = b = 255;
-                break;
-            case gray:
-                r = g = b = 128;
-                break;
-            case black:
-                r = g = b = 0;
-                break;
-            case brown:
-                r = 101;
-                g = 67;
-                b = 33;
-                break;
-            case night_time:
-                r = 128;
-                break;      // no default needed because it cannot be anything else
+    bool matrix_color::find_prebuilt(const std::string& color_name, matrix_color& color) {
+        for (const prebuilt_color_entry& entry : prebuilt_color_table) {    // only a dozen entries and only used while loading, a linear search is plenty
+            if (color_name == entry.name) {
+                color = matrix_color(entry.r, entry.g, entry.b);
+                return true;
+            }
         }
+
+        return false;
     }
-}
\ No newline at end of file
+}
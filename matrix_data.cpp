@@ -6,60 +6,321 @@
 // Implementation of the matrix_data class
 //
 
+#include <cctype>
+#include <charconv>
+#include <climits>
 #include <iostream>
 #include <fstream>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include <wiringPi.h>
 #include <jsoncpp/json/json.h>
 #include "matrix_clock.h"
 
 namespace matrix_clock {
-    matrix_data::matrix_data(std::string config_file) {
-        empty = new clock_face("~empty~", matrix_color(matrix_prebuilt_colors::black));  // create an empty clock face in the background
-        override_interface = false;
+    // variables that change every second, a clock face holding any of them is redrawn every second instead of every minute
+    // named timers run on their own clock, so any part of them can change on a second
+    static const std::vector<std::string> CLOCK_FACE_SECOND_VARIABLES = {"{second}", "{second@", "{thour:", "{tminute:", "{tsecond:", "{ftimer:", "{src_age:"};
+    static const std::vector<std::string> TIMER_FACE_SECOND_VARIABLES = {"{second}", "{second@", "{tsecond}", "{thour:", "{tminute:", "{tsecond:", "{ftimer:", "{src_age:"};
+
+    matrix_data::matrix_data(std::string config_file) : empty("~empty~", matrix_color(matrix_prebuilt_colors::black)) {  // create an empty clock face in the background
+        config.reset(new config_arena);     // start off with an empty configuration until load_clock_data() is called
+        current_faces.push_back(&empty);     // there is always at least one display, start it off empty so the current face is never null
+        overridden.push_back(false);
+        canvas_width = canvas_height = 0;
+        timer_display = 0;
+        skip_seconds = 0;
         force_update = false;
         timer_notify_on_complete = false;
         clock_on = true;
         timer_hold = 300;
         timer_blink = false;
+        centisecond_rate = 50;
+        text_cache_size = 128;
+        render_ahead = true;
+        buzzer_pin = -1;
+        gpio_enabled = false;
+        observer = nullptr;
+        stream_port = 0;
+        stream_bind = "127.0.0.1";
+        stats_interval = 60;
+        weather_cache_ttl = 180;
+        idle_weather_interval = 60;
+        wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
         this->config_file = config_file;
     }
 
+    matrix_data::~matrix_data() {
+        if (wake_fd != -1)
+            close(wake_fd);
+    }
+
+    // compares a name from the config arena with one given by the user, ignoring case
+    static bool same_name(std::string_view name, const std::string& other) {
+        return name.size() == other.size() && !strncasecmp(name.data(), other.c_str(), name.size());
+    }
+
+    // adds up the size of every string in the json value, the interned text of a config can never be longer than this
+    static std::size_t count_text_bytes(const Json::Value& value) {
+        if (value.isString())
+            return value.asString().size();
+
+        std::size_t total = 0;
+
+        if (value.isArray() || value.isObject()) {
+            for (Json::Value::const_iterator iter = value.begin(); iter != value.end(); iter++)
+                total += count_text_bytes(*iter);
+        }
+
+        return total;
+    }
+
+    // returns the index of the display with the given name, or 0 (the first display) with a warning if there is none
+    static int find_display(const std::vector<display_region>& displays, std::string name) {
+        if (name.empty())
+            return 0;   // clock faces without a display go on the first one
+
+        for (size_t i = 0; i < displays.size(); i++) {
+            if (!strcasecmp(displays[i].get_name().c_str(), name.c_str()))
+                return i;
+        }
+
+        std::cout << "Could not find display " << name << ", using the first display (" << displays[0].get_name() << ") instead." << std::endl;
+        return 0;
+    }
+
+    // read the color of a text line or background, either a prebuilt color name or "none" with RGB values
+    static matrix_color parse_color(const Json::Value& color_data) {
+        if (color_data["built_in_color"].asString() == "none") {    // if a prebuilt color is NOT USED (denoted "none" in config), load in RGB values
+            return matrix_color(color_data["r"].asInt(), color_data["g"].asInt(), color_data["b"].asInt());
+        } else {                                                     // a prebuilt color is used, read it in from string
+            return matrix_color(color_data["built_in_color"].asString());
+        }
+    }
+
+    // adds up the length of every visible_if expression of the text lines, the most ops they can compile into
+    static std::size_t count_condition_length(const Json::Value& text_lines) {
+        std::size_t total = 0;
+
+        for (Json::Value::ArrayIndex text_index = 0; text_index != text_lines.size(); text_index++)
+            total += text_lines[text_index]["visible_if"].asString().size();
+
+        return total;
+    }
+
+    // loads the text lines of a clock face into the arena and points the clock face at them
+    // the face is told it contains seconds if any line contains one of the given second variables
+    // or decides whether it is shown by something that can change on any second
+    static void load_text_lines(config_arena& arena, const Json::Value& text_lines, const std::string& fonts_folder,
+                                const std::vector<std::string>& second_variables, clock_face& face) {
+        std::size_t first_line = arena.get_line_count();
+
+        for (Json::Value::ArrayIndex text_index = 0; text_index != text_lines.size(); text_index++) {
+            const Json::Value& text_data = text_lines[text_index];
+
+            matrix_clock::matrix_color color = parse_color(text_data["color"]);
+            matrix_clock::matrix_font font_size(fonts_folder, arena.intern(text_data["font_size"].asString())); // grab matrix_font size, positioning, and text
+            int x_pos = text_data["x_position"].asInt();
+            int y_pos = text_data["y_position"].asInt();
+            std::string text = text_data["text"].asString();
+
+            for (const std::string& variable : second_variables) {
+                if (text.find(variable) != std::string::npos)         // if there is a second in the variables, let the clock face know
+                    face.set_contains_second_variable(true);          // in this scenario we need to update the screen secondly instead of minutely
+            }
+
+            if (text.find("{tcenti") != std::string::npos)           // {tcenti} and {tcenti:name}
+                face.set_contains_centisecond_variable(true);
+
+            matrix_clock::text_line line(color, font_size, x_pos, y_pos, arena.intern(text));
+
+            if (text_data.isMember("visible_if")) {     // compiled once here, every frame only runs the compiled program
+                line.set_visible_if(arena.add_condition(text_data["visible_if"].asString()));
+
+                if (line_condition::uses(line.get_visible_if(), line_condition::second) || line_condition::uses(line.get_visible_if(), line_condition::timer_running))
+                    face.set_contains_second_variable(true);
+            }
+
+            arena.add_line(line);   // lines of one face sit next to each other in the arena
+        }
+
+        face.set_text_lines(arena.lines_since(first_line));
+    }
+
+    // reads the condition codes an icon rule covers, either one code ("800"), a range ("801-804"), a whole group ("2xx"),
+    // or "default" for every code, returns false if the key is none of those
+    static bool parse_condition_range(const std::string& key, int& low, int& high) {
+        if (!strcasecmp(key.c_str(), "default")) {
+            low = 0;
+            high = INT_MAX;     // the widest rule there is, so any other rule covering the code wins over it
+            return true;
+        }
+
+        if (key.size() == 3 && std::isdigit((unsigned char) key[0]) && key[1] == 'x' && key[2] == 'x') {
+            low = (key[0] - '0') * 100;
+            high = low + 99;
+            return true;
+        }
+
+        const char* start = key.c_str();
+        const char* end = start + key.size();
+        std::from_chars_result result = std::from_chars(start, end, low);
+
+        if (result.ec != std::errc() || result.ptr == start)
+            return false;
+
+        high = low;
+
+        if (result.ptr != end) {
+            if (*result.ptr != '-')
+                return false;
+
+            const char* second = result.ptr + 1;
+            result = std::from_chars(second, end, high);
+
+            if (result.ec != std::errc() || result.ptr != end || high < low)
+                return false;
+        }
+
+        return true;
+    }
+
+    // loads the weather icons of a clock face into the arena and points the clock face at them
+    // every sprite is decoded here, drawing an icon later never touches the disk
+    static void load_weather_icons(config_arena& arena, const Json::Value& icons_data, clock_face& face) {
+        std::size_t first_icon = arena.get_icon_count();
+
+        for (Json::Value::ArrayIndex icon_index = 0; icon_index != icons_data.size(); icon_index++) {
+            const Json::Value& icon_data = icons_data[icon_index];
+            const Json::Value& rules_data = icon_data["icons"];
+            std::size_t first_rule = arena.get_icon_rule_count();
+
+            for (Json::Value::const_iterator iter = rules_data.begin(); iter != rules_data.end(); iter++) {
+                int low, high;
+
+                if (!parse_condition_range(iter.name(), low, high)) {
+                    std::cerr << "Skipping weather icon " << iter.name() << ", it is not a condition code, range, or default." << std::endl;
+                    continue;
+                }
+
+                const sprite* image = arena.add_sprite(iter->asString());
+
+                if (image != nullptr)   // a file that could not be decoded leaves its conditions without an icon
+                    arena.add_icon_rule({low, high, image});
+            }
+
+            // icons are placed like text lines, except y is the top of the sprite rather than its baseline
+            arena.add_icon(weather_icon(icon_data["x_position"].asInt(), icon_data["y_position"].asInt(), arena.icon_rules_since(first_rule)));
+        }
+
+        face.set_weather_icons(arena.icons_since(first_icon));
+    }
+
     void matrix_data::update_clock_face(std::string name) {
-        for (size_t i = 0; i < clock_faces.size(); i++) {      // loop through all clock faces
-            if (!strcasecmp(clock_faces.data()[i]->get_name().c_str(), name.c_str())) {  // if we find one with a matching name, return it (case insensitive)
-                current = clock_faces.data()[i];                                                // use !strcasecmp because it returns 0 if they are equal
+        std::lock_guard<std::mutex> lock(state_lock);
+        std::shared_ptr<const config_arena> arena = get_config();
+
+        for (const clock_face& face : arena->get_faces()) {      // loop through all clock faces
+            if (same_name(face.get_name(), name)) {  // if we find one with a matching name, return it (case insensitive)
+                int display = face.get_display();
+                show_face(display, &face);
+                overridden[display] = true;     // keep it on screen until the override is cleared
                 return;
             }
         }
 
-        current = empty;       // set it to empty if not found
+        show_face(0, &empty);       // set it to empty if not found
+        overridden[0] = true;
+    }
+
+    void matrix_data::show_face(std::size_t display, const clock_face* face) {
+        if (observer != nullptr && current_faces[display] != face)
+            observer->face_changed(display, current_faces[display], face);
+
+        current_faces[display] = face;
     }
 
     void matrix_data::update_clock_face(int hour, int minute, int day_of_week) {
-        for (size_t index = 0; index < get_clock_face_count(); index++) {   // loop through all clock faces
-            // grab the time periods for the current time period
-            std::vector<matrix_clock::time_period> time_periods = clock_faces.data()[index]->get_time_periods();
-
-            // loop through all time periods (THERE CAN BE MORE THAN ONE)
-            for (size_t j = 0; j < time_periods.size(); j++) {
-                matrix_clock::time_period current_period = time_periods.data()[j];
-
-                // check if the current time is within this time period and on the given day
-                if (current_period.in_time_period(hour, minute, day_of_week)) {
-                    current = clock_faces.data()[index];
-                    return; // return if found
-                }   // otherwise, loop again until we find it
+        std::lock_guard<std::mutex> lock(state_lock);
+        std::shared_ptr<const config_arena> arena = get_config();
+
+        for (size_t display = 0; display < current_faces.size(); display++) {  // every display picks its own face
+            if (overridden[display])
+                continue;   // overridden displays do not change with time
+
+            const clock_face* next_face = &empty;     // empty unless we find a face for this time below
+
+            for (const clock_face& face : arena->get_faces()) {   // loop through all clock faces
+                if (face.get_display() != (int) display)
+                    continue;   // this face belongs to a different display
+
+                bool found = false;
+
+                // loop through all time periods (THERE CAN BE MORE THAN ONE)
+                for (const matrix_clock::time_period& current_period : face.get_time_periods()) {
+                    // check if the current time is within this time period and on the given day
+                    if (current_period.in_time_period(hour, minute, day_of_week)) {
+                        next_face = &face;
+                        found = true;
+                        break;
+                    }   // otherwise, loop again until we find it
+                }
+
+                if (found)
+                    break;
             }
+
+            show_face(display, next_face);
         }
+    }
+
+    void matrix_data::copy_state(face_state& state) const {
+        std::lock_guard<std::mutex> lock(state_lock);
+
+        state.config = get_config();
+        state.displays = displays;  // copied into the displays already there, their names keep their memory
+        state.faces.assign(current_faces.begin(), current_faces.end());
+    }
 
-        current = empty;
+    bool matrix_data::clock_face_overridden(void) const {
+        std::lock_guard<std::mutex> lock(state_lock);
+        return std::find(overridden.begin(), overridden.end(), true) != overridden.end();
     }
 
-    std::string* matrix_data::get_names(void) const {
-        std::string* names_array = new std::string[get_clock_face_count()];  // create a new array with a length of the clock face count
+    void matrix_data::clear_clock_face_overrides(void) {
+        std::lock_guard<std::mutex> lock(state_lock);
+        overridden.assign(overridden.size(), false);
+    }
+
+    std::vector<std::string> matrix_data::get_font_sizes(void) const {
+        std::vector<std::string> sizes;
+        std::shared_ptr<const config_arena> arena = get_config();
+
+        // the timer face is not in the list of clock faces, go through it as well
+        std::vector<const clock_face*> faces = {arena->get_timer_face()};
+
+        for (const clock_face& face : arena->get_faces())
+            faces.push_back(&face);
+
+        for (const clock_face* face : faces) {
+            for (int i = 0; i < face->get_line_count(); i++) {
+                std::string size(face->get_line(i).get_font().get_font());
+
+                if (std::find(sizes.begin(), sizes.end(), size) == sizes.end())
+                    sizes.push_back(size);
+            }
+        }
+
+        return sizes;
+    }
 
-        for (size_t i = 0; i < get_clock_face_count(); i++) {    // iterate through each clock face
-            std::string name = clock_faces.data()[i]->get_name();    // grab the name of the clock face
+    std::vector<std::string> matrix_data::get_names(void) const {
+        std::shared_ptr<const config_arena> arena = get_config();
+        std::vector<std::string> names_array(arena->get_faces().size());  // one name for every clock face
+
+        for (size_t i = 0; i < names_array.size(); i++) {    // iterate through each clock face
+            std::string name(arena->get_faces()[i].get_name());    // grab the name of the clock face
 
             for (size_t j = 0; j < name.size(); j++) {  // iterate through each character
                 if (j == 0)
@@ -75,45 +336,38 @@ namespace matrix_clock {
     }
 
     bool matrix_data::load_clock_data() {
-        // clear the current clock faces if they exist
-
-        for (matrix_clock::clock_face* current_face : clock_faces) {    // delete all old clock faces
-            delete current_face;
-        }
+        Json::Value jsonData;   // full json from the config file
+        JSONCPP_STRING error;
+        std::ifstream file_stream(config_file); // grab the matrix_config file
 
-        clock_faces.clear();    // ensure it is empty
+        Json::CharReaderBuilder builder;    // json value reader
 
-        for (telegram_push* current_push : push_notifications) {        // do the same thing with push notifications
-            delete current_push;
+        if (!parseFromStream(builder, file_stream, &jsonData, &error)) {
+            file_stream.close();    // close file
+            std::cerr << "Invalid JSON file provided." << std::endl;
+            return false;           // if the config file could not be parsed, return and the main program will kill the application
         }
 
-        push_notifications.clear();
-
-        current = empty;        // set the current clock face to the empty one temporarily so it is never null
+        file_stream.close();    // file is valid and data has been loaded, close the file and begin parsing
+        return load_clock_data(jsonData);
+    }
 
-        // LOADING NEW DATA BELOW
+    bool matrix_data::load_clock_data(const Json::Value& jsonData) {
+        // everything is loaded into a new arena first, the current configuration stays untouched until the new one is complete
 
         try {   // attempt to load data
-            Json::Value jsonData;   // full json from the config file
-            JSONCPP_STRING error;
-            std::ifstream file_stream(config_file); // grab the matrix_config file
-
-            Json::CharReaderBuilder builder;    // json value reader
-
-            if (!parseFromStream(builder, file_stream, &jsonData, &error)) {
-                file_stream.close();    // close file
-                std::cerr << "Invalid JSON file provided." << std::endl;
-                return false;           // if the config file could not be parsed, return and the main program will kill the application
-            }
-
-            file_stream.close();    // file is valid and data has been loaded, close the file and begin parsing
-
             // clock data value, this is where the weather URL and the bot tokens are stored
             Json::Value clock_data = jsonData["clock_data"];
 
             // grab weather URL from the config file
             weather_url = clock_data["weather_url"].asString();
 
+            // grab where the weather comes from and where the last good weather is kept, the cache is optional and disabled when left out
+            weather_provider_name = clock_data.get("weather_provider", "openweathermap").asString();
+            weather_file = clock_data["weather_file"].asString();
+            weather_cache = clock_data["weather_cache"].asString();
+            weather_cache_ttl = clock_data.get("weather_cache_ttl", 180).asInt();
+
             // grab bot token from config file
             bot_token = clock_data["bot_token"].asString();
 
@@ -124,164 +378,243 @@ namespace matrix_clock {
             // load the folder the fonts are stored in from file
             fonts_folder = clock_data["fonts_folder"].asString();
 
-            for (Json::Value::ArrayIndex face_index = 0; face_index != jsonData["clock_faces"].size(); face_index++) {  // loop through ALL clock face declared in the file
-                Json::Value clock_face_data = jsonData["clock_faces"][face_index];
-                std::string name = clock_face_data["name"].asString();
+            // load the displays the matrix is split into, if there are none the whole matrix is one display
+            Json::Value display_data = jsonData["matrix_options"]["displays"];
+            std::vector<display_region> new_displays;
 
-                matrix_clock::matrix_color bg_color;
+            for (Json::Value::ArrayIndex display_index = 0; display_index != display_data.size(); display_index++) {
+                int x = display_data[display_index]["x"].asInt();
+                int y = display_data[display_index]["y"].asInt();
+                int width = display_data[display_index]["width"].asInt();
+                int height = display_data[display_index]["height"].asInt();
 
-                if (clock_face_data["bg_color"]["built_in_color"].asString() == "none") {    // if a prebuilt color is NOT USED (denoted "none" in config), load in RGB values
-                    int red = clock_face_data["bg_color"]["r"].asInt();
-                    int green = clock_face_data["bg_color"]["g"].asInt();
-                    int blue = clock_face_data["bg_color"]["b"].asInt();
+                if (width <= 0) width = canvas_width - x;      // no size given, use the rest of the matrix
+                if (height <= 0) height = canvas_height - y;
 
-                    bg_color = matrix_clock::matrix_color(red, green, blue);
-                } else {                                                            // a prebuilt color is used, read it in from string
-                    std::string prebuilt_color_name = clock_face_data["bg_color"]["built_in_color"].asString();
-                    bg_color = matrix_clock::matrix_color(prebuilt_color_name);
-                }
+                new_displays.push_back(display_region(display_data[display_index]["name"].asString(), x, y, width, height));
+            }
 
-                // create a new clock face at the current index with the given name and background color
-                matrix_clock::clock_face* config_clock_face = new matrix_clock::clock_face(name, bg_color);
+            if (new_displays.empty())
+                new_displays.push_back(display_region("main", 0, 0, canvas_width, canvas_height));
 
-                // loop through ALL time periods within the current interface
-                for (Json::Value::ArrayIndex times_index = 0; times_index != clock_face_data["time_periods"].size(); times_index++) {
-                    Json::Value time_data = clock_face_data["time_periods"][times_index];
+            // load where the live frame stream should be published, both are optional and disabled when left out
+            stream_socket = clock_data["stream_socket"].asString();
+            stream_port = clock_data["stream_port"].asInt();
+            stream_bind = clock_data.get("stream_bind", "127.0.0.1").asString();     // the stream is not authenticated, keep it local by default
 
-                    int start_hour = time_data["start_hour"].asInt();       // grab fields from the time periods section of the clock face
-                    int start_minute = time_data["start_minute"].asInt();
-                    int end_hour = time_data["end_hour"].asInt();
-                    int end_minute = time_data["end_minute"].asInt();
+            // load how many lines of text are kept drawn, the default fits every minute, day and month name, and plenty of weather
+            text_cache_size = std::clamp(clock_data.get("text_cache", 128).asInt(), 0, 4096);
 
-                    // instantiate a new time period and add it to the clock face
-                    matrix_clock::time_period clock_face_time_period(start_hour, start_minute, end_hour, end_minute);
+            // load whether the next second is drawn ahead of time, it only costs a render done a little earlier
+            render_ahead = clock_data.get("render_ahead", true).asBool();
 
-                    // loop through the days of the week array and add it to the vector
-                    for (Json::Value::ArrayIndex days_index = 0; days_index != time_data["days_of_week"].size(); days_index++) {
-                        clock_face_time_period.add_day(time_data["days_of_week"][days_index].asInt());
-                    }
+            // load where memory stats are written to and how often, the file is optional and disabled when left out
+            stats_file = clock_data["stats_file"].asString();
+            stats_interval = clock_data.isMember("stats_interval") ? clock_data["stats_interval"].asInt() : 60;
 
-                    config_clock_face->add_time_period(clock_face_time_period); // add the time frame to the clock face object
-                }
+            // load when the clock turns itself off, and how often the weather is still polled while it is off
+            const Json::Value& off_data = clock_data["off_periods"];
+            std::vector<time_period> new_off_periods;
 
-                // now we are going to loop through all text lines
-                for (Json::Value::ArrayIndex text_index = 0; text_index != clock_face_data["text_lines"].size(); text_index++) {
-                    Json::Value text_data = clock_face_data["text_lines"][text_index];
+            for (Json::Value::ArrayIndex off_index = 0; off_index != off_data.size(); off_index++) {
+                const Json::Value& period_data = off_data[off_index];
+                time_period period(period_data["start_hour"].asInt(), period_data["start_minute"].asInt(), period_data["end_hour"].asInt(), period_data["end_minute"].asInt());
 
-                    matrix_clock::matrix_color color;       // color variable that will be filled in a minute
+                for (Json::Value::ArrayIndex days_index = 0; days_index != period_data["days_of_week"].size(); days_index++)
+                    period.add_day(period_data["days_of_week"][days_index].asInt());
 
-                    if (text_data["color"]["built_in_color"].asString() == "none") {    // if a prebuilt color is NOT USED (denoted "none" in config), load in RGB values
-                        int red = text_data["color"]["r"].asInt();
-                        int green = text_data["color"]["g"].asInt();
-                        int blue = text_data["color"]["b"].asInt();
+                new_off_periods.push_back(period);
+            }
 
-                        color = matrix_clock::matrix_color(red, green, blue);
-                    } else {                                                            // a prebuilt color is used, read it in from string
-                        std::string prebuilt_color_name = text_data["color"]["built_in_color"].asString();
-                        color = matrix_clock::matrix_color(prebuilt_color_name);
-                    }
+            idle_weather_interval = std::max(clock_data.get("idle_weather_interval", 60).asInt(), 0);
 
-                    matrix_clock::matrix_font font_size(fonts_folder, text_data["font_size"].asString()); // grab matrix_font size, positioning, and text
-                    int x_pos = text_data["x_position"].asInt();
-                    int y_pos = text_data["y_position"].asInt();
-                    std::string text = text_data["text"].asString();
+            // load the variable sources shown by {src:name}, each one either reads a file or runs a command
+            const Json::Value& sources_data = jsonData["variable_sources"];
+            variable_sources.clear();
 
-                    if (text.find("{second}") != std::string::npos)         // if there is a second in the variables, let the clock face know
-                        config_clock_face->set_contains_second_variable(true);      // in this scenario we need to update the screen secondly instead of minutely
+            for (Json::Value::ArrayIndex source_index = 0; source_index != sources_data.size(); source_index++) {
+                const Json::Value& source_data = sources_data[source_index];
+                variable_source source;
 
-                    matrix_clock::text_line clock_face_text_line(color, font_size, x_pos, y_pos, text); // instantiate the text line object
+                source.name = source_data["name"].asString();
+                source.command = source_data.isMember("command");
+                source.path = source.command ? source_data["command"].asString() : source_data["file"].asString();
+                source.interval = std::max(source_data.get("interval", 60).asInt(), 1);
+                source.timeout = std::max(source_data.get("timeout", 5).asInt(), 1);
 
-                    config_clock_face->add_text(clock_face_text_line);      // add the text line to the current clock face
+                // the name ends up inside {src:name}, so it cannot hold anything that would end the variable early
+                if (source.name.empty() || source.name.find_first_of("{}:") != std::string::npos || source.path.empty()) {
+                    std::cerr << "Skipping variable source " << source_index << ", it needs a name and a file or command." << std::endl;
+                    continue;
                 }
 
-                add_clock_face(config_clock_face);        // add the clock face to the container
+                variable_sources.push_back(source);
             }
 
-            // time to load all the timer data
-            Json::Value timer_data = jsonData["timer"];
+            const Json::Value& faces_data = jsonData["clock_faces"];
+            const Json::Value& timer_data = jsonData["timer"];
+            const Json::Value& notifications = jsonData["telegram_notifications"];
 
-            set_timer_hold(timer_data["display_time_while_ended"].asInt());
-            set_timer_blink(timer_data["blink"].asBool());
-            set_buzzer_pin(timer_data["buzzer_pin"].asInt());
-            set_notify_on_complete(timer_data["notify_on_complete"].asBool());
+            // count everything up front so the arena can be allocated once and nothing moves while it is filled
+            std::size_t line_count = timer_data["text_lines"].size(), period_count = 0, icon_count = 0, rule_count = 0;
+            std::size_t condition_length = count_condition_length(timer_data["text_lines"]);
 
-            matrix_clock::matrix_color bg_color;
+            for (Json::Value::ArrayIndex face_index = 0; face_index != faces_data.size(); face_index++) {
+                const Json::Value& icons_data = faces_data[face_index]["weather_icons"];
 
-            if (timer_data["bg_color"]["built_in_color"].asString() == "none") {    // if a prebuilt color is NOT USED (denoted "none" in config), load in RGB values
-                int red = timer_data["bg_color"]["r"].asInt();
-                int green = timer_data["bg_color"]["g"].asInt();
-                int blue = timer_data["bg_color"]["b"].asInt();
+                line_count += faces_data[face_index]["text_lines"].size();
+                condition_length += count_condition_length(faces_data[face_index]["text_lines"]);
+                period_count += faces_data[face_index]["time_periods"].size();
+                icon_count += icons_data.size();
 
-                bg_color = matrix_clock::matrix_color(red, green, blue);
-            } else {                                                            // a prebuilt color is used, read it in from string
-                std::string prebuilt_color_name = timer_data["bg_color"]["built_in_color"].asString();
-                bg_color = matrix_clock::matrix_color(prebuilt_color_name);
+                for (Json::Value::ArrayIndex icon_index = 0; icon_index != icons_data.size(); icon_index++)
+                    rule_count += icons_data[icon_index]["icons"].size();
             }
 
-            // create the timer clock face
+            std::unique_ptr<config_arena> arena(new config_arena);
+            arena->reserve(count_text_bytes(jsonData), faces_data.size(), line_count, period_count, notifications.size(), icon_count, rule_count, condition_length);
 
-            matrix_clock::clock_face* clock_timer_face = new matrix_clock::clock_face("timer", bg_color);
+            for (Json::Value::ArrayIndex face_index = 0; face_index != faces_data.size(); face_index++) {  // loop through ALL clock face declared in the file
+                const Json::Value& clock_face_data = faces_data[face_index];
+                std::string_view name = arena->intern(clock_face_data["name"].asString());
 
-            for (Json::Value::ArrayIndex text_index = 0; text_index != timer_data["text_lines"].size(); text_index++) {
-                Json::Value text_data = timer_data["text_lines"][text_index];
+                matrix_clock::matrix_color bg_color = parse_color(clock_face_data["bg_color"]);
 
-                matrix_clock::matrix_color color;       // color variable that will be filled in a minute
+                // create a new clock face at the current index with the given name and background color
+                matrix_clock::clock_face& config_clock_face = arena->add_face(matrix_clock::clock_face(name, bg_color));
+                config_clock_face.set_display(find_display(new_displays, clock_face_data["display"].asString()));
 
-                if (text_data["color"]["built_in_color"].asString() == "none") {    // if a prebuilt color is NOT USED (denoted "none" in config), load in RGB values
-                    int red = text_data["color"]["r"].asInt();
-                    int green = text_data["color"]["g"].asInt();
-                    int blue = text_data["color"]["b"].asInt();
+                std::size_t first_period = arena->get_period_count();
 
-                    color = matrix_clock::matrix_color(red, green, blue);
-                } else {                                                            // a prebuilt color is used, read it in from string
-                    std::string prebuilt_color_name = text_data["color"]["built_in_color"].asString();
-                    color = matrix_clock::matrix_color(prebuilt_color_name);
-                }
+                // loop through ALL time periods within the current interface
+                for (Json::Value::ArrayIndex times_index = 0; times_index != clock_face_data["time_periods"].size(); times_index++) {
+                    const Json::Value& time_data = clock_face_data["time_periods"][times_index];
 
-                matrix_clock::matrix_font font_size(fonts_folder, text_data["font_size"].asString()); // grab matrix_font size, positioning, and text
-                int x_pos = text_data["x_position"].asInt();
-                int y_pos = text_data["y_position"].asInt();
-                std::string text = text_data["text"].asString();
+                    int start_hour = time_data["start_hour"].asInt();       // grab fields from the time periods section of the clock face
+                    int start_minute = time_data["start_minute"].asInt();
+                    int end_hour = time_data["end_hour"].asInt();
+                    int end_minute = time_data["end_minute"].asInt();
 
-                if (text.find("{second}") != std::string::npos || text.find("{tsecond}") != std::string::npos)         // if there is a second in the variables, let the clock face know
-                    clock_timer_face->set_contains_second_variable(true);      // in this scenario we need to update the screen secondly instead of minutely
+                    // instantiate a new time period and add it to the clock face
+                    matrix_clock::time_period clock_face_time_period(start_hour, start_minute, end_hour, end_minute);
 
-                matrix_clock::text_line clock_face_text_line(color, font_size, x_pos, y_pos, text); // instantiate the text line object
+                    // loop through the days of the week array and add it to the vector
+                    for (Json::Value::ArrayIndex days_index = 0; days_index != time_data["days_of_week"].size(); days_index++) {
+                        clock_face_time_period.add_day(time_data["days_of_week"][days_index].asInt());
+                    }
 
-                clock_timer_face->add_text(clock_face_text_line);      // add the text line to the current clock face
+                    arena->add_period(clock_face_time_period); // time periods of one face sit next to each other in the arena
+                }
+
+                config_clock_face.set_time_periods(arena->periods_since(first_period));
+
+                // now we are going to load all text lines
+                load_text_lines(*arena, clock_face_data["text_lines"], fonts_folder, CLOCK_FACE_SECOND_VARIABLES, config_clock_face);
+
+                // and the weather icons drawn on top of them
+                load_weather_icons(*arena, clock_face_data["weather_icons"], config_clock_face);
             }
 
-            set_timer_face(clock_timer_face);        // add the clock face to the container
+            // time to load all the timer data
+            set_timer_hold(timer_data["display_time_while_ended"].asInt());
+            set_timer_blink(timer_data["blink"].asBool());
+            centisecond_rate = std::clamp(timer_data.get("centisecond_rate", 50).asInt(), 1, 100);   // past 100 a second there is nothing new to show
+            set_buzzer_pin(timer_data["buzzer_pin"].asInt());
+            set_notify_on_complete(timer_data["notify_on_complete"].asBool());
+            timer_display = find_display(new_displays, timer_data["display"].asString());
 
-            // now we are going to read the telegram notifications box from the config file
-            Json::Value notifications = jsonData["telegram_notifications"];
+            // create the timer clock face
+            matrix_clock::clock_face clock_timer_face("timer", parse_color(timer_data["bg_color"]));
+            clock_timer_face.set_display(timer_display);
+
+            load_text_lines(*arena, timer_data["text_lines"], fonts_folder, TIMER_FACE_SECOND_VARIABLES, clock_timer_face);
+            arena->set_timer_face(clock_timer_face);
 
+            // now we are going to read the telegram notifications box from the config file
             for (Json::Value::ArrayIndex noti_index = 0; noti_index != notifications.size(); noti_index++) {
-                std::string message = notifications[noti_index]["message"].asString();  // read the message, hour, and minute
+                std::string_view message = arena->intern(notifications[noti_index]["message"].asString());  // read the message, hour, and minute
                 int hour = notifications[noti_index]["hour"].asInt();
                 int minute = notifications[noti_index]["minute"].asInt();
 
-                std::vector<int> days;
+                std::uint8_t days = 0;
 
-                // loop through the days of the week array and add it to the vector
+                // loop through the days of the week array and add them to the mask
                 for (Json::Value::ArrayIndex days_index = 0; days_index != notifications[noti_index]["days_of_week"].size(); days_index++) {
-                    days.push_back(notifications[noti_index]["days_of_week"][days_index].asInt());
+                    int day = notifications[noti_index]["days_of_week"][days_index].asInt();
+
+                    if (day >= 0 && day < 7)
+                        days |= 1 << day;
                 }
 
-                telegram_push* push_notification = new telegram_push(message, hour, minute, days);
-                add_notification(push_notification);        // create the new object and push back
+                arena->add_notification(telegram_push(message, hour, minute, days));
             }
 
+            // the new configuration is complete, swap it in
+            // the render thread holds on to the arena it is drawing from, so the old one is freed right here if nothing is drawing
+            // from it, or by the render thread once it is done with it
+            std::lock_guard<std::mutex> lock(state_lock);
+            displays = new_displays;
+            off_periods = new_off_periods;
+            current_faces.assign(displays.size(), &empty);
+            overridden.assign(displays.size(), false);  // the overridden faces belonged to the old configuration, go back to following the time
+            std::atomic_store(&config, std::shared_ptr<const config_arena>(std::move(arena)));
+
             return true;        // Return true because we successfully parsed the file
-        } catch (const Json::Exception& exception) {    // if data could not be loaded, return false so main kills the program - we need valid data to be able to load the clock faces
+        } catch (const std::exception& exception) {    // if data could not be loaded, return false so main kills the program - we need valid data to be able to load the clock faces
             std::cerr << "Could not parse JSON values: " << exception.what() << std::endl;  // print out the error to help the user find their error
             return false;
         }
     }
 
+    void matrix_data::set_clock_on(bool on) {
+        clock_on = on;
+
+        if (on && wake_fd != -1) {
+            std::uint64_t one = 1;
+
+            if (write(wake_fd, &one, sizeof(one)) != sizeof(one))
+                return;     // the counter is already full, so a wake up is pending anyways
+        }
+    }
+
+    bool matrix_data::wait_for_clock_on(int timeout_ms) {
+        if (clock_on || wake_fd == -1)
+            return clock_on;
+
+        // the eventfd keeps counting until it is read, so turning the clock on right before this poll still wakes it up
+        pollfd wake = {wake_fd, POLLIN, 0};
+
+        if (poll(&wake, 1, std::max(timeout_ms, 0)) > 0) {
+            std::uint64_t count;
+
+            if (read(wake_fd, &count, sizeof(count)) != sizeof(count))
+                return clock_on;
+        }
+
+        return clock_on;
+    }
+
+    bool matrix_data::in_off_period(int hour, int minute, int day_of_week) const {
+        std::lock_guard<std::mutex> lock(state_lock);
+
+        for (const time_period& period : off_periods) {
+            if (period.in_time_period(hour, minute, day_of_week))
+                return true;
+        }
+
+        return false;
+    }
+
     void matrix_data::set_buzzer_pin(int pin) {
         buzzer_pin = pin;
-        pinMode(buzzer_pin, OUTPUT);
+
+        if (gpio_enabled && buzzer_pin != -1)
+            pinMode(buzzer_pin, OUTPUT);
+    }
+
+    void matrix_data::enable_gpio(void) {
+        gpio_enabled = true;
+        set_buzzer_pin(buzzer_pin);     // set up a pin that was already loaded
     }
 
     bool matrix_data::skip_second(void) {
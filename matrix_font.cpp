@@ -25,23 +25,29 @@ namespace matrix_clock {
             default:
                 font_size = "6x9";      break;
         }
-    }
 
-    int matrix_font::get_x() const {
-        return std::stoi(font_size.substr(0, font_size.find("x"))); // find the x value in the string by taking the substring of the beginning to anything before the 'x'
+        char_width = font_size[0] - '0';    // every built in font is a single digit wide
     }
 
-    void matrix_font::parse_font(std::string font_folder, std::string font) {
+    std::string_view matrix_font::resolve_name(std::string_view font) {
         if (font == "small") {      // check out prebuilt fonts first, these we do not need to parse because we know them to be correct
-            font_size = "5x8";
+            return "5x8";
         } else if (font == "medium") {
-            font_size = "6x9";
+            return "6x9";
         } else if (font == "large") {
-            font_size = "8x13";
+            return "8x13";
         } else if (font == "large_bold") {
-            font_size = "8x13B";
-        } else {
-            std::ifstream stream(get_font_file(font_folder, font));      // otherwise it is a custom one, check if the file is valid and set to a default value if not
+            return "8x13B";
+        }
+
+        return font;
+    }
+
+    void matrix_font::parse_font(std::string font_folder, std::string_view font) {
+        font_size = resolve_name(font);
+
+        if (font_size == font) {
+            std::ifstream stream(get_font_file(font_folder, font));      // not a prebuilt font, check if the file is valid and set to a default value if not
             if (!stream.good()) {
                 std::cout << "Could not find font " << font << ", loading medium font (6x9.bdf) instead." << std::endl;
                 this->font_size = "6x9";
@@ -49,9 +55,20 @@ namespace matrix_clock {
                 this->font_size = font;     // valid font, we can use it with no change necessary
             }
         }
+
+        // find the width in the name by reading the number before the 'x', this is done once here instead of on every frame
+        char_width = 0;
+
+        for (std::size_t i = 0; i < font_size.size() && font_size[i] >= '0' && font_size[i] <= '9'; i++)
+            char_width = (char_width * 10) + (font_size[i] - '0');
+
+        if (char_width == 0) {
+            std::cout << "Could not read the character width of font " << font_size << ", assuming 6 pixels." << std::endl;
+            char_width = 6;
+        }
     }
 
-    std::string matrix_font::get_font_file(std::string font_folder, std::string font_size) {
+    std::string matrix_font::get_font_file(std::string font_folder, std::string_view font_size) {
         std::stringstream file_builder;
         file_builder << font_folder << "/" << font_size << ".bdf"; // build the font path using a stringstream and return it
         return file_builder.str();
@@ -0,0 +1,89 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// matrix_stream.h
+//      Holds the live frame streaming sink and the wire format it speaks
+//
+
+#ifndef MATRIXCLOCK_MATRIX_STREAM_H
+#define MATRIXCLOCK_MATRIX_STREAM_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "matrix_clock.h"
+
+namespace matrix_stream {
+    // WIRE FORMAT
+    //      Every frame is a 12 byte header followed by a payload, all numbers are little endian
+    //          bytes 0-1:  'M' 'C' magic
+    //          byte 2:     frame type, FRAME_KEY (clear to black before applying) or FRAME_DELTA (apply on top of the last frame)
+    //          byte 3:     reserved (0)
+    //          bytes 4-5:  width in pixels
+    //          bytes 6-7:  height in pixels
+    //          bytes 8-11: payload length in bytes
+    //      The payload is a list of spans, each one being
+    //          u32 offset of the first pixel (y * width + x)
+    //          u32 amount of pixels in the span
+    //          runs of [u8 count][u8 red][u8 green][u8 blue] until the span is covered
+    //      A key frame is sent when a viewer connects, everything afterwards only contains the pixels that changed
+    const std::uint8_t FRAME_KEY = 'K';
+    const std::uint8_t FRAME_DELTA = 'D';
+    const std::size_t HEADER_SIZE = 12;
+
+    // frame_stream class
+    //      A frame sink that publishes every changed frame to viewers connected over a unix socket and/or a tcp port
+    //      The render thread only hands over a shared pointer to the frame, encoding and sending is done on the stream's own thread
+    class frame_stream : public matrix_clock::frame_sink {
+        private:
+            std::string socket_path;
+            std::string bind_address;
+            int tcp_port;
+            int unix_fd, tcp_fd;
+            std::vector<int> clients;
+            std::vector<int> new_clients;
+
+            std::mutex frame_lock;
+            std::condition_variable frame_ready;
+            std::shared_ptr<const matrix_clock::frame_buffer> pending_frame;
+            std::vector<matrix_clock::dirty_rect> pending_rects;
+            std::vector<matrix_clock::dirty_rect> rects;       // the rectangles the stream thread is working on, swapped with pending_rects
+            bool running;
+            std::thread worker;
+
+            std::shared_ptr<const matrix_clock::frame_buffer> last_sent;
+            std::vector<std::uint8_t> packet;
+
+            // the loop of the streaming thread: waits for frames, accepts viewers, and sends the encoded frames out
+            void stream_loop(void);
+
+            // accept every viewer waiting on the listening sockets
+            void accept_clients(int listen_fd);
+
+            // encode the frame into the packet buffer, only looking at the dirty rectangles if previous is given
+            void encode(const matrix_clock::frame_buffer& frame, const matrix_clock::frame_buffer* previous,
+                        const std::vector<matrix_clock::dirty_rect>& rects);
+
+            // send the packet buffer to every viewer in the list, dropping viewers that disconnected
+            void send_packet(std::vector<int>& targets);
+        public:
+            // creates a stream on the given unix socket path and tcp port, the port only listens on the given (IPv4) address
+            // an empty path or a port of 0 disables that kind of socket
+            frame_stream(std::string socket_path, std::string bind_address, int tcp_port);
+
+            // stops the streaming thread and closes all sockets
+            ~frame_stream();
+
+            // opens the sockets and starts the streaming thread, returns false if no socket could be opened
+            bool start(void);
+
+            // queues a frame for the streaming thread, only the newest frame is kept if the thread falls behind
+            void push_frame(std::shared_ptr<const matrix_clock::frame_buffer> frame, const std::vector<matrix_clock::dirty_rect>& dirty_rects) override;
+    };
+}
+
+#endif //MATRIXCLOCK_MATRIX_STREAM_H
@@ -24,10 +24,27 @@ namespace matrix_telegram_integration {
             std::string api_key;
             std::int64_t chat_id;
             TgBot::Bot* bot;
+            matrix_clock::frame_capture* capture;
+            matrix_clock::memory_stats* memory;
+            matrix_clock::clock_observer* dry_run;     // gets every message instead of telegram, null to really send them
         public:
             // default constructor, pulls in the clock container and variable utility for use in the bot, and the API key
             matrix_telegram(matrix_clock::matrix_data*, matrix_clock::variable_utility*);
 
+            // sets where the bot grabs the latest frame from for the /screenshot command
+            // without one the command will tell the user screenshots are unavailable
+            inline void set_frame_capture(matrix_clock::frame_capture* frame_capture) { capture = frame_capture; }
+
+            // sets where the bot reads memory use from for the /memory command
+            // without one the command will tell the user memory stats are unavailable
+            inline void set_memory_stats(matrix_clock::memory_stats* memory_stats) { memory = memory_stats; }
+
+            // hands every message to the observer instead of sending it, a simulation uses this to log what the bot would send
+            inline void set_dry_run(matrix_clock::clock_observer* observer) { dry_run = observer; }
+
+            // returns true if messages go anywhere, either to telegram (the bot token is not "disabled") or to a dry run
+            inline bool is_enabled(void) const { return dry_run != nullptr || api_key != "disabled"; }
+
             // enables the callback for the telegram bot, it will not run unless this is called
             void enable_bot();
 
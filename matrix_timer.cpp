@@ -7,110 +7,131 @@
 //
 
 #include "matrix_clock.h"
-#include <iostream>
-#include <sstream>
 
 namespace matrix_clock {
-    void matrix_timer::calculate_current_time(void) {
-        hour = (int) tick_num / 3600;   // tick nums are calculated using (3600 * hour) + (60 * minute) + second
-        minute = (int) ((tick_num / 60) % 60);      // do opposite calculation to get the hour minute and second number
-        second = tick_num % 60;
+    std::int64_t matrix_timer::elapsed_ms(void) const {
+        if (!started)
+            return 0;
+
+        return paused ? run_ms : run_ms + (get_monotonic_ms() - start_ms);    // a paused timer only counts what it ran for before the pause
+    }
+
+    int matrix_timer::shown_seconds(void) const {
+        if (stopwatch)
+            return (int) (elapsed_ms() / 1000);
+
+        return (int) ((get_time_ms() + 999) / 1000);    // round up so a countdown shows 0:01 for its whole last second
     }
 
     matrix_timer::matrix_timer(int hour, int minute, int second) {
-        if (hour != -2 && minute != -2 && second != -2) {       // making sure this is NOT a stopwatch when created
-            this->hour = original_hour = hour;      // hold original values for the reset value
-            this->minute = original_minute = minute;
-            this->second = original_second = second;
-            tick_num = (hour * 3600) + (minute * 60) + second;  // calculate how many seconds total are in the timer
+        if (hour == -2 && minute == -2 && second == -2) {
+            stopwatch = true;       // it is a stopwatch, count up instead of down later
+            duration_ms = 0;
         } else {
-            original_hour = original_minute = original_second = 0;
-            stopwatch = true;       // it is a stopwatch, set this to true so we count up instead of down later
-            tick_num = 0;
+            duration_ms = (((std::int64_t) hour * 3600) + (minute * 60) + second) * 1000;     // calculate how long the timer runs for
+
+            if (hour == -1) {       // an hour of -1 is the placeholder for no timer at all
+                empty = ended = true;
+                duration_ms = 0;
+            }
         }
+    }
 
-        hold_ending = 0;        // timer has not ended, make sure hold is 0
+    bool matrix_timer::is_shown(int hold_max) const {
+        return !ended && get_hold_seconds() < hold_max;     // a timer that is not started yet is shown as well so the user can see it
     }
 
-    int matrix_timer::tick(int hold_max) {
-        if (paused)
-            return tick_num; // do not tick a paused timer
-
-        if (started) {  // make sure we only tick the timer if it has been started
-            if (!stopwatch) {
-                if (tick_num > 0) {     // while the timer has ticks left, subtract 1
-                    tick_num--;
-                } else {
-                    hold_ending++;  // timer has ended, add to the hold ended for how long to keep it on screen
-                }
-            } else {
-                tick_num++; // it is a stopwatch, count up one
-            }
-        }
+    int matrix_timer::get_hold_seconds(void) const {
+        if (ended || stopwatch)
+            return 0;
 
-        if (hold_ending >= hold_max) {
-            end_timer();    // end the timer if we exceed the holding period
-            return hold_ending;   // the hold period just ended, return false as well
-        }
+        std::int64_t over = elapsed_ms() - duration_ms;
+        return over > 0 ? (int) (over / 1000) : 0;
+    }
+
+    std::int64_t matrix_timer::get_time_ms(void) const {
+        if (ended)
+            return 0;
 
-        // return a negative hold ending if we are in the hold ending period to specify that
-        // otherwise return tick_num to show how far we are in the timer
-        return (hold_ending > 0) ? hold_ending * -1 : tick_num;
+        if (stopwatch)
+            return elapsed_ms();
+
+        return std::max<std::int64_t>(duration_ms - elapsed_ms(), 0);
     }
 
-    bool matrix_timer::can_tick(int hold_max) const {
-        return (hold_ending + 1) < hold_max || (!started && hour != -1);    // the timer can tick if it is NOT at the end of the hold period
-    }                                                                       // or it is not started and the hour isnt -1 (at this point we display it on the screen as non started)
+    std::int64_t matrix_timer::get_finish_ms(void) const {
+        if (ended || !started || paused || stopwatch)
+            return -1;
 
-    std::string matrix_timer::format_timer() {
-        calculate_current_time();   // calculate the tick time for display
+        return start_ms - run_ms + duration_ms;     // the instant it started counting, moved back by what it ran before the last pause
+    }
 
-        std::stringstream stream;
+    int matrix_timer::get_ms_to_next_second(void) const {
+        if (ended || !started || paused)
+            return -1;
 
-        if (hour != 0) {
-            stream << hour << ":";  // format the hour into there if it exists
+        std::int64_t elapsed = elapsed_ms();
 
-            if (minute < 10) {  // if the minute is less than 10, format with another 0
-                stream << "0";
-            }
-        }
+        if (stopwatch)
+            return 1000 - (elapsed % 1000);
 
-        if (stopwatch && minute < 10 && hour == 0) {    // if we have a timer, make the minutes period two wide for consistency
-            stream << "0";
-        }
+        std::int64_t left = duration_ms - elapsed;
 
-        stream << minute << ":";
+        if (left > 0)
+            return (left % 1000 == 0) ? 1000 : left % 1000;    // a countdown rounds up, so it changes as it crosses a whole second
+
+        return 1000 - ((-left) % 1000);     // once it reached zero the hold seconds keep counting
+    }
 
-        if (second < 10) {
-            stream << "0";  // add a 0 for seconds less than 10
+    void matrix_timer::format_timer(std::string& output) const {
+        if (!started && stopwatch) {    // if it is a stopwatch that hasnt started, use 00:00 as a default screen value
+            output += "00:00";
+            return;
         }
 
-        stream << second;
+        int hour = get_hour();
 
-        if (!started && stopwatch) {    // if it is a stopwatch that hasnt started, use 00:00 as a default screen value
-            return "00:00";
+        if (hour != 0) {
+            append_number(output, hour);    // format the hour into there if it exists
+            output += ':';
         }
 
-        return stream.str();
+        // with an hour in front the minutes are always two wide, a stopwatch also keeps them two wide for consistency
+        append_number(output, get_minute(), (hour != 0 || stopwatch) ? 2 : 1);
+        output += ':';
+        append_number(output, get_second(), 2);     // add a 0 for seconds less than 10
+    }
+
+    void matrix_timer::start_timer(void) {
+        if (started)
+            return;     // starting a running timer again would throw away the time it already ran for
+
+        started = true;
+        paused = false;
+        run_ms = 0;
+        start_ms = get_monotonic_ms();
+    }
+
+    void matrix_timer::pause(void) {
+        if (!started)
+            return;
+
+        if (paused)
+            start_ms = get_monotonic_ms();          // resume, counting from now on top of what already ran
+        else
+            run_ms += get_monotonic_ms() - start_ms;    // bank what ran so far
+
+        paused = !paused;
     }
 
     void matrix_timer::end_timer(void) {
-        hour = -1;      // hour being -1 is the ended flag for a timer
-        minute = second = 0;
+        ended = true;       // ended timers show as -1:00:00 and stop taking over their display
         started = false;
-        hold_ending = INT16_MAX;        // this ensures that whatever inputted hold ending is over
     }
 
     void matrix_timer::reset_timer(void) {
-        started = false;        // stop the timer so it does not immediately tick
-        hold_ending = 0;
-        hour = original_hour;       // load original given values
-        minute = original_minute;
-        second = original_second;
-
-        if (stopwatch) {
-            original_hour = original_minute = original_second = 0;
-            tick_num = 0;   // if it was a stopwatch, set the tick num back to the default 0
-        }
+        started = paused = false;     // stop the timer so it does not immediately run
+        ended = empty;      // a reset brings an ended timer back, but the empty placeholder stays empty
+        run_ms = 0;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,92 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// memory_stats.cpp
+// Implementation of the memory_stats class
+//
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    memory_stats::memory_stats() {
+        start_rss = get_rss();
+        start_heap = get_heap();
+        start_time = std::time(nullptr);
+        stats_interval = 60;
+        text_cache = nullptr;
+        timing = nullptr;
+    }
+
+    long memory_stats::get_rss(void) {
+        std::ifstream statm("/proc/self/statm");
+        long total_pages = 0, resident_pages = 0;
+
+        if (!(statm >> total_pages >> resident_pages))  // the second number is the resident set in pages
+            return 0;
+
+        return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    long memory_stats::get_peak_rss(void) {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;     // already in kilobytes on linux
+    }
+
+    long memory_stats::get_heap(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        struct mallinfo2 info = mallinfo2();
+#else
+        struct mallinfo info = mallinfo();  // older glibc (raspberry pi os bullseye) only has the int version, plenty for 512 MB boards
+#endif
+        return (long) ((info.uordblks + info.hblkhd) / 1024);    // bytes in use from the main heap plus large mmap'd blocks
+    }
+
+    std::string memory_stats::report(void) const {
+        long rss = get_rss(), heap = get_heap();
+        long uptime = std::time(nullptr) - start_time;
+
+        std::stringstream stream;
+        stream << "Resident memory: " << rss << " kB (" << std::showpos << rss - start_rss << std::noshowpos << " kB since start)" << std::endl;
+        stream << "Peak resident memory: " << get_peak_rss() << " kB" << std::endl;
+        stream << "Heap in use: " << heap << " kB (" << std::showpos << heap - start_heap << std::noshowpos << " kB since start)" << std::endl;
+        stream << "Running for " << uptime / 86400 << " day(s), " << (uptime % 86400) / 3600 << " hour(s), and " << (uptime % 3600) / 60 << " minute(s)";
+
+        if (text_cache != nullptr)
+            stream << std::endl << text_cache->report();
+
+        if (timing != nullptr)
+            stream << std::endl << timing->report();
+
+        return stream.str();
+    }
+
+    void memory_stats::write_stats(int hour, int minute) const {
+        if (stats_file.empty() || ((hour * 60) + minute) % stats_interval != 0)
+            return;
+
+        std::ofstream stream(stats_file, std::ios::app);    // the file only ever grows by one short line per interval
+
+        if (!stream.good())
+            return;
+
+        std::time_t now = std::time(nullptr);
+        stream << std::put_time(std::localtime(&now), "%Y-%m-%d %H:%M") << " uptime=" << now - start_time << "s";
+        stream << " rss=" << get_rss() << "kB peak_rss=" << get_peak_rss() << "kB heap=" << get_heap() << "kB";
+
+        if (text_cache != nullptr)
+            stream << " text_hits=" << text_cache->get_hits() << " text_misses=" << text_cache->get_misses();
+
+        if (timing != nullptr)
+            stream << " present=\"" << timing->report() << "\"";
+
+        stream << std::endl;
+    }
+}
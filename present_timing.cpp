@@ -0,0 +1,48 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// present_timing.cpp
+// Implementation of the present_timing class
+//
+
+#include <sstream>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    void present_timing::record(std::int64_t offset_us) {
+        std::uint64_t previous = count++;
+
+        total_us += (std::uint64_t) std::max<std::int64_t>(offset_us, 0);
+
+        if (offset_us > LATE_US)
+            late++;
+
+        // only the render thread records, so the best and worst can not be raced by another writer
+        if (previous == 0 || offset_us < best_us)
+            best_us = offset_us;
+
+        if (previous == 0 || offset_us > worst_us)
+            worst_us = offset_us;
+    }
+
+    // formats microseconds as milliseconds with one decimal, for example "1.4 ms"
+    static std::string format_us(std::int64_t microseconds) {
+        std::stringstream stream;
+        stream << (microseconds / 1000) << "." << ((std::abs(microseconds) % 1000) / 100) << " ms";
+        return stream.str();
+    }
+
+    std::string present_timing::report(void) const {
+        std::uint64_t frames = count;
+        std::stringstream stream;
+
+        if (frames == 0)
+            return "Render ahead: no frames were drawn ahead yet";
+
+        stream << "Render ahead: " << frames << " frame(s) up " << format_us(best_us) << " best, " << format_us((std::int64_t) (total_us / frames))
+               << " average, " << format_us(worst_us) << " worst after their second, " << late << " later than " << format_us(LATE_US);
+
+        return stream.str();
+    }
+}
@@ -0,0 +1,260 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// source_scheduler.cpp
+// Implementation of the source_scheduler class
+//
+
+#include <chrono>
+#include <cerrno>
+#include <cctype>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // keeps only the first line of the text, without trailing whitespace, and cuts it off at the longest value kept
+    static void keep_first_line(std::string& text) {
+        std::size_t end = std::min(text.find('\n'), text.size());
+
+        if (end > source_scheduler::MAX_VALUE_LENGTH)
+            end = source_scheduler::MAX_VALUE_LENGTH;
+
+        while (end > 0 && std::isspace((unsigned char) text[end - 1]))
+            end--;
+
+        text.resize(end);
+    }
+
+    source_scheduler::source_scheduler() {
+        running = false;
+        changed = false;
+    }
+
+    source_scheduler::~source_scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(source_lock);
+            running = false;
+        }
+
+        sources_changed.notify_all();
+
+        if (worker.joinable())
+            worker.join();
+    }
+
+    void source_scheduler::set_sources(const std::vector<variable_source>& new_sources) {
+        {
+            std::lock_guard<std::mutex> lock(source_lock);
+            std::map<std::string, source_state, std::less<>> replaced;
+
+            for (const variable_source& source : new_sources) {
+                source_state& state = replaced[source.name];
+                auto previous = sources.find(source.name);
+
+                if (previous != sources.end())
+                    state = std::move(previous->second);    // keep the last value so the clock does not go blank while it is read again
+
+                state.source = source;
+                state.due_ms = 0;
+            }
+
+            sources.swap(replaced);
+
+            if (sources.empty() || running)
+                return;
+
+            running = true;
+            worker = std::thread(&source_scheduler::scheduler_loop, this);
+        }
+
+        sources_changed.notify_all();
+    }
+
+    bool source_scheduler::append_variable(std::string_view kind, std::string_view name, std::string& output) const {
+        std::lock_guard<std::mutex> lock(source_lock);
+        auto found = sources.find(name);
+
+        if (found == sources.end())
+            return false;
+
+        const source_state& state = found->second;
+
+        if (kind == "src") {
+            output += state.value;
+        } else if (kind == "src_age") {
+            if (state.updated_ms == -1) output += '-';
+            else append_number(output, (int) ((now_ms() - state.updated_ms) / 1000));
+        } else if (kind == "src_ms") {
+            if (state.latency_ms == -1) output += '-';
+            else append_number(output, state.latency_ms);
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    void source_scheduler::scheduler_loop(void) {
+        thread_placement::apply(thread_placement::sources);
+        thread_privileges::drop_thread();  // the commands it runs inherit the user of this thread
+        std::unique_lock<std::mutex> lock(source_lock);
+
+        while (running) {
+            // there are only ever a handful of sources, looking through all of them for the next one due is plenty fast
+            auto next = std::min_element(sources.begin(), sources.end(), [](const auto& first, const auto& second) {
+                return first.second.due_ms < second.second.due_ms;
+            });
+
+            if (next == sources.end()) {    // every source was taken out by a reload, wait for new ones
+                sources_changed.wait(lock);
+                continue;
+            }
+
+            std::int64_t now = now_ms();
+
+            if (next->second.due_ms > now) {
+                sources_changed.wait_for(lock, std::chrono::milliseconds(next->second.due_ms - now));
+                continue;   // a reload may have changed the sources while waiting, look for the next one again
+            }
+
+            variable_source source = next->second.source;
+            next->second.due_ms = now + (std::max(source.interval, 1) * 1000);
+
+            lock.unlock();      // reading happens without holding the lock, so the render loop can keep copying values meanwhile
+
+            std::string value;
+            bool success = source.command ? run_command(source, value) : read_file(source, value);
+            std::int64_t finished = now_ms();
+
+            lock.lock();
+
+            auto found = sources.find(source.name);
+
+            if (found == sources.end() || found->second.source.path != source.path)
+                continue;   // the source was changed by a reload while it was read, this value belongs to the old one
+
+            source_state& state = found->second;
+            int latency = (int) (finished - now);
+
+            if (latency != state.latency_ms || (success && value != state.value))
+                changed = true;
+
+            state.latency_ms = latency;
+
+            if (success) {
+                state.value.swap(value);
+                state.updated_ms = finished;
+                state.failing = false;
+            } else if (!state.failing) {
+                std::cerr << "Could not read variable source " << source.name << ", showing its last value." << std::endl;
+                state.failing = true;
+            }
+        }
+    }
+
+    bool source_scheduler::read_file(const variable_source& source, std::string& value) {
+        std::ifstream stream(source.path);
+
+        if (!stream)
+            return false;
+
+        std::getline(stream, value);
+        keep_first_line(value);
+        return !stream.bad();
+    }
+
+    bool source_scheduler::run_command(const variable_source& source, std::string& value) {
+        int pipe_fds[2];
+
+        if (pipe(pipe_fds) != 0)
+            return false;
+
+        pid_t child = fork();
+
+        if (child == -1) {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            return false;
+        }
+
+        if (child == 0) {   // only async signal safe calls from here on, the clock has other threads running
+            dup2(pipe_fds[1], STDOUT_FILENO);
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            execl("/bin/sh", "sh", "-c", source.path.c_str(), (char*) nullptr);
+            _exit(127);
+        }
+
+        close(pipe_fds[1]);
+
+        std::int64_t deadline = now_ms() + (std::max(source.timeout, 1) * 1000);
+        bool timed_out = false;
+        char chunk[256];
+
+        while (true) {
+            std::int64_t left = deadline - now_ms();
+
+            if (left <= 0) {
+                timed_out = true;
+                break;
+            }
+
+            pollfd output = {pipe_fds[0], POLLIN, 0};
+            int ready = poll(&output, 1, (int) left);
+
+            if (ready == 0) {
+                timed_out = true;
+                break;
+            }
+
+            if (ready == -1) {
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            ssize_t count = read(pipe_fds[0], chunk, sizeof(chunk));
+
+            if (count <= 0)
+                break;      // the command closed its output
+
+            // keep draining past the first line so a chatty command never blocks on a full pipe
+            if (value.size() < MAX_VALUE_LENGTH * 4)
+                value.append(chunk, count);
+        }
+
+        close(pipe_fds[0]);
+
+        int status = 0;
+
+        // a command can close its output and keep on running, it still only gets until its timeout to exit
+        while (!timed_out && waitpid(child, &status, WNOHANG) == 0) {
+            if (now_ms() >= deadline)
+                timed_out = true;
+            else
+                usleep(10000);
+        }
+
+        if (timed_out) {
+            kill(child, SIGKILL);
+            waitpid(child, &status, 0);
+            std::cerr << "Variable source " << source.name << " ran for longer than " << source.timeout << " seconds and was killed." << std::endl;
+            return false;
+        }
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            return false;
+
+        keep_first_line(value);
+        return true;
+    }
+
+    std::int64_t source_scheduler::now_ms(void) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
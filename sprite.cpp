@@ -0,0 +1,179 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// sprite.cpp
+// Implementation of the sprite and weather_icon classes
+//
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <png.h>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // nothing shown on a matrix comes close to this, anything bigger is a broken or wrong file
+    static const int MAX_SPRITE_SIZE = 1024;
+
+    // skips whitespace and # comments between the fields of a ppm header
+    static void skip_ppm_space(std::istream& stream) {
+        while (stream) {
+            int next = stream.peek();
+
+            if (next == '#')
+                stream.ignore(4096, '\n');
+            else if (std::isspace(next))
+                stream.get();
+            else
+                return;
+        }
+    }
+
+    bool sprite::load(std::string_view path) {
+        std::string file(path);
+        bool png = file.size() > 4 && !strcasecmp(file.c_str() + file.size() - 4, ".png");
+
+        name = path;
+        width = height = 0;
+        pixels.clear();
+        runs.clear();
+
+        if (!(png ? load_png(file) : load_ppm(file))) {
+            std::cerr << "Could not decode sprite " << file << ", it needs to be a png or binary (P6) ppm file." << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool sprite::load_png(const std::string& path) {
+        png_image image;
+        std::memset(&image, 0, sizeof(image));
+        image.version = PNG_IMAGE_VERSION;
+
+        if (!png_image_begin_read_from_file(&image, path.c_str()))
+            return false;
+
+        if (image.width > MAX_SPRITE_SIZE || image.height > MAX_SPRITE_SIZE) {
+            png_image_free(&image);
+            return false;
+        }
+
+        image.format = PNG_FORMAT_RGBA;     // libpng converts palettes, gray, and 16 bit images for us
+        std::vector<std::uint8_t> buffer(PNG_IMAGE_SIZE(image));
+
+        if (!png_image_finish_read(&image, nullptr, buffer.data(), 0, nullptr))
+            return false;   // finish_read frees the image itself on failure
+
+        width = image.width;
+        height = image.height;
+        build_runs(buffer.data(), buffer.data() + 3, 4);
+        return true;
+    }
+
+    bool sprite::load_ppm(const std::string& path) {
+        std::ifstream stream(path, std::ios::binary);
+        char magic[2];
+
+        if (!stream.read(magic, 2) || magic[0] != 'P' || magic[1] != '6')
+            return false;
+
+        int max_value = 0;
+
+        skip_ppm_space(stream);
+        stream >> width;
+        skip_ppm_space(stream);
+        stream >> height;
+        skip_ppm_space(stream);
+        stream >> max_value;
+        stream.get();   // exactly one whitespace character separates the header from the pixels
+
+        if (!stream || width <= 0 || height <= 0 || width > MAX_SPRITE_SIZE || height > MAX_SPRITE_SIZE || max_value <= 0 || max_value > 65535)
+            return false;
+
+        int sample_size = max_value > 255 ? 2 : 1;
+        std::vector<std::uint8_t> raw((std::size_t) width * height * 3 * sample_size);
+
+        if (!stream.read((char*) raw.data(), raw.size()))
+            return false;
+
+        std::vector<std::uint8_t> rgb((std::size_t) width * height * 3);
+
+        for (std::size_t i = 0; i < rgb.size(); i++) {
+            int sample = sample_size == 2 ? (raw[i * 2] << 8) | raw[(i * 2) + 1] : raw[i];   // 16 bit samples are big endian
+            rgb[i] = (std::uint8_t) (((sample * 255) + (max_value / 2)) / max_value);
+        }
+
+        build_runs(rgb.data(), nullptr, 3);     // ppm files have no transparency, every pixel is drawn
+        return true;
+    }
+
+    void sprite::build_runs(const std::uint8_t* rgb, const std::uint8_t* alpha, int stride) {
+        for (int y = 0; y < height; y++) {
+            int x = 0;
+
+            while (x < width) {
+                std::size_t pixel = (((std::size_t) y * width) + x) * stride;
+
+                if (alpha != nullptr && alpha[pixel] < 128) {
+                    x++;
+                    continue;
+                }
+
+                pixel_run run = {x, y, 0, pixels.size()};
+
+                while (x < width) {
+                    pixel = (((std::size_t) y * width) + x) * stride;
+
+                    if (alpha != nullptr && alpha[pixel] < 128)
+                        break;
+
+                    pixels.insert(pixels.end(), rgb + pixel, rgb + pixel + 3);
+                    run.length++;
+                    x++;
+                }
+
+                runs.push_back(run);
+            }
+        }
+
+        pixels.shrink_to_fit();
+        runs.shrink_to_fit();
+    }
+
+    void sprite::draw(rgb_matrix::Canvas* canvas, int x, int y) const {
+        const int canvas_width = canvas->width();
+        const int canvas_height = canvas->height();
+
+        for (const pixel_run& run : runs) {
+            int row = y + run.y;
+
+            if (row < 0 || row >= canvas_height)
+                continue;
+
+            // clip the run to the canvas once, then every pixel left in it can be written without any checks
+            int start = std::max(x + run.x, 0);
+            int end = std::min(x + run.x + run.length, canvas_width);
+            const std::uint8_t* pixel = pixels.data() + run.offset + ((start - (x + run.x)) * 3);
+
+            for (int column = start; column < end; column++, pixel += 3)
+                canvas->SetPixel(column, row, pixel[0], pixel[1], pixel[2]);
+        }
+    }
+
+    const sprite* weather_icon::get_sprite(int condition) const {
+        const icon_rule* best = nullptr;
+
+        for (const icon_rule& rule : rules) {
+            if (condition < rule.low || condition > rule.high)
+                continue;
+
+            if (best == nullptr || (rule.high - rule.low) < (best->high - best->low))
+                best = &rule;
+        }
+
+        return best == nullptr ? nullptr : best->image;
+    }
+}
@@ -0,0 +1,43 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// startup_report.cpp
+// Implementation of the startup_report class
+//
+
+#include <chrono>
+#include <iostream>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    startup_report::startup_report() {
+        launch_ms = phase_ms = now_ms();
+    }
+
+    void startup_report::phase(const std::string& name) {
+        std::int64_t now = now_ms();
+
+        if (!phases.empty())
+            phases += ", ";
+
+        phases += name + " " + std::to_string(now - phase_ms) + " ms";
+        phase_ms = now;
+    }
+
+    void startup_report::print_first_frame(void) {
+        std::lock_guard<std::mutex> lock(report_lock);
+        std::cout << "Startup: " << phases << ", first frame up " << (now_ms() - launch_ms) << " ms after launch" << std::endl;
+    }
+
+    void startup_report::background_done(const std::string& name, std::int64_t started_ms) {
+        std::int64_t now = now_ms();
+        std::lock_guard<std::mutex> lock(report_lock);
+        std::cout << "Startup: " << name << " took " << (now - started_ms) << " ms in the background, done " << (now - launch_ms) << " ms after launch" << std::endl;
+    }
+
+    std::int64_t startup_report::now_ms(void) {
+        // the real clock even in a simulation, this times the program and not the schedule
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
@@ -0,0 +1,211 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// stream_viewer.cpp
+// A small reference viewer for the live frame stream, draws whatever the clock is showing in a true color terminal
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "matrix_stream.h"
+
+using namespace std;
+
+// reads exactly length bytes from the socket, returns false if the clock hung up
+bool read_fully(int fd, uint8_t* data, size_t length) {
+    size_t received = 0;
+
+    while (received < length) {
+        ssize_t result = read(fd, data + received, length - received);
+
+        if (result <= 0)
+            return false;
+
+        received += result;
+    }
+
+    return true;
+}
+
+// reads a little endian number of the given byte count from the data
+uint32_t read_number(const uint8_t* data, int bytes) {
+    uint32_t value = 0;
+
+    for (int i = 0; i < bytes; i++)
+        value |= data[i] << (i * 8);
+
+    return value;
+}
+
+// connects to the clock over a unix socket, returns -1 if it could not
+int connect_unix(string path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd != -1 && connect(fd, (sockaddr*) &address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// connects to the clock over tcp, returns -1 if it could not
+int connect_tcp(string host, string port) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* results;
+
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0)
+        return -1;
+
+    int fd = -1;
+
+    for (addrinfo* current = results; current != nullptr; current = current->ai_next) {   // try every address the host resolves to
+        fd = socket(current->ai_family, current->ai_socktype, current->ai_protocol);
+
+        if (fd != -1 && connect(fd, current->ai_addr, current->ai_addrlen) == 0)
+            break;
+
+        if (fd != -1) close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(results);
+    return fd;
+}
+
+// applies the spans of a payload onto the pixel buffer, returns false if the payload is malformed
+bool apply_payload(const vector<uint8_t>& payload, vector<uint8_t>& pixels) {
+    size_t position = 0;
+    size_t pixel_count = pixels.size() / 3;
+
+    while (position + 8 <= payload.size()) {
+        // widened before checking, in 32 bits a huge offset plus the count wraps around and would pass the check
+        size_t offset = read_number(&payload[position], 4);
+        size_t count = read_number(&payload[position + 4], 4);
+        position += 8;
+
+        if (count > pixel_count || offset > pixel_count - count)
+            return false;
+
+        while (count > 0) {     // unpack the runs of the span
+            if (position + 4 > payload.size())
+                return false;
+
+            size_t run = payload[position];
+
+            if (run == 0 || run > count)
+                return false;
+
+            for (size_t i = 0; i < run; i++)
+                memcpy(&pixels[(offset + i) * 3], &payload[position + 1], 3);
+
+            offset += run;
+            count -= run;
+            position += 4;
+        }
+    }
+
+    return position == payload.size();
+}
+
+// draws the pixels in the terminal, two matrix rows per line of text using the upper half block character
+void draw(const vector<uint8_t>& pixels, int width, int height) {
+    string output = "\x1b[H";   // move the cursor back to the top left instead of scrolling
+
+    for (int y = 0; y < height; y += 2) {
+        for (int x = 0; x < width; x++) {
+            const uint8_t* top = &pixels[(y * width + x) * 3];
+            const uint8_t* bottom = (y + 1 < height) ? &pixels[((y + 1) * width + x) * 3] : top;
+
+            output += "\x1b[38;2;" + to_string(top[0]) + ";" + to_string(top[1]) + ";" + to_string(top[2]) + "m";
+            output += "\x1b[48;2;" + to_string(bottom[0]) + ";" + to_string(bottom[1]) + ";" + to_string(bottom[2]) + "m";
+            output += "▀";
+        }
+
+        output += "\x1b[0m\n";
+    }
+
+    cout << output << flush;
+}
+
+int main(int argc, char* argv[]) {
+    string socket_path, host, port;
+
+    for (int i = 1; i < argc; i++) {    // loop through all the given arguments
+        string argument = argv[i];
+
+        if (i + 1 < argc && argument == "--SOCKET") {
+            socket_path = argv[++i];
+        } else if (i + 1 < argc && argument == "--HOST") {
+            host = argv[++i];
+        } else if (i + 1 < argc && argument == "--PORT") {
+            port = argv[++i];
+        }
+    }
+
+    if (socket_path.empty() && (host.empty() || port.empty())) {
+        cerr << "Usage: " << argv[0] << " --SOCKET <socket path>" << endl;
+        cerr << "       " << argv[0] << " --HOST <clock address> --PORT <stream port>" << endl;
+        return EXIT_FAILURE;
+    }
+
+    int fd = socket_path.empty() ? connect_tcp(host, port) : connect_unix(socket_path);
+
+    if (fd == -1) {
+        cerr << "Could not connect to the clock." << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "\x1b[2J";  // clear the terminal once, every frame after this draws over the last one
+
+    vector<uint8_t> pixels;
+    vector<uint8_t> payload;
+    uint8_t header[matrix_stream::HEADER_SIZE];
+    int width = 0, height = 0;
+
+    while (read_fully(fd, header, sizeof(header))) {
+        if (header[0] != 'M' || header[1] != 'C') {
+            cerr << "Received something that is not a clock frame." << endl;
+            break;
+        }
+
+        int frame_width = read_number(&header[4], 2);
+        int frame_height = read_number(&header[6], 2);
+        payload.resize(read_number(&header[8], 4));
+
+        if (!read_fully(fd, payload.data(), payload.size()))
+            break;
+
+        if (header[2] == matrix_stream::FRAME_KEY || frame_width != width || frame_height != height) {
+            width = frame_width;        // key frames start from a black screen
+            height = frame_height;
+            pixels.assign(width * height * 3, 0);
+        }
+
+        if (!apply_payload(payload, pixels)) {
+            cerr << "Received a malformed frame." << endl;
+            break;
+        }
+
+        draw(pixels, width, height);
+    }
+
+    close(fd);
+    return EXIT_SUCCESS;
+}
@@ -9,6 +9,8 @@
 #include <string>
 #include <thread>
 #include <sstream>
+#include <cctype>
+#include <cstdlib>
 #include <wiringPi.h>
 #include "matrix_telegram.h"
 #include <iostream>
@@ -21,15 +23,30 @@ namespace matrix_telegram_integration {
     //      api_key = the api key for the telegram bot (required to run)
     //      container = the clock face container that contains all valid clock faces
     //      var_util = the var util used throughout the program to poll for new data
-    void bot_handler(TgBot::Bot* bot, matrix_clock::matrix_data* container, matrix_clock::variable_utility* var_util);
+    //      capture = holds the latest frame drawn on the matrix for the /screenshot command (can be null)
+    //      memory = reports the memory use of the clock for the /memory command (can be null)
+    void bot_handler(TgBot::Bot* bot, matrix_clock::matrix_data* container, matrix_clock::variable_utility* var_util, matrix_clock::frame_capture* capture,
+                     matrix_clock::memory_stats* memory);
 
     // returns the timer control board for the /timer and /stopwatch commands
-    TgBot::InlineKeyboardMarkup::Ptr get_timer_controls(void);
+    // name = the timer the buttons control, empty for the unnamed timer
+    TgBot::InlineKeyboardMarkup::Ptr get_timer_controls(const std::string& name);
+
+    // takes the timer name off the front of the command arguments if there is one
+    // returns false (after telling the user) if the name cannot be used for a timer
+    bool take_timer_name(std::vector<std::string>& split, std::string& name, TgBot::Bot* bot, std::int64_t chat_id);
 
     // sends a telegram message asynchronously to prevent visual stutters in the program
     // these stutters are most visible when you see a seconds variable, calling this method in a thread fixes it
     void push_telegram_separate_thread(std::string message, TgBot::Bot* bot, std::int64_t chat_id, bool dismissable);
 
+    // encodes the latest frame as a png and sends it as a photo, asynchronously so neither the bot nor the clock waits on it
+    // scale = how many times to blow up each pixel, 0 picks a scale that makes the image around 512 pixels wide
+    void send_screenshot(matrix_clock::frame_capture* capture, matrix_clock::matrix_data* container, TgBot::Bot* bot, std::int64_t chat_id, int scale);
+
+    // the body of send_screenshot(), runs on its own thread
+    void push_screenshot_separate_thread(matrix_clock::frame_capture* capture, matrix_clock::matrix_data* container, TgBot::Bot* bot, std::int64_t chat_id, int scale);
+
     // sends a message to the defined chat_id with an inline keyboard containing
     // a single dismiss button that will delete the message in chat
     void send_dismiss_keyboard(std::string message, TgBot::Bot* bot, std::int64_t chat_id);
@@ -40,33 +57,38 @@ namespace matrix_telegram_integration {
         api_key = matrixData->get_bot_token();
         chat_id = matrixData->get_chat_id();
         bot = new TgBot::Bot(api_key);  // create bot object
+        capture = nullptr;
+        memory = nullptr;
+        dry_run = nullptr;
     }
 
     void matrix_telegram::enable_bot() {
-        std::thread poll_bot(bot_handler, bot, matrixData, util); // starts the bot in a separate thread
+        std::thread poll_bot(bot_handler, bot, matrixData, util, capture, memory); // starts the bot in a separate thread
         poll_bot.detach();  // detach so the thread does not die when we leave the method scope
     }
 
     void matrix_telegram::check_send_notifications(int hour, int minute, int day_of_week) {
-        std::vector<matrix_clock::telegram_push*> notifications = matrixData->get_notifications();
-        std::vector<matrix_clock::telegram_push*>::iterator iter;
+        std::shared_ptr<const matrix_clock::config_arena> config = matrixData->get_config();     // a reload from the bot can not free them in the meantime
 
-        for (iter = notifications.begin(); iter != notifications.end(); iter++) {
-            matrix_clock::telegram_push* current_notification = *iter;
+        for (const matrix_clock::telegram_push& current_notification : config->get_notifications()) {
+            if (current_notification.is_push_time(hour, minute, day_of_week)) {
+                std::string message = util->parse_variables(std::string(current_notification.get_message()));
 
-            if (current_notification->is_push_time(hour, minute, day_of_week)) {
-                send_dismiss_keyboard(util->parse_variables(current_notification->get_message()), bot, chat_id);
+                if (dry_run != nullptr)
+                    dry_run->message_sent(message);
+                else
+                    send_dismiss_keyboard(message, bot, chat_id);
             }
         }
     }
 
-    void bot_handler(TgBot::Bot* bot, matrix_clock::matrix_data* container, matrix_clock::variable_utility* var_util) {
-        TgBot::InlineKeyboardMarkup::Ptr clock_faces_keyboard(new TgBot::InlineKeyboardMarkup); // the inline clock_faces_keyboard for the clock faces
-
-        std::string* name_array = container->get_names(); // grab the names of all the faces to load into the clock face
+    void bot_handler(TgBot::Bot* bot, matrix_clock::matrix_data* container, matrix_clock::variable_utility* var_util, matrix_clock::frame_capture* capture,
+                     matrix_clock::memory_stats* memory) {
+        matrix_clock::thread_placement::apply(matrix_clock::thread_placement::telegram);
+        matrix_clock::thread_privileges::drop_thread();
 
         // generate inline keyboards for the user
-        bot->getEvents().onCommand("buttons", [&bot, &clock_faces_keyboard, &container, &name_array](TgBot::Message::Ptr message) {
+        bot->getEvents().onCommand("buttons", [&bot, &container](TgBot::Message::Ptr message) {
             // delete the /buttons message (this is for cleanliness in a non group chat (so there are no permission issues))
             if (message->chat->type == TgBot::Chat::Type::Private) {
                 bot->getApi().deleteMessage(message->chat->id, message->messageId);
@@ -74,8 +96,12 @@ namespace matrix_telegram_integration {
 
             // GENERATING THREE INLINE KEYBOARDS:
             // FIRST KEYBOARD: clock face override
+            // built fresh every time so it matches the config after a reload and does not pile up rows from earlier calls
+
+            TgBot::InlineKeyboardMarkup::Ptr clock_faces_keyboard(new TgBot::InlineKeyboardMarkup); // the inline clock_faces_keyboard for the clock faces
+            std::vector<std::string> name_array = container->get_names(); // grab the names of all the faces to load into the clock face
 
-            int length = container->get_clock_face_count(); // length of the clock faces container
+            int length = name_array.size(); // length of the clock faces container
 
             // this is the loop for the amount of rows we will have, three clock faces names allowed per row
             for (int i = 0; i < (length / 3) + (length % 3 == 0 ? 0 : 1); i++) { // loop until we have the amount of rows = to the count / 3 + 1 more if there is extra
@@ -199,6 +225,16 @@ namespace matrix_telegram_integration {
             print_button->callbackData = "command_print_data";
             data_row.push_back(print_button);
 
+            TgBot::InlineKeyboardButton::Ptr screenshot_button(new TgBot::InlineKeyboardButton);
+            screenshot_button->text = "Screenshot";
+            screenshot_button->callbackData = "command_screenshot";
+            data_row.push_back(screenshot_button);
+
+            TgBot::InlineKeyboardButton::Ptr memory_button(new TgBot::InlineKeyboardButton);
+            memory_button->text = "Memory";
+            memory_button->callbackData = "command_memory";
+            data_row.push_back(memory_button);
+
             system_controls_keyboard->inlineKeyboard.push_back(system_row);
             system_controls_keyboard->inlineKeyboard.push_back(data_row);
 
@@ -211,8 +247,17 @@ namespace matrix_telegram_integration {
             }
 
             std::vector<std::string> split = StringTools::split(message->text, ' ');
+            std::string name;
+
+            if (!take_timer_name(split, name, bot, message->chat->id))
+                return;
 
-            if (split.size() >= 3) {
+            if (split.size() == 1 && !name.empty()) {   // just a name brings the controls of that timer back up
+                if (var_util->get_timers().has(name))
+                    bot->getApi().sendMessage(message->chat->id, "Controls for timer " + name + ".", nullptr, 0, get_timer_controls(name), "Markdown");
+                else
+                    send_dismiss_keyboard("There is no timer called " + name + ".", bot, message->chat->id);
+            } else if (split.size() >= 3) {
                 int hour = 0, minute, second;
 
                 if (split.size() == 3) {
@@ -224,8 +269,7 @@ namespace matrix_telegram_integration {
                     second = std::stoi(split[3]);
                 }
 
-                matrix_clock::matrix_timer* timer = new matrix_clock::matrix_timer(hour, minute, second);
-                var_util->set_timer(timer);
+                var_util->get_timers().set(name, std::make_shared<matrix_clock::matrix_timer>(hour, minute, second));
 
                 TgBot::InlineKeyboardMarkup::Ptr timer_controls_keyboard(new TgBot::InlineKeyboardMarkup);
                 std::vector<TgBot::InlineKeyboardButton::Ptr> timer_row;
@@ -248,7 +292,7 @@ namespace matrix_telegram_integration {
                 timer_controls_keyboard->inlineKeyboard.push_back(timer_row);
 
                 std::stringstream timer_info;
-                timer_info << "Created a timer for ";
+                timer_info << "Created a timer " << (name.empty() ? "" : "called " + name + " ") << "for ";
 
                 if (hour != 0) timer_info << hour << " hour(s) ";
                 if ((hour != 0 && minute != 0) || (hour != 0 && second != 0)) timer_info << "and ";
@@ -257,9 +301,9 @@ namespace matrix_telegram_integration {
                 if (second != 0) timer_info << second << " second(s).";
 
                 // send the user information about the timer they created as well as timer controls again
-                bot->getApi().sendMessage(message->chat->id, timer_info.str(), nullptr, 0, get_timer_controls(), "Markdown");
+                bot->getApi().sendMessage(message->chat->id, timer_info.str(), nullptr, 0, get_timer_controls(name), "Markdown");
             } else {
-                bot->getApi().sendMessage(message->chat->id, "Invalid use of command. Proper usage /timer [h] [m] [s] or /timer [m] [s]");
+                bot->getApi().sendMessage(message->chat->id, "Invalid use of command. Proper usage /timer [name] [h] [m] [s] or /timer [name] [m] [s]");
             }
         });
 
@@ -268,26 +312,94 @@ namespace matrix_telegram_integration {
                 bot->getApi().deleteMessage(message->chat->id, message->messageId);
             }
 
-            bot->getApi().sendMessage(message->chat->id, "Created a stopwatch.", nullptr, 0, get_timer_controls(), "Markdown");
+            std::vector<std::string> split = StringTools::split(message->text, ' ');
+            std::string name;
+
+            if (!take_timer_name(split, name, bot, message->chat->id))
+                return;
+
+            var_util->get_timers().set(name, std::make_shared<matrix_clock::matrix_timer>(-2, -2, -2));
+
+            bot->getApi().sendMessage(message->chat->id, name.empty() ? "Created a stopwatch." : "Created a stopwatch called " + name + ".", nullptr, 0,
+                                      get_timer_controls(name), "Markdown");
+        });
+
+        bot->getEvents().onCommand("timers", [&bot, &var_util] (TgBot::Message::Ptr message) {
+            if (message->chat->type == TgBot::Chat::Type::Private) {
+                bot->getApi().deleteMessage(message->chat->id, message->messageId);
+            }
+
+            std::stringstream stream;
+
+            // lists every timer with the time it is showing right now
+            auto list_timer = [&stream, &var_util] (const std::string& label, std::string_view name) {
+                std::shared_ptr<matrix_clock::matrix_timer> timer = var_util->get_timers().get(name);
+                std::string shown;
+                timer->format_timer(shown);
 
-            matrix_clock::matrix_timer* timer = new matrix_clock::matrix_timer(-2, -2, -2);
-            var_util->set_timer(timer);
+                stream << label << ": " << shown;
+
+                if (!timer->is_started()) stream << " (not started)";
+                else if (timer->is_paused()) stream << " (paused)";
+
+                stream << std::endl;
+            };
+
+            if (var_util->has_timer())
+                list_timer("Timer", "");
+
+            for (const std::string& name : var_util->get_timers().get_names())
+                list_timer(name, name);
+
+            send_dismiss_keyboard(stream.str().empty() ? "There are no timers." : stream.str(), bot, message->chat->id);
+        });
+
+        bot->getEvents().onCommand("memory", [&bot, &memory] (TgBot::Message::Ptr message) {
+            if (message->chat->type == TgBot::Chat::Type::Private) {
+                bot->getApi().deleteMessage(message->chat->id, message->messageId);
+            }
+
+            send_dismiss_keyboard(memory != nullptr ? memory->report() : "Memory stats are not available.", bot, message->chat->id);
+        });
+
+        bot->getEvents().onCommand("screenshot", [&bot, &container, &capture] (TgBot::Message::Ptr message) {
+            if (message->chat->type == TgBot::Chat::Type::Private) {
+                bot->getApi().deleteMessage(message->chat->id, message->messageId);
+            }
+
+            std::vector<std::string> split = StringTools::split(message->text, ' ');
+            int scale = 0;  // 0 lets send_screenshot() pick a readable size
+
+            if (split.size() >= 2 && !split[1].empty() && std::all_of(split[1].begin(), split[1].end(), ::isdigit)) {
+                // strtol saturates instead of throwing on something like 99999999999, and the cap keeps it well inside an int
+                scale = (int) std::min<long>(std::strtol(split[1].c_str(), nullptr, 10), 16);
+            }
+
+            send_screenshot(capture, container, bot, message->chat->id, scale);
         });
 
         // callback query to the inline clock_faces_keyboard
-        bot->getEvents().onCallbackQuery([&bot, &container, &var_util](TgBot::CallbackQuery::Ptr query) {
+        bot->getEvents().onCallbackQuery([&bot, &container, &var_util, &capture, &memory](TgBot::CallbackQuery::Ptr query) {
             if (!StringTools::startsWith(query->data, "command")) { // make sure it doesnt start with command, there are other buttons
-                container->update_clock_face(query->data); // set the current clock face to the name pressed
-                container->set_clock_face_override(true);       // set the clock face override on, this way it will stay and not change with time
+                container->update_clock_face(query->data); // set the current clock face to the name pressed, this also overrides its display so it will stay and not change with time
                 container->set_update_required(true);       // force clock update now
             } else {
+                // timer buttons carry the name of their timer after a colon, the unnamed timer has none
+                std::string command = query->data, timer_name;
+                std::size_t colon = command.find(':');
+
+                if (colon != std::string::npos) {
+                    timer_name = command.substr(colon + 1);
+                    command.erase(colon);
+                }
+
                 if (query->data == "command_clear_override") {
                     int times[4];
                     var_util->get_time(times);
 
-                    container->update_clock_face(times[3], times[1], var_util->get_day_of_week());   // update the clock face to the one it should be at the current time
+                    container->clear_clock_face_overrides();                // turn off clock face override on every display
+                    container->update_clock_face(times[3], times[1], var_util->get_day_of_week());   // update the clock faces to the ones they should be at the current time
                     container->set_update_required(true);                   // force update
-                    container->set_clock_face_override(false);              // turn off clock face override
                 } else if (query->data == "command_clock_on") {
                     container->set_clock_on(true);              // turn the clock on and force update
                     container->set_update_required(true);
@@ -305,7 +417,14 @@ namespace matrix_telegram_integration {
                 } else if (query->data == "command_reload_config") {
                     container->set_skip_second(1); // skip a second because of the config update
                     container->load_clock_data();
-                    var_util->set_weather_url(container->get_weather_url());    // update the weather URL in case it changed and poll weather again
+                    var_util->get_timers().set_hold(container->get_timer_hold());   // the hold period may have changed
+                    // update the weather provider in case it changed and poll weather again
+                    var_util->set_weather_provider(matrix_clock::weather_provider::create(container->get_weather_provider(), container->get_weather_url(),
+                                                                                          container->get_weather_file()));
+                    var_util->set_weather_cache(container->get_weather_cache(), container->get_weather_cache_ttl());
+
+                    if (var_util->get_source_scheduler() != nullptr)     // pick up added, removed, or changed variable sources
+                        var_util->get_source_scheduler()->set_sources(container->get_variable_sources());
                     var_util->poll_weather();
                     container->set_update_required(true);       // force update
                     send_dismiss_keyboard("Successfully reloaded matrix config.", bot, query->message->chat->id);
@@ -329,37 +448,42 @@ namespace matrix_telegram_integration {
                     stream << (times[1] < 10 ? "0" : "") << times[1];
                     stream << (times[3] < 12 ? "am" : "pm") << std::endl << std::endl;
 
+                    // every value comes from the same poll even if the weather is polled again while this is put together
+                    std::shared_ptr<const matrix_clock::weather_snapshot> weather = var_util->get_weather();
+
                     // no need to print out fake data if it is not correct
-                    if (var_util->get_current_forecast_short() != "~Error~") {
+                    if (weather->short_forecast != "~Error~") {
                         // print out the weather
-                        stream << "Today's weather forecast: " << var_util->get_day_forecast() << std::endl;
-                        stream << "The current conditions are " << var_util->get_current_forecast();
-                        stream << " (" << var_util->get_current_forecast_short() << ")." << std::endl;
-                        stream << "It is currently " << var_util->get_temp() << "F (" << var_util->get_real_feel() << "F real feel) ";
-                        stream << "with a humidity of " << var_util->get_humidity() << "%" << std::endl;
-                        stream << "The days low is " << var_util->get_day_low() << "F with a high of " << var_util->get_day_high() << "F " << std::endl;
-                        stream << "The wind is currently blowing at " << var_util->get_wind_speed() << "mph" << std::endl;
+                        stream << "Today's weather forecast: " << weather->day_forecast << std::endl;
+                        stream << "The current conditions are " << weather->forecast;
+                        stream << " (" << weather->short_forecast << ")." << std::endl;
+                        stream << "It is currently " << weather->temp << "F (" << weather->real_feel << "F real feel) ";
+                        stream << "with a humidity of " << weather->humidity << "%" << std::endl;
+                        stream << "The days low is " << weather->day_low << "F with a high of " << weather->day_high << "F " << std::endl;
+                        stream << "The wind is currently blowing at " << weather->wind_speed << "mph" << std::endl;
                     } else {
                         stream << "Could not load current weather data. Check your weather URL in your matrix config file." << std::endl;
                     }
 
                     // send the build stream to the user
                     send_dismiss_keyboard(stream.str(), bot, query->message->chat->id);
+                } else if (query->data == "command_screenshot") {
+                    send_screenshot(capture, container, bot, query->message->chat->id, 0);
+                } else if (query->data == "command_memory") {
+                    send_dismiss_keyboard(memory != nullptr ? memory->report() : "Memory stats are not available.", bot, query->message->chat->id);
                 } else if (query->data == "command_dismiss") {
                     bot->getApi().deleteMessage(query->message->chat->id, query->message->messageId);
-                } else if (query->data == "command_timer_start") {
-                    if (var_util->has_timer()) {
-                        var_util->get_timer()->start_timer();       // only start the timer if we have one
-                        container->set_skip_second(2);           // skip two seconds because the timer may be offset from telegram
+                } else if (command == "command_timer_start") {
+                    if (var_util->get_timers().start(timer_name)) {     // only start the timer if we have one
                         container->set_update_required(true);       // force update
                         bot->getApi().deleteMessage(query->message->chat->id, query->message->messageId);
                     } else {
                         send_dismiss_keyboard("There is no timer to start.", bot, query->message->chat->id);
                     }
-                } else if (query->data == "command_timer_pause") {
-                    if (var_util->has_timer()) {
-                        if (var_util->get_timer()->is_started()) {
-                            var_util->get_timer()->pause();     // pause the timer to stop it from ticking (this is a toggle)
+                } else if (command == "command_timer_pause") {
+                    if (var_util->get_timers().has(timer_name)) {
+                        if (var_util->get_timers().get(timer_name)->is_started()) {
+                            var_util->get_timers().pause(timer_name);     // pause the timer to stop it from ticking (this is a toggle)
                             digitalWrite(container->get_buzzer_pin(), LOW);
                         } else {
                             send_dismiss_keyboard("This timer was never started.", bot, query->message->chat->id);
@@ -367,13 +491,12 @@ namespace matrix_telegram_integration {
                     } else {
                         send_dismiss_keyboard("There is no timer to pause.", bot, query->message->chat->id);
                     }
-                } else if (query->data == "command_timer_cancel") {
-                    var_util->get_timer()->end_timer();
-                    var_util->set_timer(new matrix_clock::matrix_timer(-1, 0, 0));  // set to an empty timer
+                } else if (command == "command_timer_cancel") {
+                    var_util->get_timers().remove(timer_name);   // the unnamed timer goes back to the empty one
                     container->set_update_required(true);   // force update to go back to the current clock face
                     digitalWrite(container->get_buzzer_pin(), LOW);   // turn off buzzer in case it was on
-                } else if (query->data == "command_timer_reset") {
-                    var_util->get_timer()->reset_timer();
+                } else if (command == "command_timer_reset") {
+                    var_util->get_timers().reset(timer_name);
                     container->set_update_required(true);   // force update to display the resetted timer
                     digitalWrite(container->get_buzzer_pin(), LOW);
                 }
@@ -399,6 +522,9 @@ namespace matrix_telegram_integration {
     }
 
     void push_telegram_separate_thread(std::string message, TgBot::Bot* bot, std::int64_t chat_id, bool dismissable) {
+        matrix_clock::thread_placement::apply(matrix_clock::thread_placement::messages);
+        matrix_clock::thread_privileges::drop_thread();
+
         if (dismissable) {
             TgBot::InlineKeyboardMarkup::Ptr message_keyboard(new TgBot::InlineKeyboardMarkup);
             std::vector<TgBot::InlineKeyboardButton::Ptr> dismiss_button_row;
@@ -418,27 +544,93 @@ namespace matrix_telegram_integration {
     }
 
     void matrix_telegram::send_message(std::string message, bool dismiss_button) const {
+        if (dry_run != nullptr) {
+            dry_run->message_sent(message);
+            return;
+        }
+
         std::thread send_async(push_telegram_separate_thread, message, bot, chat_id, dismiss_button);   // send asynchronous to prevent visual stutters in the clock update loop
         send_async.detach();
     }
 
+    void send_screenshot(matrix_clock::frame_capture* capture, matrix_clock::matrix_data* container, TgBot::Bot* bot, std::int64_t chat_id, int scale) {
+        std::thread send_async(push_screenshot_separate_thread, capture, container, bot, chat_id, scale);   // encoding and uploading never happens on the bot or render thread
+        send_async.detach();
+    }
+
+    void push_screenshot_separate_thread(matrix_clock::frame_capture* capture, matrix_clock::matrix_data* container, TgBot::Bot* bot, std::int64_t chat_id, int scale) {
+        matrix_clock::thread_placement::apply(matrix_clock::thread_placement::messages);
+        matrix_clock::thread_privileges::drop_thread();
+
+        std::shared_ptr<const matrix_clock::frame_buffer> frame = capture != nullptr ? capture->get_latest() : nullptr;
+
+        if (frame == nullptr) {
+            push_telegram_separate_thread("There is no frame to take a screenshot of yet.", bot, chat_id, true);
+            return;
+        }
+
+        if (!container->is_clock_on()) {
+            push_telegram_separate_thread("The clock is currently off.", bot, chat_id, true);
+            return;
+        }
+
+        if (scale <= 0)
+            scale = std::max(1, 512 / frame->width);     // default to roughly 512 pixels wide, big enough to read on a phone
+
+        scale = std::min(scale, 16);    // anything bigger is just a waste of bandwidth
+
+        TgBot::InputFile::Ptr photo(new TgBot::InputFile);
+        photo->mimeType = "image/png";
+        photo->fileName = "screenshot.png";
+
+        if (!matrix_clock::encode_png(*frame, scale, photo->data)) {
+            push_telegram_separate_thread("Could not encode the screenshot.", bot, chat_id, true);
+            return;
+        }
+
+        matrix_clock::face_state state;     // a reload from the bot can not free the face while its name is read
+        container->copy_state(state);
+
+        std::string caption = "Currently showing: ";
+        if (state.displays.size() == 1) {
+            caption += std::string(state.faces[0]->get_name());
+        } else {    // name the face on every display, e.g. "left: Day, right: Weather"
+            for (size_t i = 0; i < state.displays.size(); i++) {
+                if (i > 0) caption += ", ";
+                caption += state.displays[i].get_name() + ": " + std::string(state.faces[i]->get_name());
+            }
+        }
+
+        try {
+            bot->getApi().sendPhoto(chat_id, photo, caption);
+        } catch (std::exception& e) {   // this runs detached, do not let a network error take the whole program down
+            std::cout << "Could not send screenshot: " << e.what() << std::endl;
+        }
+    }
+
     void send_dismiss_keyboard(std::string message, TgBot::Bot* bot, std::int64_t chat_id) {
         std::thread send_async(push_telegram_separate_thread, message, bot, chat_id, true);
         send_async.detach();
     }
 
-    TgBot::InlineKeyboardMarkup::Ptr get_timer_controls(void) {
+    TgBot::InlineKeyboardMarkup::Ptr get_timer_controls(const std::string& name) {
         TgBot::InlineKeyboardMarkup::Ptr timer_controls_keyboard(new TgBot::InlineKeyboardMarkup);
         std::vector<TgBot::InlineKeyboardButton::Ptr> timer_row;
+        std::string suffix = name.empty() ? "" : ":" + name;     // named timers get their name on the callback data
 
         TgBot::InlineKeyboardButton::Ptr start_button(new TgBot::InlineKeyboardButton);
         start_button->text = "Start";
-        start_button->callbackData = "command_timer_start";
+        start_button->callbackData = "command_timer_start" + suffix;
         timer_row.push_back(start_button);
 
+        TgBot::InlineKeyboardButton::Ptr pause_button(new TgBot::InlineKeyboardButton);
+        pause_button->text = "Pause";
+        pause_button->callbackData = "command_timer_pause" + suffix;
+        timer_row.push_back(pause_button);
+
         TgBot::InlineKeyboardButton::Ptr cancel_button(new TgBot::InlineKeyboardButton);
         cancel_button->text = "Cancel";
-        cancel_button->callbackData = "command_timer_cancel";
+        cancel_button->callbackData = "command_timer_cancel" + suffix;
         timer_row.push_back(cancel_button);
 
         TgBot::InlineKeyboardButton::Ptr dismiss_button(new TgBot::InlineKeyboardButton);   // add a dismiss button for ease of clearing push notifications
@@ -450,4 +642,19 @@ namespace matrix_telegram_integration {
 
         return timer_controls_keyboard;
     }
+
+    bool take_timer_name(std::vector<std::string>& split, std::string& name, TgBot::Bot* bot, std::int64_t chat_id) {
+        if (split.size() < 2 || split[1].empty() || std::isdigit((unsigned char) split[1][0]))
+            return true;    // no name, this is about the unnamed timer
+
+        name = split[1];
+        split.erase(split.begin() + 1);
+
+        if (!matrix_clock::timer_set::is_valid_name(name)) {
+            send_dismiss_keyboard("Timer names can only use letters, numbers, - and _ and be up to 32 characters long.", bot, chat_id);
+            return false;
+        }
+
+        return true;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,194 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// text_raster_cache.cpp
+// Implementation of the text_raster_cache class
+//
+
+#include <sstream>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // a canvas that only catches the pixels rgb_matrix::DrawText() sets, writing them into the bitmap of a cache entry
+    class bitmap_recorder : public rgb_matrix::Canvas {
+        private:
+            std::uint64_t* bits;
+        public:
+            bool overflowed = false;    // a pixel landed outside of the bitmap, so it cannot hold the line
+
+            inline bitmap_recorder(std::uint64_t* bits) : bits(bits) {}
+
+            inline int width() const override { return text_raster_cache::MAX_WIDTH; }
+            inline int height() const override { return text_raster_cache::MAX_HEIGHT; }
+
+            void SetPixel(int x, int y, std::uint8_t red, std::uint8_t green, std::uint8_t blue) override {
+                if (x < 0 || y < 0 || x >= text_raster_cache::MAX_WIDTH || y >= text_raster_cache::MAX_HEIGHT) {
+                    overflowed = true;
+                    return;
+                }
+
+                bits[(y * (text_raster_cache::MAX_WIDTH / 64)) + (x / 64)] |= std::uint64_t(1) << (x % 64);
+            }
+
+            void Clear() override {}
+            void Fill(std::uint8_t red, std::uint8_t green, std::uint8_t blue) override {}
+    };
+
+    // FNV-1a over everything a line is cached by, never 0 so it can not match a free entry
+    static std::uint64_t hash_line(const rgb_matrix::Font* font, const rgb_matrix::Color& color, const std::string& text) {
+        std::uint64_t hash = 14695981039346656037ULL;
+        std::uintptr_t address = (std::uintptr_t) font;
+
+        auto mix = [&hash](std::uint8_t byte) { hash = (hash ^ byte) * 1099511628211ULL; };
+
+        for (std::size_t i = 0; i < sizeof(address); i++)
+            mix((std::uint8_t) (address >> (i * 8)));
+
+        mix(color.r);
+        mix(color.g);
+        mix(color.b);
+
+        for (char character : text)
+            mix((std::uint8_t) character);
+
+        return hash | 1;
+    }
+
+    void text_raster_cache::resize(int capacity) {
+        entries.assign(std::max(capacity, 0), entry());
+        hashes.assign(entries.size(), 0);
+        use_count = 0;
+    }
+
+    int text_raster_cache::draw(rgb_matrix::Canvas* canvas, const rgb_matrix::Font& font, int x, int y, const rgb_matrix::Color& color, const std::string& text) {
+        if (entries.empty())
+            return rgb_matrix::DrawText(canvas, font, x, y, color, text.c_str());   // the cache is turned off
+
+        if (text.size() > MAX_TEXT || font.height() > MAX_HEIGHT) {
+            misses++;
+            return rgb_matrix::DrawText(canvas, font, x, y, color, text.c_str());
+        }
+
+        std::uint64_t hash = hash_line(&font, color, text);
+
+        // a few hundred hashes sit next to each other, scanning them is quicker than drawing a single glyph
+        for (std::size_t i = 0; i < hashes.size(); i++) {
+            if (hashes[i] != hash)
+                continue;
+
+            entry& found = entries[i];
+
+            if (found.font == &font && found.r == color.r && found.g == color.g && found.b == color.b &&
+                found.text_length == text.size() && !std::memcmp(found.text, text.data(), text.size())) {
+                found.last_used = ++use_count;
+                hits++;
+                blit(found, canvas, x, y, color);
+                return found.width;
+            }
+        }
+
+        // a line too wide for the bitmap is drawn directly, before it can push out a cached line it would not fit in the place of
+        if (measure(font, text) > MAX_WIDTH) {
+            misses++;
+            return rgb_matrix::DrawText(canvas, font, x, y, color, text.c_str());
+        }
+
+        // not cached, take a free entry if there is one (they were last used at 0) or the least recently used one
+        std::size_t oldest = 0;
+
+        for (std::size_t i = 1; i < entries.size(); i++) {
+            if (entries[i].last_used < entries[oldest].last_used)
+                oldest = i;
+        }
+
+        entry& target = entries[oldest];
+        misses++;
+
+        if (!rasterize(target, font, color, text)) {
+            target.last_used = 0;       // whatever was in it is gone either way
+            hashes[oldest] = 0;
+            return rgb_matrix::DrawText(canvas, font, x, y, color, text.c_str());
+        }
+
+        target.font = &font;
+        target.r = color.r;
+        target.g = color.g;
+        target.b = color.b;
+        target.text_length = text.size();
+        std::memcpy(target.text, text.data(), text.size());
+        target.last_used = ++use_count;
+        hashes[oldest] = hash;
+
+        blit(target, canvas, x, y, color);
+        return target.width;
+    }
+
+    int text_raster_cache::measure(const rgb_matrix::Font& font, const std::string& text) {
+        int width = 0;
+
+        for (std::size_t i = 0; i < text.size();) {
+            unsigned char lead = (unsigned char) text[i];
+            int length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+            std::uint32_t codepoint = length == 1 ? lead : length == 2 ? lead & 0x1F : length == 3 ? lead & 0x0F : lead & 0x07;
+
+            for (int k = 1; k < length && i + k < text.size(); k++)     // decode the utf-8 sequence of the glyph
+                codepoint = (codepoint << 6) | ((unsigned char) text[i + k] & 0x3F);
+
+            // a glyph the font does not have is left out here, rasterize() still catches the line if that made it too narrow
+            width += std::max(font.CharacterWidth(codepoint), 0);
+            i += length;
+        }
+
+        return width;
+    }
+
+    bool text_raster_cache::rasterize(entry& target, const rgb_matrix::Font& font, const rgb_matrix::Color& color, const std::string& text) {
+        std::memset(target.bits, 0, sizeof(target.bits));
+
+        // drawn with the top of the font on the first row of the bitmap
+        bitmap_recorder recorder(target.bits);
+        target.width = rgb_matrix::DrawText(&recorder, font, 0, font.baseline(), color, text.c_str());
+        target.rows = font.height();
+
+        return !recorder.overflowed && target.width <= MAX_WIDTH;
+    }
+
+    void text_raster_cache::blit(const entry& source, rgb_matrix::Canvas* canvas, int x, int y, const rgb_matrix::Color& color) {
+        const int canvas_width = canvas->width();
+        const int canvas_height = canvas->height();
+        int top = y - source.font->baseline();
+
+        for (int row = 0; row < source.rows; row++) {
+            int pixel_y = top + row;
+
+            if (pixel_y < 0 || pixel_y >= canvas_height)
+                continue;
+
+            for (int word = 0; word < ROW_WORDS; word++) {
+                std::uint64_t bits = source.bits[(row * ROW_WORDS) + word];
+
+                // only the pixels that are set are visited, the gaps between glyphs are skipped a whole word at a time
+                while (bits != 0) {
+                    int pixel_x = x + (word * 64) + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+
+                    if (pixel_x >= 0 && pixel_x < canvas_width)
+                        canvas->SetPixel(pixel_x, pixel_y, color.r, color.g, color.b);
+                }
+            }
+        }
+    }
+
+    std::string text_raster_cache::report(void) const {
+        std::uint64_t cache_hits = hits, cache_misses = misses;
+        std::stringstream stream;
+
+        stream << "Text cache: " << cache_hits << " line(s) drawn from the cache, " << cache_misses << " drawn glyph by glyph";
+
+        if (cache_hits + cache_misses > 0)
+            stream << " (" << (cache_hits * 100) / (cache_hits + cache_misses) << "% hits)";
+
+        return stream.str();
+    }
+}
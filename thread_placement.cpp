@@ -0,0 +1,155 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// thread_placement.cpp
+// Implementation of the thread_placement class
+//
+
+#include <cerrno>
+#include <cstdlib>
+#include <dirent.h>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // the names used in the threading section of the config, indexed by thread_placement::subsystem
+    static const char* const SUBSYSTEM_NAMES[thread_placement::SUBSYSTEMS] = {"render", "telegram", "messages", "sources", "stream", "background"};
+
+    thread_policy thread_placement::policies[SUBSYSTEMS];
+    bool thread_placement::enabled = false;
+    std::atomic<bool> thread_placement::reported[SUBSYSTEMS];
+
+    static pid_t current_tid(void) {
+        return (pid_t) syscall(SYS_gettid);     // glibc only has gettid() from 2.30 on
+    }
+
+    // describes where the thread with the given id runs and how it is scheduled, for example "cpus 0,1, nice 10"
+    static std::string describe_thread(pid_t tid) {
+        std::ostringstream description;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        if (sched_getaffinity(tid, sizeof(set), &set) == 0) {
+            long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+            if (CPU_COUNT(&set) >= online) {
+                description << "any cpu";
+            } else {
+                description << "cpus ";
+                bool first = true;
+
+                for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                    if (!CPU_ISSET(cpu, &set))
+                        continue;
+
+                    description << (first ? "" : ",") << cpu;
+                    first = false;
+                }
+            }
+        }
+
+        int policy = sched_getscheduler(tid);
+        sched_param param;
+
+        if ((policy == SCHED_FIFO || policy == SCHED_RR) && sched_getparam(tid, &param) == 0) {
+            description << ", " << (policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR") << " priority " << param.sched_priority;
+        } else {
+            errno = 0;
+            int nice = getpriority(PRIO_PROCESS, tid);     // on Linux every thread has a nice level of its own
+
+            if (errno == 0)
+                description << ", nice " << nice;
+        }
+
+        return description.str();
+    }
+
+    void thread_placement::configure(subsystem which, const thread_policy& policy) {
+        policies[which] = policy;
+        enabled = true;
+    }
+
+    void thread_placement::apply(subsystem which) {
+        if (!enabled)
+            return;     // no threading section, leave everything the way the kernel set it up
+
+        const thread_policy& policy = policies[which];
+        pid_t tid = current_tid();
+        std::string refused;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        if (policy.cpus.empty()) {
+            for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN) && cpu < CPU_SETSIZE; cpu++)
+                CPU_SET(cpu, &set);
+        } else {
+            for (int cpu : policy.cpus) {
+                if (cpu >= 0 && cpu < CPU_SETSIZE)
+                    CPU_SET(cpu, &set);
+            }
+        }
+
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+        if (error != 0)
+            refused += std::string("; could not set cpus: ") + strerror(error);
+
+        sched_param param;
+        param.sched_priority = policy.priority > 0 ? std::min(policy.priority, sched_get_priority_max(SCHED_FIFO)) : 0;
+        error = pthread_setschedparam(pthread_self(), policy.priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+
+        if (error != 0)
+            refused += std::string("; could not set priority: ") + strerror(error);     // real time priority needs root or CAP_SYS_NICE
+
+        if (policy.priority <= 0 && setpriority(PRIO_PROCESS, tid, policy.nice) != 0)
+            refused += std::string("; could not set nice: ") + strerror(errno);         // so does a nice level below 0
+
+        if (!reported[which].exchange(true))
+            std::cout << "Thread placement: " << SUBSYSTEM_NAMES[which] << " runs on " << describe_thread(tid) << refused << std::endl;
+    }
+
+    void thread_placement::report_refresh_thread(void) {
+        DIR* tasks = opendir("/proc/self/task");
+
+        if (tasks == nullptr)
+            return;
+
+        bool found = false;
+
+        // the matrix library gives its refresh thread real time priority, that is how it is told apart from the others
+        while (dirent* entry = readdir(tasks)) {
+            pid_t tid = (pid_t) std::atoi(entry->d_name);
+
+            if (tid <= 0 || tid == current_tid())
+                continue;
+
+            int policy = sched_getscheduler(tid);
+
+            if (policy == SCHED_FIFO || policy == SCHED_RR) {
+                std::cout << "Thread placement: refresh (matrix library) runs on " << describe_thread(tid) << std::endl;
+                found = true;
+            }
+        }
+
+        closedir(tasks);
+
+        if (!found)
+            std::cout << "Thread placement: could not find the refresh thread of the matrix library" << std::endl;
+    }
+
+    thread_placement::subsystem thread_placement::find(const std::string& name) {
+        for (int i = 0; i < SUBSYSTEMS; i++) {
+            if (name == SUBSYSTEM_NAMES[i])
+                return (subsystem) i;
+        }
+
+        return SUBSYSTEMS;
+    }
+}
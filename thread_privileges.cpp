@@ -0,0 +1,59 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// thread_privileges.cpp
+// Implementation of the thread_privileges class
+//
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <pwd.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "matrix_clock.h"
+
+// 32 bit ARM (the Pi) still has the old 16 bit id calls under the plain names, glibc itself uses the 32 bit ones there
+#ifdef SYS_setresuid32
+#define CLOCK_SYS_SETGROUPS SYS_setgroups32
+#define CLOCK_SYS_SETRESGID SYS_setresgid32
+#define CLOCK_SYS_SETRESUID SYS_setresuid32
+#else
+#define CLOCK_SYS_SETGROUPS SYS_setgroups
+#define CLOCK_SYS_SETRESGID SYS_setresgid
+#define CLOCK_SYS_SETRESUID SYS_setresuid
+#endif
+
+namespace matrix_clock {
+    bool thread_privileges::kept = false;
+    uid_t thread_privileges::uid = 0;
+    gid_t thread_privileges::gid = 0;
+
+    bool thread_privileges::keep_for_render(const char* user) {
+        if (geteuid() != 0)
+            return true;    // not root to begin with, there is nothing to give up
+
+        passwd* entry = getpwnam(user);    // looked up now, a thread giving up root must not have to read /etc/passwd
+
+        if (entry == nullptr)
+            return false;
+
+        uid = entry->pw_uid;
+        gid = entry->pw_gid;
+        kept = true;
+        return true;
+    }
+
+    void thread_privileges::drop_thread(void) {
+        if (!kept)
+            return;
+
+        // the glibc wrappers change every thread of the process, the system calls themselves only change the calling thread
+        // groups first and the user last, once the user is gone the groups can not be changed anymore
+        if (syscall(CLOCK_SYS_SETGROUPS, 0, nullptr) != 0 || syscall(CLOCK_SYS_SETRESGID, gid, gid, gid) != 0 ||
+            syscall(CLOCK_SYS_SETRESUID, uid, uid, uid) != 0) {
+            std::cerr << "Could not give up root on a thread: " << strerror(errno) << std::endl;
+        }
+    }
+}
@@ -14,6 +14,7 @@ namespace matrix_clock {
         this->minute_start = minute_start;
         this->hour_end = hour_end;
         this->minute_end = minute_end;
+        days = 0;                               // no days until add_day() is called
     }
 
     bool time_period::in_time_period(int current_hour, int current_minute, int day_of_week) const {
@@ -0,0 +1,408 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// time_zone.cpp
+// Implementation of the time_zone and time_zone_set classes
+//
+
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    static const std::int64_t SECONDS_PER_DAY = 86400;
+    static const std::int64_t FOREVER = std::numeric_limits<std::int64_t>::max();
+
+    // days since 1970-01-01 of the given date in the proleptic gregorian calendar (month 1-12)
+    static std::int64_t days_from_civil(std::int64_t year, int month, int day) {
+        year -= month <= 2;
+        std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+        std::int64_t year_of_era = year - (era * 400);
+        std::int64_t day_of_year = ((153 * (month + (month > 2 ? -3 : 9))) + 2) / 5 + day - 1;
+        std::int64_t day_of_era = (year_of_era * 365) + (year_of_era / 4) - (year_of_era / 100) + day_of_year;
+
+        return (era * 146097) + day_of_era - 719468;
+    }
+
+    // the opposite of days_from_civil(), month is 1-12
+    static void civil_from_days(std::int64_t days, std::int64_t& year, int& month, int& day) {
+        days += 719468;
+        std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        std::int64_t day_of_era = days - (era * 146097);
+        std::int64_t year_of_era = (day_of_era - (day_of_era / 1460) + (day_of_era / 36524) - (day_of_era / 146096)) / 365;
+        std::int64_t day_of_year = day_of_era - ((365 * year_of_era) + (year_of_era / 4) - (year_of_era / 100));
+        std::int64_t month_index = ((5 * day_of_year) + 2) / 153;     // counted from March
+
+        day = (int) (day_of_year - (((153 * month_index) + 2) / 5) + 1);
+        month = (int) (month_index < 10 ? month_index + 3 : month_index - 9);
+        year = year_of_era + (era * 400) + (month <= 2);
+    }
+
+    static bool is_leap_year(std::int64_t year) {
+        return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    }
+
+    // rounds down instead of towards zero, times before 1970 still land on the right day
+    static std::int64_t floor_div(std::int64_t value, std::int64_t divisor) {
+        return (value / divisor) - ((value % divisor) < 0 ? 1 : 0);
+    }
+
+    // reads a big endian signed number of the given size (4 or 8 bytes) from the file contents
+    static std::int64_t read_big_endian(const unsigned char* bytes, int size) {
+        std::uint64_t value = 0;
+
+        for (int i = 0; i < size; i++)
+            value = (value << 8) | bytes[i];
+
+        if (size == 4)
+            return (std::int32_t) (std::uint32_t) value;
+
+        return (std::int64_t) value;
+    }
+
+    // reads a number from the rule text, returns false if there is none
+    static bool parse_number(std::string_view& text, int& value) {
+        if (text.empty() || text[0] < '0' || text[0] > '9')
+            return false;
+
+        value = 0;
+
+        while (!text.empty() && text[0] >= '0' && text[0] <= '9') {
+            value = (value * 10) + (text[0] - '0');
+            text.remove_prefix(1);
+        }
+
+        return true;
+    }
+
+    // reads [+-]hh[:mm[:ss]] from the rule text into seconds
+    static bool parse_clock_time(std::string_view& text, int& seconds) {
+        int sign = 1, hours, part;
+
+        if (!text.empty() && (text[0] == '+' || text[0] == '-')) {
+            sign = text[0] == '-' ? -1 : 1;
+            text.remove_prefix(1);
+        }
+
+        if (!parse_number(text, hours))
+            return false;
+
+        seconds = hours * 3600;
+
+        for (int multiplier : {60, 1}) {
+            if (text.empty() || text[0] != ':')
+                break;
+
+            text.remove_prefix(1);
+
+            if (!parse_number(text, part))
+                return false;
+
+            seconds += part * multiplier;
+        }
+
+        seconds *= sign;
+        return true;
+    }
+
+    // skips a zone abbreviation, either letters (EST) or anything in angle brackets (<+0530>)
+    static bool skip_abbreviation(std::string_view& text) {
+        if (!text.empty() && text[0] == '<') {
+            std::size_t close = text.find('>');
+
+            if (close == std::string_view::npos)
+                return false;
+
+            text.remove_prefix(close + 1);
+            return true;
+        }
+
+        std::size_t length = 0;
+
+        while (length < text.size() && std::isalpha((unsigned char) text[length]))
+            length++;
+
+        text.remove_prefix(length);
+        return length >= 3;
+    }
+
+    time_zone::time_zone(std::string_view zone_name) : name(zone_name) {
+        first_offset = std_offset = dst_offset = cached_offset = 0;
+        has_rule = rule_has_dst = false;
+        cached_from = cached_until = 0;     // empty, the first get_offset() looks it up
+
+        const char* folder = std::getenv("TZDIR");      // the same variable the C library reads its zones from
+        std::string path = (folder != nullptr && *folder != '\0') ? folder : "/usr/share/zoneinfo";
+
+        // only names inside the folder, a zone is never read from somewhere else through the config
+        loaded = !name.empty() && name[0] != '/' && name.find("..") == std::string::npos && load(path + "/" + name);
+    }
+
+    bool time_zone::load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file)
+            return false;
+
+        std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const std::size_t HEADER_SIZE = 44;
+
+        if (data.size() < HEADER_SIZE || std::memcmp(data.data(), "TZif", 4) != 0)
+            return false;
+
+        // version 1 files only have 32 bit times, later ones repeat everything with 64 bit times after the first block
+        bool has_64_bit = data[4] >= '2';
+        std::size_t offset = 0;
+        int time_size = 4;
+
+        for (int block = 0; block < (has_64_bit ? 2 : 1); block++) {
+            if (offset + HEADER_SIZE > data.size() || std::memcmp(&data[offset], "TZif", 4) != 0)
+                return false;
+
+            const unsigned char* counts = &data[offset + 20];
+            auto count = [counts](int index) { return (std::size_t) (std::uint32_t) read_big_endian(counts + (index * 4), 4); };
+            std::size_t utc_count = count(0), std_count = count(1), leap_count = count(2);
+            std::size_t time_count = count(3), type_count = count(4), char_count = count(5);
+
+            time_size = block == 0 ? 4 : 8;
+            std::size_t block_size = (time_count * time_size) + time_count + (type_count * 6) + char_count
+                                     + (leap_count * (time_size + 4)) + std_count + utc_count;
+
+            if (type_count == 0 || offset + HEADER_SIZE + block_size > data.size())
+                return false;
+
+            if (block == 0 && has_64_bit) {     // skip the 32 bit block, the 64 bit one has the same transitions and more
+                offset += HEADER_SIZE + block_size;
+                continue;
+            }
+
+            const unsigned char* times = &data[offset + HEADER_SIZE];
+            const unsigned char* indices = times + (time_count * time_size);
+            const unsigned char* types = indices + time_count;
+
+            transitions.clear();
+            offsets.clear();
+
+            for (std::size_t i = 0; i < time_count; i++) {
+                if (indices[i] >= type_count)
+                    return false;
+
+                transitions.push_back(read_big_endian(times + (i * time_size), time_size));
+                offsets.push_back((std::int32_t) read_big_endian(types + (indices[i] * 6), 4));
+            }
+
+            first_offset = (std::int32_t) read_big_endian(types, 4);    // times before the first transition use the first type
+            offset += HEADER_SIZE + block_size;
+        }
+
+        // the footer is the rule for every time after the last transition, newer files leave the transitions out once the rule covers them
+        if (has_64_bit && offset < data.size() && data[offset] == '\n') {
+            std::string_view footer((const char*) &data[offset + 1], data.size() - offset - 1);
+            std::size_t end = footer.find('\n');
+
+            if (end != std::string_view::npos && end > 0)
+                has_rule = parse_rule(footer.substr(0, end));
+        }
+
+        return true;
+    }
+
+    bool time_zone::parse_rule(std::string_view rule) {
+        int seconds;
+
+        // the offsets in the rule count hours west of Greenwich, the opposite of the offsets in the file
+        if (!skip_abbreviation(rule) || !parse_clock_time(rule, seconds))
+            return false;
+
+        std_offset = -seconds;
+        dst_offset = std_offset;
+        rule_has_dst = !rule.empty();
+
+        if (!rule_has_dst)
+            return true;
+
+        if (!skip_abbreviation(rule))
+            return false;
+
+        dst_offset = std_offset + 3600;     // daylight saving is an hour ahead unless the rule says otherwise
+
+        if (!rule.empty() && rule[0] != ',') {
+            if (!parse_clock_time(rule, seconds))
+                return false;
+
+            dst_offset = -seconds;
+        }
+
+        if (rule.empty()) {     // no dates given, POSIX falls back to the US rules
+            dst_start = {'M', 3, 2, 0, 7200};
+            dst_end = {'M', 11, 1, 0, 7200};
+            return true;
+        }
+
+        for (rule_date* date : {&dst_start, &dst_end}) {
+            if (rule.empty() || rule[0] != ',')
+                return false;
+
+            rule.remove_prefix(1);
+            *date = rule_date();
+
+            if (!rule.empty() && (rule[0] == 'M' || rule[0] == 'J')) {
+                date->kind = rule[0];
+                rule.remove_prefix(1);
+            } else {
+                date->kind = 'n';
+            }
+
+            if (date->kind == 'M') {
+                for (int* part : {&date->month, &date->week, &date->day}) {
+                    if (!parse_number(rule, *part))
+                        return false;
+
+                    if (part != &date->day) {
+                        if (rule.empty() || rule[0] != '.')
+                            return false;
+
+                        rule.remove_prefix(1);
+                    }
+                }
+
+                if (date->month < 1 || date->month > 12 || date->week < 1 || date->week > 5 || date->day > 6)
+                    return false;
+            } else if (!parse_number(rule, date->day)) {
+                return false;
+            }
+
+            if (!rule.empty() && rule[0] == '/') {
+                rule.remove_prefix(1);
+
+                if (!parse_clock_time(rule, date->time))
+                    return false;
+            }
+        }
+
+        return rule.empty();
+    }
+
+    std::int64_t time_zone::rule_time(const rule_date& date, int year, std::int32_t local_offset) {
+        std::int64_t day;
+
+        if (date.kind == 'M') {
+            std::int64_t first = days_from_civil(year, date.month, 1);
+            int first_weekday = (int) (((first % 7) + 11) % 7);         // 1970-01-01 was a Thursday
+            int length = (int) (days_from_civil(date.month == 12 ? year + 1 : year, date.month == 12 ? 1 : date.month + 1, 1) - first);
+
+            day = first + ((date.day - first_weekday + 7) % 7) + ((date.week - 1) * 7);
+
+            while (day - first >= length)       // week 5 means the last one, which may be the fourth
+                day -= 7;
+        } else if (date.kind == 'J') {
+            day = days_from_civil(year, 1, 1) + date.day - 1 + (is_leap_year(year) && date.day >= 60 ? 1 : 0);
+        } else {
+            day = days_from_civil(year, 1, 1) + date.day;
+        }
+
+        return (day * SECONDS_PER_DAY) + date.time - local_offset;
+    }
+
+    void time_zone::resolve(std::int64_t utc) {
+        if (!transitions.empty() && utc < transitions.back()) {
+            std::size_t next = std::upper_bound(transitions.begin(), transitions.end(), utc) - transitions.begin();
+
+            cached_from = next == 0 ? std::numeric_limits<std::int64_t>::min() : transitions[next - 1];
+            cached_until = transitions[next];
+            cached_offset = next == 0 ? first_offset : offsets[next - 1];
+            return;
+        }
+
+        std::int64_t last = transitions.empty() ? std::numeric_limits<std::int64_t>::min() : transitions.back();
+        cached_from = last;
+        cached_until = FOREVER;
+        cached_offset = transitions.empty() ? first_offset : offsets.back();
+
+        if (!has_rule)
+            return;
+
+        cached_offset = std_offset;
+
+        if (!rule_has_dst)
+            return;
+
+        // the changes of the year before, this year, and the year after, so the one before and after the time are always in here
+        std::int64_t year;
+        int month, day;
+        civil_from_days(floor_div(utc + std_offset, SECONDS_PER_DAY), year, month, day);
+
+        std::array<std::pair<std::int64_t, std::int32_t>, 6> changes;
+
+        for (int i = 0; i < 3; i++) {
+            changes[i * 2] = {rule_time(dst_start, (int) year - 1 + i, std_offset), dst_offset};   // the start happens on standard time
+            changes[(i * 2) + 1] = {rule_time(dst_end, (int) year - 1 + i, dst_offset), std_offset};
+        }
+
+        std::sort(changes.begin(), changes.end());
+
+        for (std::size_t i = 0; i < changes.size(); i++) {
+            if (changes[i].first > utc) {
+                cached_until = changes[i].first;
+                break;
+            }
+
+            cached_from = std::max(last, changes[i].first);
+            cached_offset = changes[i].second;
+        }
+    }
+
+    std::int32_t time_zone::get_offset(std::int64_t utc) {
+        if (utc < cached_from || utc >= cached_until)
+            resolve(utc);
+
+        return cached_offset;
+    }
+
+    void time_zone::get_local_time(std::int64_t utc, std::tm& local) {
+        std::int64_t seconds = utc + get_offset(utc);
+        std::int64_t days = floor_div(seconds, SECONDS_PER_DAY);
+        std::int64_t second_of_day = seconds - (days * SECONDS_PER_DAY);
+        std::int64_t year;
+        int month, day;
+
+        civil_from_days(days, year, month, day);
+
+        local.tm_hour = (int) (second_of_day / 3600);
+        local.tm_min = (int) ((second_of_day / 60) % 60);
+        local.tm_sec = (int) (second_of_day % 60);
+        local.tm_year = (int) (year - 1900);
+        local.tm_mon = month - 1;
+        local.tm_mday = day;
+        local.tm_wday = (int) (((days % 7) + 11) % 7);     // 1970-01-01 was a Thursday
+        local.tm_yday = (int) (days - days_from_civil(year, 1, 1));
+    }
+
+    bool time_zone_set::get_local_time(std::string_view zone_name, std::int64_t utc, std::tm& local) {
+        std::lock_guard<std::mutex> lock(zones_lock);
+
+        for (std::unique_ptr<time_zone>& zone : zones) {
+            if (zone->get_name() == zone_name) {
+                if (!zone->is_loaded())
+                    return false;
+
+                zone->get_local_time(utc, local);
+                return true;
+            }
+        }
+
+        // first time this zone is asked for, read it now (this is the only time it allocates)
+        zones.push_back(std::make_unique<time_zone>(zone_name));
+
+        if (!zones.back()->is_loaded())
+            return false;   // --CHECK says which zone could not be read
+
+        zones.back()->get_local_time(utc, local);
+        return true;
+    }
+}
@@ -0,0 +1,185 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// timer_set.cpp
+// Implementation of the timer_set class
+//
+
+#include <functional>
+#include <cctype>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    timer_set::timer_set() {
+        empty_timer = std::make_shared<matrix_timer>(-1, 0, 0);
+        hold_seconds = 0;
+    }
+
+    std::shared_ptr<matrix_timer> timer_set::get(std::string_view name) const {
+        std::lock_guard<std::mutex> lock(timer_lock);
+        auto found = timers.find(name);     // looked up by string_view, so asking for a timer never allocates
+
+        return found != timers.end() ? found->second : empty_timer;
+    }
+
+    bool timer_set::has(std::string_view name) const {
+        return get(name)->get_hour() != -1;     // an hour of -1 means the timer ended
+    }
+
+    void timer_set::set(const std::string& name, std::shared_ptr<matrix_timer> timer) {
+        std::lock_guard<std::mutex> lock(timer_lock);
+        timers[name] = timer;   // deadlines of a replaced timer no longer match and are dropped when they come up
+        schedule(name, *timer, matrix_timer::get_monotonic_ms());
+    }
+
+    bool timer_set::remove(std::string_view name) {
+        std::lock_guard<std::mutex> lock(timer_lock);
+        auto found = timers.find(name);
+
+        if (found == timers.end())
+            return false;
+
+        found->second->end_timer();     // anyone still holding on to it sees it as ended
+        timers.erase(found);
+        return true;
+    }
+
+    bool timer_set::start(std::string_view name) {
+        std::lock_guard<std::mutex> lock(timer_lock);
+        auto found = timers.find(name);
+
+        if (found == timers.end() || found->second->get_hour() == -1)
+            return false;
+
+        if (found->second->is_started())
+            return true;    // already running, scheduling it again would leave two deadlines and notify twice when it ends
+
+        found->second->start_timer();
+        schedule(found->first, *found->second, matrix_timer::get_monotonic_ms());
+        return true;
+    }
+
+    bool timer_set::pause(std::string_view name) {
+        std::lock_guard<std::mutex> lock(timer_lock);
+        auto found = timers.find(name);
+
+        if (found == timers.end() || found->second->get_hour() == -1)
+            return false;
+
+        found->second->pause();     // pausing moves the finish instant, so the old deadline goes stale and resuming schedules a new one
+        schedule(found->first, *found->second, matrix_timer::get_monotonic_ms());
+        return true;
+    }
+
+    bool timer_set::reset(std::string_view name) {
+        std::lock_guard<std::mutex> lock(timer_lock);
+        auto found = timers.find(name);
+
+        if (found == timers.end())
+            return false;
+
+        found->second->reset_timer();   // a reset timer is not running, so it has nothing to schedule until it starts again
+        return true;
+    }
+
+    std::vector<std::string> timer_set::get_names(void) const {
+        std::lock_guard<std::mutex> lock(timer_lock);
+        std::vector<std::string> names;
+
+        for (const auto& timer : timers) {
+            if (!timer.first.empty())
+                names.push_back(timer.first);
+        }
+
+        return names;
+    }
+
+    bool timer_set::any_running(void) const {
+        std::lock_guard<std::mutex> lock(timer_lock);
+
+        return std::any_of(timers.begin(), timers.end(), [](const auto& timer) {
+            return timer.second->is_started() && !timer.second->is_paused() && timer.second->get_hour() != -1;
+        });
+    }
+
+    void timer_set::set_hold(int seconds) {
+        std::lock_guard<std::mutex> lock(timer_lock);
+        hold_seconds = seconds;
+    }
+
+    void timer_set::schedule(const std::string& name, const matrix_timer& timer, std::int64_t now) {
+        std::int64_t finish = timer.get_finish_ms();
+
+        if (finish == -1)
+            return;     // only running countdowns have a deadline
+
+        // a countdown resumed after it already reached zero goes straight to the end of its hold period instead of finishing twice
+        bool hold_over = finish <= now;
+        deadlines.push_back({hold_over ? finish + (hold_seconds * 1000) : finish, finish, hold_over, name});
+        std::push_heap(deadlines.begin(), deadlines.end(), std::greater<timer_deadline>());
+    }
+
+    bool timer_set::is_current(const timer_deadline& deadline) const {
+        auto found = timers.find(deadline.name);
+        return found != timers.end() && found->second->get_finish_ms() == deadline.finish_ms;
+    }
+
+    void timer_set::drop_stale(void) {
+        while (!deadlines.empty() && !is_current(deadlines.front())) {
+            std::pop_heap(deadlines.begin(), deadlines.end(), std::greater<timer_deadline>());
+            deadlines.pop_back();
+        }
+    }
+
+    int timer_set::get_ms_to_next_deadline(void) const {
+        std::lock_guard<std::mutex> lock(timer_lock);
+
+        // stale entries can sit on top here, waking up early for one of them only costs a pop_finished() that finds nothing
+        if (deadlines.empty())
+            return -1;
+
+        return (int) std::max<std::int64_t>(deadlines.front().due_ms - matrix_timer::get_monotonic_ms(), 0);
+    }
+
+    bool timer_set::pop_finished(std::string& finished) {
+        std::lock_guard<std::mutex> lock(timer_lock);
+        std::int64_t now = matrix_timer::get_monotonic_ms();
+
+        drop_stale();
+
+        while (!deadlines.empty() && deadlines.front().due_ms <= now) {
+            std::pop_heap(deadlines.begin(), deadlines.end(), std::greater<timer_deadline>());
+            timer_deadline deadline = std::move(deadlines.back());
+            deadlines.pop_back();
+
+            auto found = timers.find(deadline.name);
+
+            if (!deadline.hold_over) {
+                // the countdown reached zero, it stays on screen for the hold period before it ends
+                deadlines.push_back({deadline.finish_ms + (hold_seconds * 1000), deadline.finish_ms, true, deadline.name});
+                std::push_heap(deadlines.begin(), deadlines.end(), std::greater<timer_deadline>());
+
+                finished = deadline.name;
+                return true;
+            }
+
+            found->second->end_timer();
+
+            if (!deadline.name.empty())
+                timers.erase(found);    // a finished named timer is gone, the unnamed one stays behind as ended like it always has
+
+            drop_stale();
+        }
+
+        return false;
+    }
+
+    bool timer_set::is_valid_name(std::string_view name) {
+        if (name.empty() || name.size() > MAX_NAME_LENGTH)
+            return false;
+
+        // anything else could end the {ftimer:name} variable early or break up the telegram callback data
+        return std::all_of(name.begin(), name.end(), [](char c) { return std::isalnum((unsigned char) c) || c == '-' || c == '_'; });
+    }
+}
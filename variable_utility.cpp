@@ -10,99 +10,72 @@
 #include <cmath>
 #include <memory>
 #include <sstream>
-#include <curl/curl.h>
-#include <jsoncpp/json/json.h>
 #include <iostream>
 #include "matrix_clock.h"
 
 namespace matrix_clock {
-    // callback method for curl command
-    std::size_t callback(const char*, std::size_t, std::size_t, std::string*);
-
-    // variable_utility(std::string url)
+    // variable_utility(std::unique_ptr<weather_provider> provider)
     //      constructor to create the variable utility object
     //      also loads the default placeholder values for the weather
     //          if on run the application cannot find any weather, it will display ~Error~ for the forecast and 0s for all data
     //          if the weather cannot be updated otherwise, it will display the most recent information
     //
-    //      url = an OpenWeatherAPI weather URL to load data from
-    variable_utility::variable_utility(std::string url) {
-        weather_url = url;
-
-        forecast = "N/A";        // default placeholder values, will be shown in case the weather cannot be updated
-        short_forecast = "~Error~";
-        temp = 0;
-        real_feel = 0;
-        wind_speed = 0.0;
-        humidity = 0;
-
-        timer = new matrix_timer(-1, 0, 0);
+    //      provider = where the weather is polled from
+    variable_utility::variable_utility(std::unique_ptr<weather_provider> provider) {
+        this->provider = std::move(provider);
+        cache_ttl = 0;
+
+        weather_snapshot placeholder;     // default placeholder values, will be shown in case the weather cannot be updated
+        placeholder.forecast = "N/A";
+        placeholder.short_forecast = "~Error~";
+        publish_weather(placeholder);
 }
 
-    // replace_string(std::string& source, std::string search, std::string replace)
-    //      replace all instances of "search" in the source string with "replace"
-    //
-    //      source = the string to execute a replace on
-    //      search = the string we want to have replaced
-    //      replace = what we want to the search term with
-    void replace_string(std::string& source, std::string search, std::string replace);
-
-    // pad_numbers(int source)
-    //      pad the source number to be two digits with a leading 0
-    //      this exists mostly for standard readability of the minutes for the clock
-    //
-    //      source = the integer to add a leading 0 in front of (if necessary, if the source is greater than 10 than it does nothing but convert to string)
-    std::string pad_numbers(int source);
-
     void variable_utility::poll_weather() {
-        CURL* curl = curl_easy_init();  // initialize curl
-        curl_easy_setopt(curl, CURLOPT_URL, weather_url.c_str()); // load url
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10);  // set timeout
-
-        long httpCode(0);   // response code
-        std::unique_ptr<std::string> httpData(new std::string()); // data returned
-
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, httpData.get());
-
-        curl_easy_perform(curl);       // perform command
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode); // load response code
-        curl_easy_cleanup(curl);    // cleanup
-
-        if (httpCode == 200) { // successful code
-            Json::Value jsonData;   // all data
-            JSONCPP_STRING error;
-
-            Json::CharReaderBuilder builder;
-            const std::unique_ptr<Json::CharReader> reader(builder.newCharReader()); // json reader object
-
-            const char* httpDataString = httpData.get()->c_str();
-
-            // try parse
-            if (reader->parse(httpDataString, httpDataString + httpData->size(), &jsonData, &error)) {
-                forecast = jsonData["current"]["weather"][0]["description"].asString();        // load weather info from json
-                short_forecast = jsonData["current"]["weather"][0]["main"].asString();
-                day_forecast = jsonData["daily"][0]["weather"][0]["main"].asString();
-                temp = round(jsonData["current"]["temp"].asFloat());
-                day_low = round(jsonData["daily"][0]["temp"]["min"].asFloat());
-                day_high = round(jsonData["daily"][0]["temp"]["max"].asFloat());
-                real_feel = round(jsonData["current"]["feels_like"].asFloat());
-                wind_speed = round(jsonData["current"]["wind_speed"].asFloat() * 10) / 10.0;
-                humidity = round(jsonData["current"]["humidity"].asFloat());
-
-                if (short_forecast.find("Thunder") != std::string::npos) {    // edge case because Thunderstorms does not fit on matrix
-                    short_forecast = "T-Storms";
-                }
-
-                if (day_forecast.find("Thunder") != std::string::npos) {
-                    short_forecast = "T-Storms";
-                }
-            } else { // could not parse, something went wrong
-                std::cout << "Could not parse data as JSON." << std::endl << error << std::endl;
-            }
-        } else { // update unsuccessful, display in console
+        // only other polls wait on this lock, the render loop and the bot keep reading the weather shown while the fetch runs
+        std::lock_guard<std::mutex> lock(poll_lock);
+        weather_snapshot snapshot;
+
+        if (!provider->fetch(snapshot)) { // update unsuccessful, display in console
             std::cout << "Could not update weather." << std::endl;
+            return;
         }
+
+        snapshot.fetched_at = clock_source::get_wall_time();
+
+        if (!cache_file.empty() && !snapshot.save(cache_file))
+            std::cout << "Could not save the weather to " << cache_file << std::endl;
+
+        publish_weather(std::move(snapshot));
+    }
+
+    void variable_utility::publish_weather(weather_snapshot snapshot) {
+        if (snapshot.short_forecast.find("Thunder") != std::string::npos) {    // edge case because Thunderstorms does not fit on matrix
+            snapshot.short_forecast = "T-Storms";
+        }
+
+        if (snapshot.day_forecast.find("Thunder") != std::string::npos) {
+            snapshot.short_forecast = "T-Storms";
+        }
+
+        std::atomic_store(&weather, std::shared_ptr<const weather_snapshot>(std::make_shared<weather_snapshot>(std::move(snapshot))));
+    }
+
+    void variable_utility::set_weather_provider(std::unique_ptr<weather_provider> new_provider) {
+        std::lock_guard<std::mutex> lock(poll_lock);
+        provider = std::move(new_provider);
+    }
+
+    void variable_utility::set_weather_cache(std::string path, int ttl) {
+        std::lock_guard<std::mutex> lock(poll_lock);
+        cache_file = path;
+        cache_ttl = ttl;
+
+        weather_snapshot snapshot;
+
+        // weather older than the ttl would be more misleading than the placeholders, it is replaced by the first good poll anyway
+        if (!cache_file.empty() && snapshot.load(cache_file) && clock_source::get_wall_time() - snapshot.fetched_at <= (std::time_t) cache_ttl * 60)
+            publish_weather(std::move(snapshot));
     }
 
     void variable_utility::poll_date() {
@@ -121,55 +94,132 @@ namespace matrix_clock {
     }
 
     std::string variable_utility::parse_variables(std::string vars) {
-        std::string parsed_text(vars);
+        std::string parsed_text;
+        parse_variables(vars, parsed_text);
+        return parsed_text;
+    }
+
+    void variable_utility::parse_variables(std::string_view text, std::string& output) {
+        output.clear();     // keeps the capacity, so once the output has grown large enough this never allocates
 
         int times[4];       // load times from data object
         get_time(times);
 
-        // perform text replacements using the parsed text field and defined variables
+        std::shared_ptr<matrix_timer> current_timer = get_timer();      // keep the timer alive even if the bot replaces it halfway through
+        std::shared_ptr<const weather_snapshot> shown = get_weather();  // the same for the weather, every variable reads the same poll
+
+        // walk the text once, copying it over and replacing every {variable} we know with its value
+        std::size_t position = 0;
+
+        while (position < text.size()) {
+            std::size_t open = text.find('{', position);
+            std::size_t close = (open == std::string_view::npos) ? open : text.find('}', open + 1);
+
+            if (close == std::string_view::npos) {  // no more variables, copy the rest as it is
+                output.append(text.substr(position));
+                break;
+            }
+
+            output.append(text.substr(position, open - position));
+
+            if (append_variable(text.substr(open + 1, close - open - 1), times, *current_timer, *shown, output)) {
+                position = close + 1;
+            } else {
+                output += '{';          // not a variable we know, keep the brace and look for a variable after it
+                position = open + 1;
+            }
+        }
+    }
+
+    bool variable_utility::append_variable(std::string_view name, const int times[], matrix_timer& current_timer, const weather_snapshot& shown, std::string& output) {
         // fix formatting where necessary (padding 0s and converting time to am or pm)
-        replace_string(parsed_text, "{hour}", std::to_string(times[0]));
-        replace_string(parsed_text, "{minute}", pad_numbers(times[1]));
-        replace_string(parsed_text, "{second}", pad_numbers(times[2]));
-        replace_string(parsed_text, "{hour24}", std::to_string(times[3]));
-        replace_string(parsed_text, "{ampm}", times[3] < 12 ? "am" : "pm");
-        replace_string(parsed_text, "{temp}", std::to_string(get_temp()));
-        replace_string(parsed_text, "{day_low}", std::to_string(get_day_low()));
-        replace_string(parsed_text, "{day_high}", std::to_string(get_day_high()));
-        replace_string(parsed_text, "{temp_feel}", std::to_string(get_real_feel()));
-        replace_string(parsed_text, "{humidity}", std::to_string(get_humidity()));
-        replace_string(parsed_text, "{forecast}", get_current_forecast());
-        replace_string(parsed_text, "{forecast_short}", get_current_forecast_short());
-        replace_string(parsed_text, "{day_forecast}", get_day_forecast());
-        replace_string(parsed_text, "{date_format}", get_formatted_date());
-        replace_string(parsed_text, "{month_name}", get_month_name());
-        replace_string(parsed_text, "{day_name}", get_day_name());
-        replace_string(parsed_text, "{month_num}", std::to_string(get_month_num()));
-        replace_string(parsed_text, "{month_day}", std::to_string(get_day_of_month()));
-        replace_string(parsed_text, "{week_day_num}", std::to_string(get_day_of_week()));
-        replace_string(parsed_text, "{year}", std::to_string(get_year()));
-
-        // replace variables related to the timer embedded within the class
-        replace_string(parsed_text, "{thour}", std::to_string(timer->get_hour()));
-
-        if (timer->get_hour() != 0)     // if the hour isnt 0, that means the timer is greater than an hour so we want to pad the numbers
-            replace_string(parsed_text, "{tminute}", pad_numbers(timer->get_minute()));
-        else        // otherwise its likely under an hour, we do not need an extra 0 before the number
-            replace_string(parsed_text, "{tminute}", std::to_string(timer->get_minute()));
-
-        replace_string(parsed_text, "{tsecond}", pad_numbers(timer->get_second()));
-
-        replace_string(parsed_text, "{ftimer}", timer->format_timer());
-
-        // for wind speed, we are truncating to 1 decimal place for easier readability (nobody cares how exact it is)
-        std::string wind = std::to_string(get_wind_speed());
-        replace_string(parsed_text, "{wind_speed}", wind.substr(0, wind.find(".") + 2));
+        if (name == "hour") append_number(output, times[0]);
+        else if (name == "minute") append_number(output, times[1], 2);
+        else if (name == "second") append_number(output, times[2], 2);
+        else if (name == "hour24") append_number(output, times[3]);
+        else if (name == "ampm") output += times[3] < 12 ? "am" : "pm";
+        else if (name == "temp") append_number(output, shown.temp);
+        else if (name == "day_low") append_number(output, shown.day_low);
+        else if (name == "day_high") append_number(output, shown.day_high);
+        else if (name == "temp_feel") append_number(output, shown.real_feel);
+        else if (name == "humidity") append_number(output, shown.humidity);
+        else if (name == "forecast") output += shown.forecast;
+        else if (name == "forecast_short") output += shown.short_forecast;
+        else if (name == "day_forecast") output += shown.day_forecast;
+        else if (name == "date_format") output += formatted_date;
+        else if (name == "month_name") output += month_name;
+        else if (name == "day_name") output += day_name;
+        else if (name == "month_num") append_number(output, month_num);
+        else if (name == "month_day") append_number(output, day_of_month);
+        else if (name == "week_day_num") append_number(output, day_of_week);
+        else if (name == "year") append_number(output, year);
+        else if (append_timer_variable(name, current_timer, output)) return true;
+        else if (telemetry.append_variable(name, output)) return true;
+        else if (name == "wind_speed") {
+            // for wind speed, we are truncating to 1 decimal place for easier readability (nobody cares how exact it is)
+            long micro = std::lround(shown.wind_speed * 1000000.0);     // round to the same 6 digits std::to_string() used to before cutting them off
+            append_number(output, micro / 1000000);
+            output += '.';
+            append_number(output, (micro / 100000) % 10);
+        }
+        else if (name.find(':') != std::string_view::npos) {
+            std::size_t colon = name.find(':');
+            std::string_view kind = name.substr(0, colon);
 
-        return parsed_text;
+            // a variable source, {src:garage_temp} shows the last value read by the source called garage_temp
+            if (kind == "src" || kind == "src_age" || kind == "src_ms")
+                return sources != nullptr && sources->append_variable(kind, name.substr(colon + 1), output);
+
+            // a named timer, {ftimer:pasta} shows the timer called pasta
+            std::shared_ptr<matrix_timer> named_timer = timers.get(name.substr(colon + 1));     // a timer that does not exist shows as ended
+
+            return append_timer_variable(kind, *named_timer, output);
+        }
+        else if (name.find('@') != std::string_view::npos) return append_zone_variable(name, output);
+        else return false;
+
+        return true;
+    }
+
+    bool variable_utility::append_timer_variable(std::string_view name, const matrix_timer& current_timer, std::string& output) {
+        if (name == "thour") append_number(output, current_timer.get_hour());
+        else if (name == "tminute") append_number(output, current_timer.get_minute(), current_timer.get_hour() != 0 ? 2 : 1);    // pad the minutes once the timer is over an hour
+        else if (name == "tsecond") append_number(output, current_timer.get_second(), 2);
+        else if (name == "ftimer") current_timer.format_timer(output);
+        else if (name == "tcenti") append_number(output, current_timer.get_centisecond(), 2);
+        else return false;
+
+        return true;
+    }
+
+    bool variable_utility::append_zone_variable(std::string_view name, std::string& output) {
+        std::size_t at = name.find('@');
+        std::string_view kind = name.substr(0, at);
+        std::tm local;
+
+        if (!zones.get_local_time(name.substr(at + 1), clock_source::get_wall_time(), local))
+            return false;
+
+        int hour = local.tm_hour % 12;
+
+        if (kind == "hour") append_number(output, hour == 0 ? 12 : hour);
+        else if (kind == "minute") append_number(output, local.tm_min, 2);
+        else if (kind == "second") append_number(output, local.tm_sec, 2);
+        else if (kind == "hour24") append_number(output, local.tm_hour);
+        else if (kind == "ampm") output += local.tm_hour < 12 ? "am" : "pm";
+        else if (kind == "month_name") output += months[local.tm_mon];
+        else if (kind == "day_name") output += days[local.tm_wday];
+        else if (kind == "month_num") append_number(output, local.tm_mon + 1);
+        else if (kind == "month_day") append_number(output, local.tm_mday);
+        else if (kind == "week_day_num") append_number(output, local.tm_wday);
+        else if (kind == "year") append_number(output, local.tm_year + 1900);
+        else return false;
+
+        return true;
     }
 
     std::tm* variable_utility::get_tm() {
-        time_t now = std::time(0);  // generate a date and time struct with current time
+        time_t now = clock_source::get_wall_time();  // generate a date and time struct with current time (or the simulated time)
         tm* time = localtime(&now);
         return time;    // return struct
     }
@@ -181,6 +231,29 @@ namespace matrix_clock {
         return times[3] == 0 && times[1] == 0 && times[2] == 0; // check if 24 hour time is 0, minutes is 0, and seconds is 0
     }
 
+    void variable_utility::get_condition_values(float values[]) {
+        tm* time_components = get_tm();     // the time is read once here instead of for every line
+        int hour = time_components->tm_hour % 12;
+
+        values[line_condition::hour] = hour == 0 ? 12 : hour;
+        values[line_condition::hour24] = time_components->tm_hour;
+        values[line_condition::minute] = time_components->tm_min;
+        values[line_condition::second] = time_components->tm_sec;
+        values[line_condition::month] = time_components->tm_mon + 1;
+        values[line_condition::month_day] = time_components->tm_mday;
+        values[line_condition::week_day_num] = time_components->tm_wday;
+        values[line_condition::year] = time_components->tm_year + 1900;
+        std::shared_ptr<const weather_snapshot> shown = get_weather();
+        values[line_condition::temp] = shown->temp;
+        values[line_condition::temp_feel] = shown->real_feel;
+        values[line_condition::humidity] = shown->humidity;
+        values[line_condition::day_low] = shown->day_low;
+        values[line_condition::day_high] = shown->day_high;
+        values[line_condition::wind_speed] = shown->wind_speed;
+        values[line_condition::condition] = shown->condition;
+        values[line_condition::timer_running] = timers.any_running();
+    }
+
     void variable_utility::get_time(int times[]) {
         tm* time_components = get_tm(); // grab current time struct and load array with time data
         times[0] = time_components->tm_hour % 12;  // hour in 12 format
@@ -191,33 +264,4 @@ namespace matrix_clock {
         if (times[0] == 0) // non-military time
             times[0] = 12;  // make it 12 (standard)
     }
-
-    // std::size_t callback(const char*, std::size_t, std::size_t, std::string*)
-    //     callback method for the curl library, this is where it reads the data from the url and writes it to our object
-    std::size_t callback(const char* in, std::size_t size, std::size_t num, std::string* out) {
-        const std::size_t totalBytes(size * num);
-        out->append(in, totalBytes);    // load data from the webpage and send it back out
-        return totalBytes;
-    }
-
-    std::string pad_numbers(int source) {
-        std::stringstream stream;
-
-        if (source < 10) {
-            stream << "0";  // if the integer is less than 10, add in a zero infront for readability in time
-        }
-
-        stream << std::to_string(source);
-
-        return stream.str();
-    }
-
-    void replace_string(std::string& source, std::string search, std::string replace) {
-        size_t position = source.find(search);  // find the current index of the search string
-
-        while (position != std::string::npos) { // loop until it cannot be found anymore (replaced out), will not run with 0 instances
-            source.replace(position, search.size(), replace);   // replace at the position
-            position = source.find(search, position + replace.size());  // find next instance (will not loop again with none found)
-        }
-    }
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// weather_provider.cpp
+// Implementation of the weather providers and the weather_snapshot struct
+//
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <curl/curl.h>
+#include <jsoncpp/json/json.h>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // the weather the stub provider cycles through, one entry per poll
+    // fields are temp, real feel, humidity, day high, day low, wind speed, short forecast, forecast, day forecast, and condition code
+    static const weather_snapshot STUB_WEATHER[] = {
+        {72, 70, 45, 78, 61, 5.3f, "Clear", "clear sky", "Clear", 800},
+        {55, 52, 80, 60, 50, 12.1f, "Rain", "moderate rain", "Rain", 501},
+        {66, 68, 90, 75, 62, 18.4f, "Thunderstorm", "thunderstorm with heavy rain", "Thunderstorm", 202},
+        {28, 19, 70, 31, 22, 9.8f, "Snow", "light snow", "Snow", 600},
+        {-4, -15, 60, 2, -9, 24.6f, "Clouds", "overcast clouds", "Clouds", 804}
+    };
+
+    // std::size_t callback(const char*, std::size_t, std::size_t, weather_report*)
+    //     callback method for the curl library, this is where it reads the data from the url and hands it to the report as it arrives
+    //     returning less than it was given makes curl stop the download, there is no point in reading the rest of a broken response
+    static std::size_t callback(const char* in, std::size_t size, std::size_t num, weather_report* out) {
+        const std::size_t totalBytes(size * num);
+        return out->feed(in, totalBytes) ? totalBytes : 0;
+    }
+
+    void weather_snapshot::read_report(const weather_report& report) {
+        forecast = report.get_text(weather_report::forecast);
+        short_forecast = report.get_text(weather_report::short_forecast);
+        day_forecast = report.get_text(weather_report::day_forecast);
+        temp = round(report.get_number(weather_report::temp));
+        day_low = round(report.get_number(weather_report::day_low));
+        day_high = round(report.get_number(weather_report::day_high));
+        real_feel = round(report.get_number(weather_report::feels_like));
+        wind_speed = round(report.get_number(weather_report::wind_speed) * 10) / 10.0;
+        humidity = round(report.get_number(weather_report::humidity));
+        condition = (int) report.get_number(weather_report::condition);
+    }
+
+    bool weather_snapshot::save(const std::string& path) const {
+        Json::Value data;
+        data["temp"] = temp;
+        data["temp_feel"] = real_feel;
+        data["humidity"] = humidity;
+        data["day_high"] = day_high;
+        data["day_low"] = day_low;
+        data["wind_speed"] = wind_speed;
+        data["forecast_short"] = short_forecast;
+        data["forecast"] = forecast;
+        data["day_forecast"] = day_forecast;
+        data["condition"] = condition;
+        data["fetched_at"] = (Json::Int64) fetched_at;
+
+        // written next to the cache and moved over it, so a crash halfway through never leaves a broken cache behind
+        std::string temporary = path + ".tmp";
+        std::ofstream stream(temporary);
+
+        if (!stream)
+            return false;
+
+        stream << data;
+        stream.close();
+
+        return !stream.fail() && std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    bool weather_snapshot::load(const std::string& path) {
+        std::ifstream stream(path);
+
+        if (!stream)
+            return false;
+
+        Json::Value data;
+        Json::CharReaderBuilder builder;
+        JSONCPP_STRING error;
+
+        if (!parseFromStream(builder, stream, &data, &error) || !data.isObject() || !data["fetched_at"].isIntegral())
+            return false;
+
+        try {
+            weather_snapshot loaded;
+            loaded.temp = data["temp"].asInt();
+            loaded.real_feel = data["temp_feel"].asInt();
+            loaded.humidity = data["humidity"].asInt();
+            loaded.day_high = data["day_high"].asInt();
+            loaded.day_low = data["day_low"].asInt();
+            loaded.wind_speed = data["wind_speed"].asFloat();
+            loaded.short_forecast = data["forecast_short"].asString();
+            loaded.forecast = data["forecast"].asString();
+            loaded.day_forecast = data["day_forecast"].asString();
+            loaded.condition = data["condition"].asInt();  // missing from caches written before icons existed, which reads as 0
+            loaded.fetched_at = data["fetched_at"].asInt64();
+
+            *this = loaded;
+            return true;
+        } catch (const Json::Exception& exception) {    // a field of the wrong type
+            return false;
+        }
+    }
+
+    std::unique_ptr<weather_provider> weather_provider::create(const std::string& name, const std::string& url, const std::string& file) {
+        if (name == "file")
+            return std::make_unique<file_weather_provider>(file);
+
+        if (name == "stub")
+            return std::make_unique<stub_weather_provider>();
+
+        if (name != "openweathermap")
+            std::cerr << "Unknown weather provider " << name << ", using openweathermap." << std::endl;
+
+        return std::make_unique<openweathermap_provider>(url);
+    }
+
+    bool openweathermap_provider::fetch(weather_snapshot& snapshot) {
+        CURL* curl = curl_easy_init();  // initialize curl
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str()); // load url
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10);  // set timeout
+
+        long httpCode(0);   // response code
+        weather_report report;  // filled in while the response downloads, the body itself is never kept around
+
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &report);
+
+        curl_easy_perform(curl);       // perform command
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode); // load response code
+        curl_easy_cleanup(curl);    // cleanup
+
+        if (httpCode != 200)
+            return false;
+
+        if (!report.is_complete()) { // could not parse, something went wrong
+            std::cout << "Could not parse data as JSON." << std::endl;
+            return false;
+        }
+
+        snapshot.read_report(report);
+        return true;
+    }
+
+    bool file_weather_provider::fetch(weather_snapshot& snapshot) {
+        std::ifstream stream(path, std::ios::binary);
+
+        if (!stream) {
+            std::cout << "Could not open weather file " << path << std::endl;
+            return false;
+        }
+
+        weather_report report;
+        char chunk[4096];   // read the same way a download arrives, so the file can be as large as a real response
+
+        while (stream.read(chunk, sizeof(chunk)) || stream.gcount() > 0) {
+            if (!report.feed(chunk, stream.gcount()))
+                break;
+        }
+
+        if (!report.is_complete()) {
+            std::cout << "Could not parse " << path << " as JSON." << std::endl;
+            return false;
+        }
+
+        snapshot.read_report(report);
+        return true;
+    }
+
+    bool stub_weather_provider::fetch(weather_snapshot& snapshot) {
+        const std::size_t count = sizeof(STUB_WEATHER) / sizeof(STUB_WEATHER[0]);
+
+        snapshot = STUB_WEATHER[poll_count++ % count];
+        return true;
+    }
+}
@@ -0,0 +1,268 @@
+// Matrix Clock
+// Created by Eric Johns (ericjohns55)
+// https://github.com/ericjohns55/MatrixClock
+//
+// weather_report.cpp
+// Implementation of the weather_report class
+//
+
+#include <cstdlib>
+#include "matrix_clock.h"
+
+namespace matrix_clock {
+    // where every field sits in a OneCall 3.0 response, array elements are addressed by their index
+    // indexed by weather_report::number_field and weather_report::text_field
+    static const char* const NUMBER_PATHS[weather_report::NUMBER_FIELDS] = {
+        "current.temp", "current.feels_like", "current.wind_speed", "current.humidity", "daily.0.temp.min", "daily.0.temp.max",
+        "current.weather.0.id"
+    };
+
+    static const char* const TEXT_PATHS[weather_report::TEXT_FIELDS] = {
+        "current.weather.0.description", "current.weather.0.main", "daily.0.weather.0.main"
+    };
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    static int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    weather_report::weather_report() {
+        depth = path_length = token_length = 0;
+        path_overflow = escaped = done = failed = false;
+        state = between;
+        unicode_digits = 0;
+        codepoint = 0;
+        text_target = -1;
+
+        for (int i = 0; i < NUMBER_FIELDS; i++) {
+            numbers[i] = 0;
+            has_numbers[i] = false;
+        }
+
+        for (int i = 0; i < TEXT_FIELDS; i++) {
+            text_lengths[i] = 0;
+            has_texts[i] = false;
+        }
+    }
+
+    bool weather_report::feed(const char* data, std::size_t length) {
+        for (std::size_t i = 0; i < length && !failed; i++) {
+            if (!scan(data[i]))
+                failed = true;
+        }
+
+        return !failed;
+    }
+
+    bool weather_report::scan(char c) {
+        if (state == in_key || state == in_string) {
+            if (unicode_digits > 0) {
+                int value = hex_value(c);
+
+                if (value == -1)
+                    return false;
+
+                codepoint = (codepoint << 4) | value;
+
+                if (--unicode_digits == 0)
+                    put_codepoint(codepoint);
+            } else if (escaped) {
+                escaped = false;
+
+                switch (c) {
+                    case 'u': unicode_digits = 4; codepoint = 0; break;
+                    case 'n': put_char('\n'); break;
+                    case 't': put_char('\t'); break;
+                    case 'r': put_char('\r'); break;
+                    case 'b': put_char('\b'); break;
+                    case 'f': put_char('\f'); break;
+                    default: put_char(c); break;    // \" \\ and \/ stand for themselves
+                }
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                if (state == in_string) {
+                    if (text_target != -1)
+                        has_texts[text_target] = true;
+
+                    end_value();
+                }
+
+                state = between;    // a finished key just waits for its ':' and value
+            } else {
+                put_char(c);
+            }
+
+            return true;
+        }
+
+        if (state == in_token) {
+            if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E') {
+                if (token_length == sizeof(token) - 1)
+                    return false;   // no number or literal is this long
+
+                token[token_length++] = c;
+                return true;
+            }
+
+            end_token();
+            state = between;    // the character that ended the token still has to be handled below
+        }
+
+        if (is_space(c) || c == ':')
+            return true;    // keys are always followed by their value, so the colon itself carries no information
+
+        if (done)
+            return false;   // only whitespace may follow the document
+
+        container* top = depth > 0 ? &stack[depth - 1] : nullptr;
+
+        switch (c) {
+            case '{':
+            case '[':
+                if (depth == MAX_DEPTH)
+                    return false;
+
+                stack[depth++] = {c == '[', c == '{', 0, path_length};
+
+                if (c == '[')
+                    set_array_path();
+
+                return true;
+            case '}':
+            case ']':
+                if (top == nullptr || top->array != (c == ']'))
+                    return false;
+
+                path_length = top->base;
+                path_overflow = path_length >= MAX_PATH;
+                depth--;
+                end_value();
+                return true;
+            case ',':
+                if (top == nullptr)
+                    return false;
+
+                if (top->array) {
+                    top->index++;
+                    set_array_path();
+                } else {
+                    top->expect_key = true;
+                }
+
+                return true;
+            case '"':
+                if (top != nullptr && !top->array && top->expect_key) {
+                    // a new key replaces the last one on the path
+                    top->expect_key = false;
+                    path_length = top->base;
+                    path_overflow = false;
+
+                    if (path_length > 0)
+                        put_char('.');
+
+                    state = in_key;
+                } else {
+                    text_target = match_path(TEXT_PATHS, TEXT_FIELDS);
+
+                    if (text_target != -1)
+                        text_lengths[text_target] = 0;
+
+                    state = in_string;
+                }
+
+                return true;
+            default:
+                token[0] = c;
+                token_length = 1;
+                state = in_token;
+                return true;
+        }
+    }
+
+    void weather_report::put_char(char c) {
+        if (state == in_key || (state == between && c == '.')) {
+            if (path_length < MAX_PATH)
+                path[path_length] = c;
+            else
+                path_overflow = true;   // too long to ever match, but the length still has to be tracked to find the parent again
+
+            path_length++;
+        } else if (text_target != -1 && text_lengths[text_target] < MAX_TEXT) {
+            texts[text_target][text_lengths[text_target]++] = c;
+        }
+    }
+
+    void weather_report::put_codepoint(std::uint32_t value) {
+        if (value < 0x80) {
+            put_char((char) value);
+        } else if (value < 0x800) {
+            put_char((char) (0xC0 | (value >> 6)));
+            put_char((char) (0x80 | (value & 0x3F)));
+        } else {
+            put_char((char) (0xE0 | (value >> 12)));
+            put_char((char) (0x80 | ((value >> 6) & 0x3F)));
+            put_char((char) (0x80 | (value & 0x3F)));
+        }
+    }
+
+    void weather_report::set_array_path(void) {
+        container& top = stack[depth - 1];
+        char digits[12];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), top.index);
+
+        path_length = top.base;
+        path_overflow = path_length >= MAX_PATH;
+
+        // the path is built by hand here since put_char() only writes to it while reading a key
+        scan_state previous = state;
+        state = in_key;
+
+        if (path_length > 0)
+            put_char('.');
+
+        for (char* digit = digits; digit < result.ptr; digit++)
+            put_char(*digit);
+
+        state = previous;
+    }
+
+    void weather_report::end_token(void) {
+        int field = match_path(NUMBER_PATHS, NUMBER_FIELDS);
+
+        if (field != -1 && (token[0] == '-' || (token[0] >= '0' && token[0] <= '9'))) {   // true, false, and null leave the field missing
+            token[token_length] = '\0';
+            numbers[field] = std::strtof(token, nullptr);
+            has_numbers[field] = true;
+        }
+
+        end_value();
+    }
+
+    void weather_report::end_value(void) {
+        text_target = -1;
+
+        if (depth == 0)
+            done = true;
+    }
+
+    int weather_report::match_path(const char* const paths[], int count) const {
+        if (path_overflow || path_length > MAX_PATH)
+            return -1;
+
+        std::string_view current(path, path_length);
+
+        for (int i = 0; i < count; i++) {
+            if (current == paths[i])
+                return i;
+        }
+
+        return -1;
+    }
+}